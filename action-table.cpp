@@ -0,0 +1,74 @@
+#include "action-table.h"
+
+// A slot holds the tag in the upper 32 bits, then action type and direction,
+// 0 means no action.
+static uint64_t pack_action(uint32_t tick, PlayerAction action) {
+    return (uint64_t) tick << 32 | (uint64_t) action.type << 8 | action.direction;
+}
+
+static PlayerAction unpack_action(uint64_t slot) {
+    return {(ClientMessage) ((slot >> 8) & 0xff), (uint8_t) (slot & 0xff)};
+}
+
+void ActionTable::publish(PlayerId player_id, PlayerAction action) {
+    uint32_t tick = open_tick.load(std::memory_order_acquire);
+    if (tick == 0) return;
+
+    slots[tick & 1][player_id].store(pack_action(tick, action), std::memory_order_release);
+}
+
+void ActionTable::start_game() {
+    // actions published just before the previous game ended are older
+    first_tick = last_tick + 1;
+    open_tick.store(first_tick, std::memory_order_release);
+}
+
+void ActionTable::end_game() {
+    last_tick = open_tick.load(std::memory_order_relaxed);
+    open_tick.store(0, std::memory_order_release);
+}
+
+size_t ActionTable::take_turn_actions(actions_table_t &actions, uint8_t players_count) {
+    uint32_t tick = open_tick.load(std::memory_order_relaxed);
+    open_tick.store(tick + 1, std::memory_order_seq_cst);
+
+    size_t taken = 0;
+    for (size_t player = 0; player < players_count; player++) {
+        uint64_t action = 0;
+
+        // this tick's buffer, and the other one for actions published during the last switch
+        for (auto &buffer : slots) {
+            uint64_t slot = buffer[player].load(std::memory_order_acquire);
+            while (slot != 0 && (uint32_t) (slot >> 32) <= tick) {
+                // fails only if the player has just published a newer action
+                if (!buffer[player].compare_exchange_weak(slot, 0, std::memory_order_acq_rel))
+                    continue;
+
+                if ((uint32_t) (slot >> 32) >= first_tick && slot > action) action = slot;
+                break;
+            }
+        }
+
+        actions[player].reset();
+        if (action != 0) {
+            actions[player] = unpack_action(action);
+            taken++;
+        }
+    }
+    return taken;
+}
+
+void ActionTable::peek_actions(actions_table_t &actions, uint8_t players_count) const {
+    uint32_t tick = open_tick.load(std::memory_order_acquire);
+    for (size_t player = 0; player < players_count; player++) {
+        uint64_t action = 0;
+        for (auto &buffer : slots) {
+            uint64_t slot = buffer[player].load(std::memory_order_acquire);
+            auto slot_tick = (uint32_t) (slot >> 32);
+            if (slot != 0 && slot_tick >= first_tick && slot_tick <= tick && slot > action) action = slot;
+        }
+
+        actions[player].reset();
+        if (action != 0) actions[player] = unpack_action(action);
+    }
+}
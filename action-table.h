@@ -0,0 +1,45 @@
+#ifndef BOMBOWE_ROBOTY_ACTION_TABLE_H
+#define BOMBOWE_ROBOTY_ACTION_TABLE_H
+
+#include <atomic>
+#include "definitions.h"
+
+/*
+Players' actions for the next turn, published by sessions' threads and
+taken by the room's tick without locks or allocation.
+Every action is tagged with the tick it was published for. The table is
+double-buffered - actions go to the buffer of their tag's parity, each
+player has a slot with the last action in both buffers. The tick first
+advances the tag, which switches publishers to the other buffer, and then
+takes actions with its own or an earlier tag. An action published while
+the tag is being switched keeps the old tag, so it is taken by the very
+next tick, unless the player publishes a newer one before that.
+*/
+class ActionTable {
+private:
+    std::array<std::atomic<uint64_t>, UINT8_MAX + 1> slots[2]{};
+    std::atomic<uint32_t> open_tick{0}; // tag of new actions, 0 - no game in progress
+    uint32_t first_tick = 1; // actions with older tags belong to previous games
+    uint32_t last_tick = 0;
+
+public:
+    // Publishes player's action, replacing the previous one.
+    // Actions published when no game is in progress are dropped.
+    void publish(PlayerId player_id, PlayerAction action);
+
+    // Starts accepting actions. Called by the room's thread, like the functions below.
+    void start_game();
+
+    // Stops accepting actions.
+    void end_game();
+
+    // Takes actions of players [0, players_count) for the current tick
+    // and moves on to the next one. Returns the number of actions taken.
+    size_t take_turn_actions(actions_table_t &actions, uint8_t players_count);
+
+    // Copies actions of players [0, players_count) which the next tick
+    // would take now, without taking them.
+    void peek_actions(actions_table_t &actions, uint8_t players_count) const;
+};
+
+#endif //BOMBOWE_ROBOTY_ACTION_TABLE_H
@@ -0,0 +1,159 @@
+#include <memory>
+#include <optional>
+#include <vector>
+#include "client-connector.h"
+#include "definitions.h"
+
+using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
+
+// Returns resolved endpoints with IPv6 and IPv4 addresses interleaved, IPv6 first.
+static std::vector<tcp::endpoint> interleave_families(const tcp::resolver::results_type &results) {
+    std::vector<tcp::endpoint> v6_endpoints, v4_endpoints, endpoints;
+    for (auto &entry : results)
+        (entry.endpoint().address().is_v6() ? v6_endpoints : v4_endpoints).push_back(entry.endpoint());
+
+    for (size_t i = 0; i < std::max(v6_endpoints.size(), v4_endpoints.size()); i++) {
+        if (i < v6_endpoints.size()) endpoints.push_back(v6_endpoints[i]);
+        if (i < v4_endpoints.size()) endpoints.push_back(v4_endpoints[i]);
+    }
+    return endpoints;
+}
+
+namespace {
+
+// State of the startup, shared by its handlers. All handlers run
+// in the thread running the io_context, one at a time.
+class Startup {
+private:
+    boost::asio::io_context &io_context;
+    tcp::socket &server_socket;
+    tcp::endpoint &server_endpoint;
+    std::vector<udp::endpoint> &gui_endpoints;
+
+    tcp::resolver server_resolver;
+    std::vector<std::unique_ptr<udp::resolver>> gui_resolvers;
+    boost::asio::steady_timer deadline;
+    boost::asio::steady_timer attempt_timer;
+
+    std::vector<tcp::endpoint> endpoints;
+    std::vector<std::unique_ptr<tcp::socket>> attempts;
+    size_t attempts_failed = 0;
+    bool server_done = false;
+    size_t gui_resolved = 0;
+
+    // Stops everything still in progress.
+    void fail(const std::string &what) {
+        error = what;
+        boost::system::error_code ec;
+        deadline.cancel();
+        attempt_timer.cancel();
+        server_resolver.cancel();
+        for (auto &resolver : gui_resolvers)
+            resolver->cancel();
+        for (auto &attempt : attempts)
+            attempt->close(ec);
+    }
+
+    void finish_if_done() {
+        if (server_done && gui_resolved == gui_resolvers.size()) deadline.cancel();
+    }
+
+    // Resolves the [i]-th GUI address, the GUI's own one first and then the mirrors.
+    void resolve_gui(size_t i, const std::string &host, const std::string &port) {
+        gui_resolvers.push_back(std::make_unique<udp::resolver>(io_context));
+        gui_resolvers.back()->async_resolve(host, port, [this, i](const boost::system::error_code &ec,
+                                                                  const udp::resolver::results_type &results) {
+            if (error.has_value()) return;
+            if (ec) return fail(std::string(i == 0 ? "resolving gui address: " :
+                                            "resolving mirror address: ") + ec.message());
+            gui_endpoints[i] = *results.begin();
+            gui_resolved++;
+            finish_if_done();
+        });
+    }
+
+    // Starts connecting to the next endpoint and schedules the one after it.
+    void start_attempt() {
+        size_t attempt = attempts.size();
+        attempts.push_back(std::make_unique<tcp::socket>(io_context));
+        attempts.back()->async_connect(endpoints[attempt],
+                                       [this, attempt](const boost::system::error_code &ec) {
+            attempt_finished(attempt, ec);
+        });
+
+        if (attempts.size() < endpoints.size()) {
+            attempt_timer.expires_after(std::chrono::milliseconds(CONNECTION_ATTEMPT_DELAY_MS));
+            attempt_timer.async_wait([this](const boost::system::error_code &ec) {
+                if (!ec && !error.has_value() && !server_done) start_attempt();
+            });
+        }
+    }
+
+    void attempt_finished(size_t attempt, const boost::system::error_code &ec) {
+        if (error.has_value() || server_done) return;
+
+        if (ec) {
+            if (debug) std::cerr << "connecting to " << endpoints[attempt] << ": " << ec.message() << "\n";
+            attempts_failed++;
+            if (attempts.size() < endpoints.size())
+                start_attempt(); // no point in waiting for the timer
+            else if (attempts_failed == endpoints.size())
+                fail("can't connect to the server: " + ec.message());
+            return;
+        }
+
+        server_done = true;
+        attempt_timer.cancel();
+        server_socket = std::move(*attempts[attempt]);
+        server_endpoint = endpoints[attempt];
+        boost::system::error_code close_ec;
+        for (auto &other : attempts)
+            other->close(close_ec);
+        finish_if_done();
+    }
+
+public:
+    std::optional<std::string> error;
+
+    Startup(boost::asio::io_context &io_context, tcp::socket &server_socket,
+            tcp::endpoint &server_endpoint, std::vector<udp::endpoint> &gui_endpoints):
+            io_context(io_context), server_socket(server_socket),
+            server_endpoint(server_endpoint), gui_endpoints(gui_endpoints),
+            server_resolver(io_context),
+            deadline(io_context), attempt_timer(io_context) {}
+
+    void start(const StartupTargets &targets, std::chrono::milliseconds timeout) {
+        deadline.expires_after(timeout);
+        deadline.async_wait([this](const boost::system::error_code &ec) {
+            if (!ec) fail("connecting timed out");
+        });
+
+        server_resolver.async_resolve(targets.server_host, targets.server_port,
+                                      [this](const boost::system::error_code &ec,
+                                             const tcp::resolver::results_type &results) {
+            if (error.has_value()) return;
+            if (ec) return fail("resolving server address: " + ec.message());
+            endpoints = interleave_families(results);
+            start_attempt();
+        });
+
+        gui_endpoints.assign(1 + targets.mirrors.size(), udp::endpoint());
+        resolve_gui(0, targets.gui_host, targets.gui_port);
+        for (size_t i = 0; i < targets.mirrors.size(); i++)
+            resolve_gui(i + 1, targets.mirrors[i].first, targets.mirrors[i].second);
+    }
+};
+
+} // namespace
+
+void connect_at_startup(boost::asio::io_context &io_context, const StartupTargets &targets,
+                        std::chrono::milliseconds timeout, tcp::socket &server_socket,
+                        tcp::endpoint &server_endpoint, std::vector<udp::endpoint> &gui_endpoints) {
+    Startup startup(io_context, server_socket, server_endpoint, gui_endpoints);
+    startup.start(targets, timeout);
+    io_context.run();
+    io_context.restart();
+
+    if (startup.error.has_value()) throw std::runtime_error(*startup.error);
+}
@@ -0,0 +1,38 @@
+#ifndef BOMBOWE_ROBOTY_CLIENT_CONNECTOR_H
+#define BOMBOWE_ROBOTY_CLIENT_CONNECTOR_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+/*
+Client startup - the server, GUI and GUI mirror addresses are resolved in parallel and
+the server's addresses are tried Happy Eyeballs style (RFC 8305): IPv6 and
+IPv4 addresses interleaved, a new attempt every CONNECTION_ATTEMPT_DELAY_MS
+(or right after the previous one fails) while the earlier ones go on. The first
+connection established wins and the others are closed, so a dead first address
+costs CONNECTION_ATTEMPT_DELAY_MS instead of a full TCP timeout.
+*/
+
+#define CONNECTION_ATTEMPT_DELAY_MS 250
+
+struct StartupTargets {
+    std::string server_host;
+    std::string server_port;
+    std::string gui_host;
+    std::string gui_port;
+    std::vector<std::pair<std::string, std::string>> mirrors; // hosts and ports
+};
+
+// Resolves all addresses and connects [server_socket] to the server, running
+// [io_context] until done. [gui_endpoints] get the GUI's endpoint followed by
+// the mirrors' ones. Throws std::runtime_error if any address can't
+// be resolved, no server address accepts the connection, or [timeout] passes.
+void connect_at_startup(boost::asio::io_context &io_context, const StartupTargets &targets,
+                        std::chrono::milliseconds timeout,
+                        boost::asio::ip::tcp::socket &server_socket,
+                        boost::asio::ip::tcp::endpoint &server_endpoint,
+                        std::vector<boost::asio::ip::udp::endpoint> &gui_endpoints);
+
+#endif //BOMBOWE_ROBOTY_CLIENT_CONNECTOR_H
@@ -13,18 +13,32 @@ const bool debug = true;
 const bool debug = false;
 #endif
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <iostream>
 #include <utility>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <sys/socket.h>
 #include <boost/asio.hpp>
 #include "options-parser.h"
+#include "client-connector.h"
+#include "string-table.h"
+#include "gui-shm.h"
+#include "trace.h"
 
 struct Player;
 struct Bomb;
 struct Position;
 struct Event;
+struct PlayerAction;
 
 using PlayerId = uint8_t;
 using Score = uint32_t;
@@ -42,21 +56,58 @@ using bombs_map_t = std::map<BombId, Bomb>;
 using player_id_and_player_t = std::pair<PlayerId, Player>;
 using player_id_and_score_t = std::pair<PlayerId, Score>;
 using events_list_t = std::vector<Event>;
+using actions_table_t = std::array<std::optional<PlayerAction>, UINT8_MAX + 1>;
 
 #define UDP_BUFFER_LENGTH           65507
-#define SERVER_MESSAGES_NUMBER      4
+#define SERVER_MESSAGES_NUMBER      8
 #define TCP_BUFFER_LENGTH           2048
 #define DIRECTIONS_NUMBER           4
 #define GUI_MESSAGES_NUMBER         3
-#define CLIENT_MESSAGES_NUMBER      4
+#define CLIENT_MESSAGES_NUMBER      6
+#define TURN_HEADER_LENGTH          7
+
+// Capability bits exchanged in Capabilities messages after Hello.
+#define CAPABILITY_COMPACT_ENCODING 0x01
+#define CAPABILITY_COMPRESSION      0x02
+#define CAPABILITY_RECONNECT        0x04
+
+// How long the server waits for Capabilities before sending
+// the lobby or the current game to a new client. Clients which send
+// nothing, e.g. observers, see the lobby that much later, twice as much
+// through robots-gateway, which waits as long before picking a server.
+#define CAPABILITIES_WAIT_MS        50
+
+// SessionToken message - type and 64-bit token.
+#define SESSION_TOKEN_LENGTH        9
+
+// Session tokens carry the id of the room in their highest bits,
+// then the instance of the server, for gateways in front of many servers.
+#define TOKEN_ROOM_SHIFT            48
+#define TOKEN_INSTANCE_SHIFT        40
+
+// Compressed message - type, original length and compressed length.
+#define COMPRESSED_HEADER_LENGTH    9
+#define MAX_DECOMPRESSED_LENGTH     (64 * 1024 * 1024)
+
+// Reconnecting to the server - the first attempt is immediate, then
+// the delay doubles up to the maximum.
+#define RECONNECT_ATTEMPTS          10
+#define RECONNECT_MIN_DELAY_MS      50
+#define RECONNECT_MAX_DELAY_MS      2000
 
 // Some enums used in the task description.
+// Capabilities and Compressed messages are an extension, sent only by
+// clients started with --compact-encoding or --compression and answered
+// only by servers started with these options.
+// SessionToken, ClientResume and GameSnapshot messages are used by clients
+// started with --reconnect to get back into the game after losing connection.
 enum ClientMessage {
-    Join, ClientPlaceBomb, ClientPlaceBlock, ClientMove
+    Join, ClientPlaceBomb, ClientPlaceBlock, ClientMove, ClientCapabilities, ClientResume
 };
 
 enum ServerMessage {
-    Hello, AcceptedPlayer, GameStarted, Turn, GameEnded, Unexpected
+    Hello, AcceptedPlayer, GameStarted, Turn, GameEnded, Capabilities, Compressed,
+    SessionToken, GameSnapshot, Unexpected
 };
 
 enum State {
@@ -71,6 +122,10 @@ enum EventType {
     BombPlaced, BombExploded, PlayerMoved, BlockPlaced
 };
 
+enum Direction {
+    Up, Right, Down, Left
+};
+
 // A structure for an object position on the board.
 struct Position {
     uint16_t x;
@@ -84,6 +139,8 @@ struct Position {
         else return false;
     }
 
+    bool operator== (const Position &right) const = default;
+
     Position() = default;
 };
 
@@ -91,20 +148,30 @@ struct Position {
 struct Bomb {
     Position position{};
     uint16_t timer;
+    PlayerId owner = 0; // known only to the server
 
-    Bomb(const Position& position, uint16_t timer):
-         position(position), timer(timer){};
+    Bomb(const Position& position, uint16_t timer, PlayerId owner = 0):
+         position(position), timer(timer), owner(owner){};
 
     Bomb() = default;
 };
 
 // A structure for a player - contains player name and address.
+// Name and address are interned in a table of the client's session
+// or of the server's room.
 struct Player {
-    std::string name;
-    std::string address;
+    InternedString name;
+    InternedString address;
+
+    Player(StringTable &strings, std::string_view name, std::string_view address):
+            name(strings.intern(name)), address(strings.intern(address)){};
+};
 
-    Player(std::string name, std::string address):
-            name(std::move(name)), address(std::move(address)){};
+// A structure for the last action requested by a player in a turn.
+// Direction is used only by ClientMove.
+struct PlayerAction {
+    ClientMessage type;
+    uint8_t direction;
 };
 
 // A structure for storing all game parameters
@@ -127,16 +194,49 @@ struct GameParameters {
     GameParameters() = default;
 };
 
+// A copy-on-write container. Copies share the container and only
+// write() copies it, if it is shared, so copying a GameState costs
+// a few reference counts and a turn copies only containers it changes.
+// Reads don't need write(); copies may be read and dropped by other threads.
+template<typename T>
+class CowValue {
+private:
+    std::shared_ptr<T> value = std::make_shared<T>();
+
+public:
+    CowValue() = default;
+    CowValue(T value): value(std::make_shared<T>(std::move(value))) {}
+
+    const T &get() const { return *value; }
+
+    // Returns the container for changing, copied first if it is shared.
+    T &write() {
+        if (value.use_count() != 1) value = std::make_shared<T>(*value);
+        // the last other owner may have just dropped its copy
+        else std::atomic_thread_fence(std::memory_order_acquire);
+        return *value;
+    }
+
+    auto begin() const { return value->begin(); }
+    auto end() const { return value->end(); }
+    auto size() const { return value->size(); }
+    bool empty() const { return value->empty(); }
+    template<typename K> auto find(const K &key) const { return value->find(key); }
+    template<typename K> bool contains(const K &key) const { return value->contains(key); }
+    template<typename K> const auto &at(const K &key) const { return value->at(key); }
+};
+
 // A structure for storing all game attributes necessary
-// to create a message for gui.
+// to create a message for gui. Containers are copy-on-write,
+// so snapshots of the state, e.g. of every turn, are cheap.
 struct GameState {
     uint16_t turn;
-    player_positions_map_t player_positions;
-    players_map_t players;
-    positions_set_t blocks;
-    bombs_map_t bombs;
-    positions_set_t explosions;
-    scores_map_t scores;
+    CowValue<player_positions_map_t> player_positions;
+    CowValue<players_map_t> players;
+    CowValue<positions_set_t> blocks;
+    CowValue<bombs_map_t> bombs;
+    CowValue<positions_set_t> explosions;
+    CowValue<scores_map_t> scores;
 
     GameState(players_map_t &players_map, positions_set_t &initial_blocks,
               player_positions_map_t &initial_player_positions) {
@@ -145,29 +245,51 @@ struct GameState {
         players = players_map;
         blocks = initial_blocks;
         player_positions = initial_player_positions;
-        bombs = {};
-        explosions = {};
-        scores = {};
 
         for (auto &player: players_map)
-            scores.insert(std::make_pair(player.first, 0));
+            scores.write().insert(std::make_pair(player.first, 0));
 
         if (initial_player_positions.empty()) {
             for (auto &player: players_map)
-                player_positions.insert(std::make_pair(player.first, Position(0,0)));
+                player_positions.write().insert(std::make_pair(player.first, Position(0,0)));
         }
     }
     GameState() = default;
 };
 
+// A move sent to the server and not yet seen in a Turn,
+// with the last turn the client had received when sending it.
+struct PendingMove {
+    uint16_t turn;
+    uint8_t direction;
+};
+
+// A structure for client-side prediction of the player's own moves
+// (robots-client --predict-moves).
+struct MovePrediction {
+    bool enabled = false;
+    std::optional<PlayerId> own_id; // the player's robot in the current game
+    std::deque<PendingMove> pending; // oldest first, at most one per turn
+};
+
 // A structure representing the "receiving from server sending to gui" thread's
 // data concerning the game. It contains all the necessary information
 // to communicate with server and gui.
 struct GameData {
     bool waiting_for_hello;
+    bool compact_encoding = false;
+    std::optional<uint64_t> session_token; // given by the server after joining
+    std::optional<std::chrono::steady_clock::time_point> reconnect_start;
+    std::vector<char> compressed_message; // reused for every compressed message
+    StringTable strings; // of players in game_state and lobby_players, so before them
     GameParameters parameters;
     GameState game_state;
     players_map_t lobby_players;
+    MovePrediction prediction;
+
+    // Guards the game state, which the thread receiving from gui
+    // reads to send predicted moves to gui.
+    std::mutex mutex;
 
     GameData() {
         waiting_for_hello = true;
@@ -182,33 +304,60 @@ struct ConnectionsData {
 
     boost::asio::ip::udp::socket gui_socket{io_context};
     boost::asio::ip::tcp::socket server_socket{io_context};
-    boost::asio::ip::udp::endpoint gui_endpoint{};
+    std::vector<boost::asio::ip::udp::endpoint> gui_endpoints; // gui first, then its mirrors
+    std::unique_ptr<GuiShmWriter> gui_shm; // replaces sending to gui, if set
+    std::vector<mmsghdr> gui_messages; // reused for every sendmmsg to the mirrors
+    iovec gui_message_data{};
     boost::asio::ip::tcp::endpoint server_endpoint{};
     std::string player_name;
+    uint8_t capabilities = 0; // asked for after every connection
+    bool reconnect;
 
-    ConnectionsData(ClientOptions options) {
-        std::string gui_address, gui_port, server_address, server_port;
-        get_hostname_and_port(options.gui_address, gui_address, gui_port);
-        get_hostname_and_port(options.server_address, server_address, server_port);
-
-        // connect to server
-        boost::asio::ip::tcp::resolver server_r(io_context);
-        server_endpoint = *server_r.resolve(server_address, server_port);
-
-        server_socket.connect(server_endpoint);
-        if (debug) std::cerr << "connected to " << server_endpoint << "\n";
+    // Guards writes to server_socket, as the socket is replaced on reconnect.
+    std::mutex server_mutex;
 
-        server_socket.set_option(boost::asio::ip::tcp::no_delay(true));
+    ConnectionsData(ClientOptions options) {
+        auto start = std::chrono::steady_clock::now();
+        StartupTargets targets;
+        get_hostname_and_port(options.gui_address, targets.gui_host, targets.gui_port);
+        get_hostname_and_port(options.server_address, targets.server_host, targets.server_port);
+        for (auto &mirror_address : options.mirror_addresses) {
+            auto &mirror = targets.mirrors.emplace_back();
+            get_hostname_and_port(mirror_address, mirror.first, mirror.second);
+        }
 
         // create socket for communication with gui
         gui_socket = boost::asio::ip::udp::socket(
             io_context,boost::asio::ip::udp::endpoint(
                 boost::asio::ip::udp::v6(), options.port));
 
-        boost::asio::ip::udp::resolver gui_r(io_context);
-        gui_endpoint = *gui_r.resolve(gui_address, gui_port).begin();
+        // resolve both addresses and connect to server
+        connect_at_startup(io_context, targets, std::chrono::milliseconds(options.connect_timeout),
+                           server_socket, server_endpoint, gui_endpoints);
+        server_socket.set_option(boost::asio::ip::tcp::no_delay(true));
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << "connected to " << server_endpoint << " in " << std::chrono::duration_cast<
+                std::chrono::milliseconds>(elapsed).count() << " ms\n";
+
+        if (!options.gui_shm.empty()) gui_shm = std::make_unique<GuiShmWriter>(options.gui_shm);
 
         player_name = options.player_name;
+        reconnect = options.reconnect;
+        if (options.compact_encoding) capabilities |= CAPABILITY_COMPACT_ENCODING;
+        if (options.compression) capabilities |= CAPABILITY_COMPRESSION;
+        if (options.reconnect) capabilities |= CAPABILITY_RECONNECT;
+    }
+
+    // This function replaces the server connection with a new one.
+    void reconnect_to_server() {
+        boost::asio::ip::tcp::socket socket(io_context);
+        socket.connect(server_endpoint);
+        socket.set_option(boost::asio::ip::tcp::no_delay(true));
+
+        std::lock_guard<std::mutex> lock(server_mutex);
+        server_socket = std::move(socket);
+        if (debug) std::cerr << "reconnected to " << server_endpoint << "\n";
     }
 };
 
@@ -216,24 +365,33 @@ struct ConnectionsData {
 // Handles all types of events.
 struct Event {
     uint8_t event_id;
-    PlayerId player_id;
+    PlayerId player_id = 0;
     BombId bomb_id = 0;
     Position position;
     player_id_list_t robots_destroyed;
     positions_list_t blocks_destroyed;
 
     Event() = default;
-    void initialize_bomb_placed(BombId id, Position p) {
+
+    // The player placing a bomb or a block is not sent either,
+    // it is only exported (--export-file).
+    void initialize_bomb_placed(BombId id, Position p, PlayerId owner = 0) {
         event_id = (uint8_t) EventType::BombPlaced;
         bomb_id = id;
+        player_id = owner;
         position = p;
     }
 
+    // The bomb position and owner are not sent, the server only uses them
+    // to decide who is interested in the event and who gets the kills.
     void initialize_bomb_exploded(BombId id, player_id_list_t &robots,
-                                  positions_list_t &blocks) {
+                                  positions_list_t &blocks, Position p = {},
+                                  PlayerId owner = 0) {
 
         event_id = (uint8_t) EventType::BombExploded;
         bomb_id = id;
+        player_id = owner;
+        position = p;
         robots_destroyed = robots;
         blocks_destroyed = blocks;
     }
@@ -244,8 +402,9 @@ struct Event {
         position = p;
     }
 
-    void initialize_block_placed(Position p) {
+    void initialize_block_placed(Position p, PlayerId owner = 0) {
         event_id = (uint8_t) EventType::BlockPlaced;
+        player_id = owner;
         position = p;
     }
 };
@@ -255,23 +414,25 @@ struct Event {
 class Buffer {
 private:
     char *msg_buffer;
+    size_t capacity; // of msg_buffer, grows for long decompressed messages
     size_t parsed_length; // parsed length in bytes
     size_t message_length; // message length in bytes
     boost::asio::ip::tcp::socket &socket;
+    bool compact = false; // compact encoding negotiated with the server
 
 public:
     // The constructor creates char array for message.
     explicit Buffer(boost::asio::ip::tcp::socket &socket): socket(socket) {
         msg_buffer = new char[TCP_BUFFER_LENGTH];
+        capacity = TCP_BUFFER_LENGTH;
         message_length = 0;
         parsed_length = 0; // at the beginning we've parsed nothing
     }
 
     // This function receives a new portion of bytes into a buffer
     size_t receive_new_data() {
-        msg_buffer = new char[TCP_BUFFER_LENGTH];
         size_t length = socket.receive(
-                boost::asio::buffer(msg_buffer, TCP_BUFFER_LENGTH));
+                boost::asio::buffer(msg_buffer, capacity));
 
         message_length = length;
         parsed_length = 0;
@@ -284,24 +445,20 @@ public:
     size_t receive(size_t right_shift, char *new_buffer) {
         size_t length = socket.receive(
                 boost::asio::buffer(new_buffer + right_shift,
-                                    TCP_BUFFER_LENGTH - right_shift));
+                                    capacity - right_shift));
 
-        if (debug)
-            std::cerr << "received additional " << length << " bytes from server\n";
+        trace<TRACE_IO>(TraceEvent::ReceivedRest, length);
 
         return length;
     }
 
-    // This function replaces the old buffer with a new buffer.
-    // If a variable got split, [bytes_to_copy] bytes are copied from
-    // the previous buffer to the beginning of a new buffer.
+    // This function receives more data into the buffer, after the last
+    // [bytes_to_copy] unparsed bytes, which are moved to its beginning.
+    // The buffer is reused, so receiving doesn't allocate.
     void new_buffer(size_t bytes_to_copy) {
-        char *new_buffer = new char[TCP_BUFFER_LENGTH];
-        memcpy(new_buffer, msg_buffer + parsed_length, bytes_to_copy);
-
-        message_length = receive(bytes_to_copy, new_buffer) + bytes_to_copy;
+        memmove(msg_buffer, msg_buffer + parsed_length, bytes_to_copy);
+        message_length = receive(bytes_to_copy, msg_buffer) + bytes_to_copy;
         parsed_length = 0;
-        msg_buffer = new_buffer;
     }
 
     // This function reads uint8_t from the buffer
@@ -334,6 +491,92 @@ public:
         return result;
     }
 
+    uint64_t get_u64() {
+        uint64_t high = get_u32();
+        return (high << 32) | get_u32();
+    }
+
+    // This function returns the next byte without parsing it.
+    uint8_t peek_u8() {
+        while (message_length - parsed_length < sizeof(uint8_t))
+            new_buffer(message_length - parsed_length);
+
+        return *((uint8_t*) (msg_buffer + parsed_length));
+    }
+
+    // This function reads [len] bytes into [dest]. Unlike get_string,
+    // it doesn't need all of them to fit into the buffer at once.
+    void get_bytes(char *dest, size_t len) {
+        while (len > 0) {
+            if (message_length == parsed_length) new_buffer(0);
+
+            size_t chunk = std::min(len, message_length - parsed_length);
+            memcpy(dest, msg_buffer + parsed_length, chunk);
+            parsed_length += chunk;
+            dest += chunk;
+            len -= chunk;
+        }
+    }
+
+    // This function skips [len] bytes, e.g. of a dropped message.
+    void skip(size_t len) {
+        while (len > 0) {
+            if (message_length == parsed_length) new_buffer(0);
+
+            size_t chunk = std::min(len, message_length - parsed_length);
+            parsed_length += chunk;
+            len -= chunk;
+        }
+    }
+
+    // This function makes room for [len] bytes in front of the unparsed data,
+    // which are then parsed as if they were received from the socket, and
+    // returns where they have to be written. The buffer grows only if it is
+    // too small and keeps its size, so decompressed messages don't allocate.
+    char *make_room(size_t len) {
+        size_t unparsed_length = message_length - parsed_length;
+        if (len <= parsed_length) { // the parsed bytes are overwritten
+            parsed_length -= len;
+            return msg_buffer + parsed_length;
+        }
+
+        if (len + unparsed_length > capacity) {
+            size_t new_capacity = std::max(len + unparsed_length, 2 * capacity);
+            char *new_buffer = new char[new_capacity];
+            memcpy(new_buffer + len, msg_buffer + parsed_length, unparsed_length);
+            delete[] msg_buffer;
+            msg_buffer = new_buffer;
+            capacity = new_capacity;
+        }
+        else {
+            memmove(msg_buffer + len, msg_buffer + parsed_length, unparsed_length);
+        }
+        message_length = len + unparsed_length;
+        parsed_length = 0;
+        return msg_buffer;
+    }
+
+    // This function puts [len] bytes in front of the unparsed data.
+    void insert_data(const char *data, size_t len) {
+        memcpy(make_room(len), data, len);
+    }
+
+    // This function reads a LEB128 varint used by the compact encoding.
+    uint32_t get_varint() {
+        uint32_t result = 0;
+        for (unsigned shift = 0; shift < 32; shift += 7) {
+            uint8_t byte = get_u8();
+            result |= (uint32_t) (byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return result;
+    }
+
+    // This function reads a list or map length.
+    uint32_t get_length() {
+        return compact ? get_varint() : get_u32();
+    }
+
     std::string get_string(size_t len) {
         while (message_length - parsed_length < len)
             new_buffer(message_length - parsed_length);
@@ -346,7 +589,10 @@ public:
         return {result};
     }
 
+    void set_compact(bool value) { compact = value; }
+
     // getters
+    [[nodiscard]] bool is_compact() const { return compact; }
     [[nodiscard]] size_t get_parsed_len() const { return parsed_length; }
     [[nodiscard]] size_t get_msg_len() const { return message_length; }
 
@@ -0,0 +1,159 @@
+// Tests of the columnar export - events written in groups are read back
+// column by column, a file is complete after every group, and truncated
+// or corrupted files are rejected without reading past them.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unistd.h>
+#include "event-export.h"
+#include "test-utils.h"
+
+static std::string temp_path(const std::string &name) {
+    return (std::filesystem::temp_directory_path() /
+            ("event-export-test-" + std::to_string(getpid()) + "-" + name)).string();
+}
+
+static std::vector<char> read_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+static void write_file(const std::string &path, const std::vector<char> &data) {
+    std::remove(path.c_str());
+    std::ofstream file(path, std::ios::binary);
+    file.write(data.data(), (std::streamsize) data.size());
+}
+
+// Events of a turn with random values of every column, and their expected rows.
+static events_list_t random_turn(std::mt19937 &random, uint32_t game, uint16_t turn,
+                                 std::vector<std::array<uint32_t, EXPORT_COLUMNS_NUMBER>> &rows) {
+    events_list_t events(random() % 20);
+    for (auto &event : events) {
+        event.event_id = (uint8_t) (random() % 4);
+        event.player_id = (PlayerId) random();
+        event.bomb_id = (BombId) random();
+        event.position = {(uint16_t) random(), (uint16_t) random()};
+        event.robots_destroyed.resize(random() % 4);
+        event.blocks_destroyed.resize(random() % 300);
+        bool bomb = event.event_id == BombPlaced || event.event_id == BombExploded;
+        rows.push_back({game, turn, event.event_id, event.player_id, bomb ? event.bomb_id : 0,
+                        event.position.x, event.position.y, (uint32_t) event.robots_destroyed.size(),
+                        (uint32_t) event.blocks_destroyed.size()});
+    }
+    return events;
+}
+
+// Reads all columns of all groups and compares them with [rows].
+static void check_file(const std::string &path, const std::vector<std::array<uint32_t, EXPORT_COLUMNS_NUMBER>> &rows,
+                       size_t groups) {
+    EventExportReader reader(path);
+    CHECK(reader.groups_count() == groups);
+    CHECK(!reader.find_column("no such column").has_value());
+
+    std::vector<uint32_t> values;
+    for (size_t column = 0; column < EXPORT_COLUMNS_NUMBER; column++) {
+        CHECK(reader.find_column(EXPORT_COLUMNS[column].name) == column);
+        size_t row = 0;
+        bool same = true;
+        for (size_t group = 0; group < reader.groups_count(); group++) {
+            reader.read_column(group, column, values);
+            CHECK(values.size() == reader.group_rows(group));
+            for (auto value : values)
+                same = same && row < rows.size() && rows[row++][column] == value;
+        }
+        CHECK(same && row == rows.size());
+    }
+}
+
+static void test_round_trip() {
+    std::string path = temp_path("round-trip");
+    std::mt19937 random(1);
+    std::vector<std::array<uint32_t, EXPORT_COLUMNS_NUMBER>> rows;
+    {
+        EventExport event_export(path);
+        check_file(path, rows, 0);
+
+        // games numbered out of order and turns going back wrap around in delta coded columns
+        EventColumns columns;
+        for (uint32_t game : {5u, UINT32_MAX, 0u, 7u}) {
+            for (uint16_t turn = 0; turn < 5000; turn++) {
+                auto events = random_turn(random, game, (uint16_t) (turn * 40503u), rows);
+                columns.add_turn(game, (uint16_t) (turn * 40503u), events);
+            }
+        }
+        CHECK(columns.size() > 2 * EXPORT_GROUP_ROWS);
+        event_export.write_group(columns);
+        CHECK(columns.size() == 0);
+        // the file is complete after every group, also with the writer still open
+        check_file(path, rows, 3);
+
+        auto events = random_turn(random, event_export.new_game(), 1, rows);
+        columns.add_turn(0, 1, events);
+        event_export.write_group(columns);
+        check_file(path, rows, 4);
+
+        event_export.write_group(columns); // no rows, no group
+        check_file(path, rows, 4);
+    }
+    check_file(path, rows, 4);
+    std::remove(path.c_str());
+}
+
+// Opens a file and reads all its columns, returns false if it is rejected.
+static bool read_all(const std::string &path) {
+    try {
+        EventExportReader reader(path);
+        std::vector<uint32_t> values;
+        for (size_t group = 0; group < reader.groups_count(); group++)
+            for (size_t column = 0; column < EXPORT_COLUMNS_NUMBER; column++)
+                reader.read_column(group, column, values);
+        return true;
+    }
+    catch (std::runtime_error &) {
+        return false;
+    }
+}
+
+static void test_malformed_files() {
+    std::string path = temp_path("malformed");
+    std::string broken_path = temp_path("broken");
+    std::mt19937 random(2);
+    std::vector<std::array<uint32_t, EXPORT_COLUMNS_NUMBER>> rows;
+    {
+        EventExport event_export(path);
+        for (uint32_t game = 0; game < 3; game++) {
+            EventColumns columns;
+            auto events = random_turn(random, game, 0, rows);
+            columns.add_turn(game, 0, events);
+            event_export.write_group(columns);
+        }
+    }
+    std::vector<char> data = read_file(path);
+    CHECK(read_all(path));
+
+    // the tail of a file is overwritten by the next group, so no prefix is complete
+    for (size_t len = 0; len < data.size(); len++) {
+        write_file(broken_path, std::vector<char>(data.begin(), data.begin() + (long) len));
+        CHECK(!read_all(broken_path));
+    }
+
+    // corrupted bytes are either rejected or read as other values
+    for (int i = 0; i < 2000; i++) {
+        std::vector<char> corrupted = data;
+        corrupted[random() % corrupted.size()] = (char) random();
+        write_file(broken_path, corrupted);
+        read_all(broken_path);
+    }
+
+    CHECK(!read_all(temp_path("missing")));
+    std::remove(path.c_str());
+    std::remove(broken_path.c_str());
+}
+
+int main() {
+    test_round_trip();
+    test_malformed_files();
+    return test_result();
+}
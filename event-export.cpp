@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include "event-export.h"
+
+const ExportColumnInfo EXPORT_COLUMNS[EXPORT_COLUMNS_NUMBER] = {
+    {"game", 4, true}, {"turn", 2, true}, {"type", 1, false}, {"player", 1, false},
+    {"bomb", 4, false}, {"x", 2, false}, {"y", 2, false},
+    {"robots_destroyed", 2, false}, {"blocks_destroyed", 2, false}
+};
+
+// Appends a value to a column, little-endian, in the column's width.
+static void put_value(std::vector<char> &column, uint8_t width, uint32_t value) {
+    for (uint8_t i = 0; i < width; i++)
+        column.push_back((char) (value >> (8 * i)));
+}
+
+static uint32_t get_value(const char *ptr, uint8_t width) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < width; i++)
+        value |= (uint32_t) (uint8_t) ptr[i] << (8 * i);
+    return value;
+}
+
+// Returns a value cut to the width of a column, as deltas wrap around.
+static uint32_t wrap_value(uint32_t value, uint8_t width) {
+    return width == 4 ? value : value & ((1u << (8 * width)) - 1);
+}
+
+void EventColumns::add_turn(uint32_t game, uint16_t turn, const events_list_t &events) {
+    for (auto &event : events) {
+        uint32_t values[EXPORT_COLUMNS_NUMBER] = {
+            game, turn, event.event_id, event.player_id,
+            event.event_id == BombPlaced || event.event_id == BombExploded ? event.bomb_id : 0,
+            event.position.x, event.position.y,
+            (uint32_t) event.robots_destroyed.size(), (uint32_t) event.blocks_destroyed.size()
+        };
+        for (size_t i = 0; i < EXPORT_COLUMNS_NUMBER; i++)
+            put_value(columns[i], EXPORT_COLUMNS[i].width, values[i]);
+        rows++;
+    }
+}
+
+EventExport::EventExport(const std::string &path) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) throw std::system_error(errno, std::generic_category(), "can't create " + path);
+
+    std::vector<char> header(EXPORT_MAGIC, EXPORT_MAGIC + strlen(EXPORT_MAGIC));
+    put_value(header, 4, EXPORT_VERSION);
+    put_value(header, 4, EXPORT_COLUMNS_NUMBER);
+    for (auto &column : EXPORT_COLUMNS) {
+        header.push_back((char) strlen(column.name));
+        header.insert(header.end(), column.name, column.name + strlen(column.name));
+        header.push_back((char) column.width);
+        header.push_back((char) column.delta);
+    }
+    write(header.data(), header.size());
+    chunks_end = header.size();
+    write_tail();
+}
+
+EventExport::~EventExport() {
+    fclose(file);
+}
+
+void EventExport::write(const void *data, size_t len) {
+    if (fwrite(data, 1, len, file) != len)
+        throw std::system_error(errno, std::generic_category(), "writing export file");
+}
+
+// Writes the offset of the last index after the chunks, replacing the previous one.
+void EventExport::write_tail() {
+    char tail[8 + 8];
+    for (size_t i = 0; i < 8; i++)
+        tail[i] = (char) (last_index >> (8 * i));
+    memcpy(tail + 8, EXPORT_MAGIC, 8);
+
+    fseeko(file, (off_t) chunks_end, SEEK_SET);
+    write(tail, sizeof(tail));
+    if (fflush(file) != 0) throw std::system_error(errno, std::generic_category(), "writing export file");
+}
+
+void EventColumns::clear() {
+    for (auto &column : columns)
+        column.clear();
+    rows = 0;
+}
+
+// Writes [rows] rows of [columns] from [first] as a group. Called with the mutex locked.
+void EventExport::write_rows(const EventColumns &columns, uint32_t first, uint32_t rows) {
+    index.clear();
+    put_value(index, 4, (uint32_t) last_index);
+    put_value(index, 4, (uint32_t) (last_index >> 32));
+    put_value(index, 4, rows);
+
+    fseeko(file, (off_t) chunks_end, SEEK_SET);
+    for (size_t i = 0; i < EXPORT_COLUMNS_NUMBER; i++) {
+        uint8_t width = EXPORT_COLUMNS[i].width;
+        const char *data = columns.columns[i].data() + (size_t) first * width;
+        size_t length = (size_t) rows * width;
+        if (EXPORT_COLUMNS[i].delta) {
+            encoded.clear();
+            uint32_t previous = 0;
+            for (size_t offset = 0; offset < length; offset += width) {
+                uint32_t value = get_value(data + offset, width);
+                put_value(encoded, width, wrap_value(value - previous, width));
+                previous = value;
+            }
+            data = encoded.data();
+        }
+
+        size_t compressed_len = compressor.compress(data, length, 0);
+        put_value(index, 4, (uint32_t) chunks_end);
+        put_value(index, 4, (uint32_t) (chunks_end >> 32));
+        put_value(index, 4, (uint32_t) compressed_len);
+        write(compressor.data(), compressed_len);
+        chunks_end += compressed_len;
+    }
+
+    write(index.data(), index.size());
+    last_index = chunks_end;
+    chunks_end += index.size();
+    write_tail();
+}
+
+void EventExport::write_group(EventColumns &columns) {
+    std::lock_guard<std::mutex> lock(mutex);
+    try {
+        for (uint32_t first = 0; first < columns.rows; first += EXPORT_GROUP_ROWS)
+            write_rows(columns, first, std::min(columns.rows - first, (uint32_t) EXPORT_GROUP_ROWS));
+    }
+    catch (std::system_error &) {
+        columns.clear(); // the rows are lost, later ones may still be written
+        throw;
+    }
+    columns.clear();
+}
+
+// Reads [len] bytes at [offset] of a file.
+static void read_at(std::ifstream &file, uint64_t offset, char *dest, size_t len) {
+    file.seekg((std::streamoff) offset);
+    file.read(dest, (std::streamsize) len);
+    if (!file) throw std::runtime_error("export file is truncated");
+}
+
+EventExportReader::EventExportReader(const std::string &path): file(path, std::ios::binary) {
+    if (!file) throw std::runtime_error("can't open " + path);
+
+    size_t magic_len = strlen(EXPORT_MAGIC);
+    file.seekg(0, std::ios::end);
+    auto file_len = (uint64_t) file.tellg();
+    char tail[8 + 8];
+    if (file_len < 2 * magic_len + 8 + 8) throw std::runtime_error(path + " is not an export file");
+    read_at(file, file_len - sizeof(tail), tail, sizeof(tail));
+    std::vector<char> buffer(magic_len);
+    read_at(file, 0, buffer.data(), magic_len);
+    if (memcmp(tail + 8, EXPORT_MAGIC, magic_len) != 0 || memcmp(buffer.data(), EXPORT_MAGIC, magic_len) != 0)
+        throw std::runtime_error(path + " is not an export file");
+    uint64_t tail_offset = file_len - sizeof(tail);
+
+    // reads values of [buffer] read at [offset] of the file
+    size_t position = 0;
+    auto load = [&](uint64_t offset, uint64_t len) {
+        if (offset > tail_offset || tail_offset - offset < len)
+            throw std::runtime_error(path + " has a malformed index");
+        buffer.resize(len);
+        read_at(file, offset, buffer.data(), len);
+        position = 0;
+    };
+    auto get = [&](uint8_t width) {
+        if (buffer.size() - position < width) throw std::runtime_error(path + " is malformed");
+        uint32_t value = get_value(buffer.data() + position, width);
+        position += width;
+        return value;
+    };
+
+    // the header is at most 255 bytes a column, the file's tail is never read as a part of it
+    load(magic_len, std::min<uint64_t>(tail_offset - magic_len, 8 + (uint64_t) EXPORT_COLUMNS_NUMBER * 258));
+    if (get(4) != EXPORT_VERSION) throw std::runtime_error(path + " is of another version");
+    uint32_t columns_count = get(4);
+    for (uint32_t i = 0; i < columns_count; i++) {
+        Column column;
+        uint8_t name_len = (uint8_t) get(1);
+        if (buffer.size() - position < name_len) throw std::runtime_error(path + " has a malformed header");
+        column.name.assign(buffer.data() + position, name_len);
+        position += name_len;
+        column.width = (uint8_t) get(1);
+        column.delta = get(1) != 0;
+        if (column.width == 0 || column.width > 4) throw std::runtime_error(path + " has a malformed header");
+        columns.push_back(column);
+    }
+    uint64_t header_end = magic_len + position;
+
+    // indexes are linked from the last one, each before the ones written after it
+    uint64_t index_offset = get_value(tail, 4) | (uint64_t) get_value(tail + 4, 4) << 32;
+    uint64_t index_len = 8 + 4 + (uint64_t) columns_count * 12;
+    while (index_offset != 0) {
+        if (index_offset < header_end) throw std::runtime_error(path + " has a malformed index");
+        load(index_offset, index_len);
+        uint64_t previous = get(4);
+        previous |= (uint64_t) get(4) << 32;
+        if (previous >= index_offset) throw std::runtime_error(path + " has a malformed index");
+
+        Group group;
+        group.rows = get(4);
+        if (group.rows > EXPORT_GROUP_ROWS) throw std::runtime_error(path + " has a malformed index");
+        for (uint32_t j = 0; j < columns_count; j++) {
+            uint64_t offset = get(4);
+            offset |= (uint64_t) get(4) << 32;
+            uint32_t compressed_len = get(4);
+            // chunks of a group are between the header and the group's index
+            if (offset < header_end || offset > index_offset || index_offset - offset < compressed_len)
+                throw std::runtime_error(path + " has a malformed index");
+            group.chunks.emplace_back(offset, compressed_len);
+        }
+        groups.push_back(group);
+        index_offset = previous;
+    }
+    std::reverse(groups.begin(), groups.end());
+}
+
+std::optional<size_t> EventExportReader::find_column(const std::string &name) const {
+    for (size_t i = 0; i < columns.size(); i++)
+        if (columns[i].name == name) return i;
+    return {};
+}
+
+void EventExportReader::read_column(size_t group, size_t column, std::vector<uint32_t> &values) {
+    auto [offset, compressed_len] = groups[group].chunks[column];
+    uint8_t width = columns[column].width;
+    uint32_t rows = groups[group].rows;
+
+    compressed.resize(compressed_len);
+    raw.resize((size_t) rows * width);
+    read_at(file, offset, compressed.data(), compressed_len);
+    if (!lz4_decompress(compressed.data(), compressed_len, raw.data(), raw.size()))
+        throw std::runtime_error("malformed chunk of column " + columns[column].name);
+
+    values.resize(rows);
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < rows; i++) {
+        uint32_t value = get_value(raw.data() + (size_t) i * width, width);
+        if (columns[column].delta) value = wrap_value(previous + value, width);
+        values[i] = previous = value;
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef BOMBOWE_ROBOTY_EVENT_EXPORT_H
+#define BOMBOWE_ROBOTY_EVENT_EXPORT_H
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "definitions.h"
+#include "lz4-codec.h"
+
+/*
+Columnar export of game events for offline analytics. Every event is a row with
+the columns below. Rows are gathered by each thread and written in groups of up
+to EXPORT_GROUP_ROWS; each column of a group is a separate chunk - a little-endian
+array of the column's type, delta coded if the column mostly grows, compressed
+with LZ4. Indexes of the chunks let a reader seek straight to the columns
+it needs and skip the others. Groups of different threads are interleaved,
+rows of a game are in order within its groups.
+
+    file:   "ROBOTSEV" header {chunks... index}... last_index:u64 "ROBOTSEV"
+    header: version:u32 columns:u32 {name_length:u8 name width:u8 delta:u8}...
+    index:  previous_index:u64 rows:u32 {offset:u64 compressed_length:u32}...
+
+Every group is appended with an index of its chunks, linked to the index of the
+previous group (0 for the first one), replacing only the last 16 bytes of the
+file - so the file is complete after every group, even if the program is killed,
+and writing a group doesn't depend on the number of groups before it.
+*/
+
+#define EXPORT_MAGIC      "ROBOTSEV"
+#define EXPORT_VERSION    2
+#define EXPORT_GROUP_ROWS (1 << 16)
+
+enum ExportColumn {
+    ExportGame,             // game number
+    ExportTurn,
+    ExportType,             // EventType
+    ExportPlayer,           // who moved or placed, the bomb's owner for explosions
+    ExportBomb,             // bomb id of bomb events, 0 otherwise
+    ExportX,                // the player's, block's or bomb's position
+    ExportY,
+    ExportRobotsDestroyed,  // by an explosion
+    ExportBlocksDestroyed,
+    EXPORT_COLUMNS_NUMBER
+};
+
+struct ExportColumnInfo {
+    const char *name;
+    uint8_t width; // bytes per value
+    bool delta;
+};
+
+extern const ExportColumnInfo EXPORT_COLUMNS[EXPORT_COLUMNS_NUMBER];
+
+// Rows gathered by a thread before they are written as a group.
+class EventColumns {
+private:
+    std::array<std::vector<char>, EXPORT_COLUMNS_NUMBER> columns;
+    uint32_t rows = 0;
+
+    friend class EventExport;
+
+public:
+    void add_turn(uint32_t game, uint16_t turn, const events_list_t &events);
+    void clear();
+
+    [[nodiscard]] uint32_t size() const { return rows; }
+};
+
+// An export file written by many threads.
+class EventExport {
+private:
+    std::mutex mutex;
+    FILE *file;
+    uint64_t chunks_end; // where the file's tail starts
+    uint64_t last_index = 0;
+    std::vector<char> encoded; // reused for delta coding
+    std::vector<char> index;
+    Lz4Compressor compressor;
+    std::atomic<uint32_t> next_game{0};
+
+    void write(const void *data, size_t len);
+    void write_tail();
+    void write_rows(const EventColumns &columns, uint32_t first, uint32_t rows);
+
+public:
+    // Creates the file. Throws std::system_error if it can't be created.
+    explicit EventExport(const std::string &path);
+    ~EventExport();
+
+    EventExport(const EventExport &) = delete;
+    EventExport &operator=(const EventExport &) = delete;
+
+    // Returns a number for a new game, for games not numbered by the caller.
+    uint32_t new_game() { return next_game++; }
+
+    // Writes gathered rows as groups of up to EXPORT_GROUP_ROWS, if there
+    // are any, and clears [columns]. Throws std::system_error if writing fails.
+    void write_group(EventColumns &columns);
+};
+
+// Reads chosen columns of an export file.
+class EventExportReader {
+private:
+    struct Column {
+        std::string name;
+        uint8_t width;
+        bool delta;
+    };
+    struct Group {
+        uint32_t rows;
+        std::vector<std::pair<uint64_t, uint32_t>> chunks; // offsets and compressed lengths
+    };
+
+    std::ifstream file;
+    std::vector<Column> columns;
+    std::vector<Group> groups;
+    std::vector<char> compressed; // reused for every chunk
+    std::vector<char> raw;
+
+public:
+    // Reads the header and indexes of all groups. Throws std::runtime_error
+    // if the file can't be read or isn't an export file.
+    explicit EventExportReader(const std::string &path);
+
+    std::optional<size_t> find_column(const std::string &name) const;
+
+    [[nodiscard]] size_t groups_count() const { return groups.size(); }
+    [[nodiscard]] uint32_t group_rows(size_t group) const { return groups[group].rows; }
+
+    // Reads values of a column in a group. Throws std::runtime_error
+    // if the chunk is malformed.
+    void read_column(size_t group, size_t column, std::vector<uint32_t> &values);
+};
+
+#endif //BOMBOWE_ROBOTY_EVENT_EXPORT_H
@@ -0,0 +1,83 @@
+#include "footprint-cache.h"
+#include "game-handler.h"
+
+void FootprintCache::reset(uint16_t explosion_radius, uint16_t board_size_x, uint16_t board_size_y) {
+    radius = explosion_radius;
+    size_x = board_size_x;
+    size_y = board_size_y;
+    while (!footprints.empty()) {
+        spare_fields.push_back(std::move(footprints.front().fields));
+        footprints.pop_front();
+    }
+    first_bomb = 0;
+
+    dense = (size_t) size_x * size_y <= FOOTPRINT_DENSE_CELLS;
+    sparse_cells.clear();
+    if (!dense) {
+        dense_cells = {}; // frees the memory of a dense game's table
+        return;
+    }
+    dense_cells.resize((size_t) size_x * size_y);
+    for (auto &bombs : dense_cells)
+        bombs.clear();
+}
+
+bool FootprintCache::in_danger(Position position) const {
+    if (dense) return !dense_cells[(size_t) position.y * size_x + position.x].empty();
+    auto cell_it = sparse_cells.find((uint32_t) position.x << 16 | position.y);
+    return cell_it != sparse_cells.end() && !cell_it->second.empty();
+}
+
+void FootprintCache::index_footprint(BombId id, Footprint &footprint) {
+    for (auto &field : footprint.fields)
+        covering_bombs(field).push_back(id);
+}
+
+void FootprintCache::unindex_footprint(BombId id, Footprint &footprint) {
+    for (auto &field : footprint.fields) {
+        std::vector<BombId> &bombs = covering_bombs(field);
+        std::erase(bombs, id);
+        if (!dense && bombs.empty()) sparse_cells.erase((uint32_t) field.x << 16 | field.y);
+    }
+}
+
+void FootprintCache::add_bomb(BombId id, Position position, const positions_set_t &blocks) {
+    if (footprints.empty()) first_bomb = id;
+    Footprint &footprint = footprints.emplace_back();
+    footprint.bomb = position;
+    if (!spare_fields.empty()) {
+        footprint.fields = std::move(spare_fields.back());
+        footprint.fields.clear();
+        spare_fields.pop_back();
+    }
+    get_explosion_fields(position, radius, blocks, size_x, size_y, footprint.fields);
+    index_footprint(id, footprint);
+}
+
+void FootprintCache::remove_bomb(BombId id) {
+    if (id < first_bomb || id - first_bomb >= footprints.size()) return;
+    Footprint &footprint = footprints[id - first_bomb];
+    if (footprint.removed) return;
+    unindex_footprint(id, footprint);
+    footprint.removed = true;
+
+    while (!footprints.empty() && footprints.front().removed) {
+        spare_fields.push_back(std::move(footprints.front().fields));
+        footprints.pop_front();
+        first_bomb++;
+    }
+}
+
+void FootprintCache::block_changed(Position position, const positions_set_t &blocks) {
+    if (!in_danger(position)) return;
+
+    // the list changes while footprints are indexed again
+    std::vector<BombId> changed = covering_bombs(position);
+    for (auto id : changed) {
+        Footprint &footprint = footprints[id - first_bomb];
+        unindex_footprint(id, footprint);
+        footprint.fields.clear();
+        get_explosion_fields(footprint.bomb, radius, blocks, size_x, size_y, footprint.fields);
+        index_footprint(id, footprint);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef BOMBOWE_ROBOTY_FOOTPRINT_CACHE_H
+#define BOMBOWE_ROBOTY_FOOTPRINT_CACHE_H
+
+#include <deque>
+#include <unordered_map>
+#include "definitions.h"
+
+/*
+Explosion footprints of the bombs on the board, computed when a bomb is placed.
+A footprint depends only on blocks on its own cells - a block stops a ray
+on the cell it stands on - so a reverse index from cells to the bombs whose
+footprints cover them tells which footprints a new or destroyed block changes.
+Only those are computed again; explosions and danger checks are lookups.
+The index is a table of all cells for boards of up to FOOTPRINT_DENSE_CELLS
+cells, whose lists keep their memory between bombs and games, and a hash map
+of only the cells in footprints for larger ones, whose table would take
+megabytes per room for a few dozen bombs.
+Bombs get consecutive ids and all explode after the same time, so footprints
+are kept in a queue ordered by bomb id.
+*/
+
+#define FOOTPRINT_DENSE_CELLS (1 << 14)
+
+class FootprintCache {
+private:
+    uint16_t radius = 0;
+    uint16_t size_x = 0;
+    uint16_t size_y = 0;
+    struct Footprint {
+        Position bomb;
+        positions_list_t fields;
+        bool removed = false;
+    };
+
+    std::deque<Footprint> footprints; // of bombs first_bomb, first_bomb + 1, ...
+    BombId first_bomb = 0;
+    std::vector<positions_list_t> spare_fields;
+    bool dense = true;
+    std::vector<std::vector<BombId>> dense_cells; // by y * size_x + x
+    std::unordered_map<uint32_t, std::vector<BombId>> sparse_cells; // by x << 16 | y
+
+    // Returns bombs whose footprints cover the cell.
+    std::vector<BombId> &covering_bombs(Position position) {
+        if (dense) return dense_cells[(size_t) position.y * size_x + position.x];
+        return sparse_cells[(uint32_t) position.x << 16 | position.y];
+    }
+
+    void index_footprint(BombId id, Footprint &footprint);
+    void unindex_footprint(BombId id, Footprint &footprint);
+
+public:
+    // Clears the cache for a new game.
+    void reset(uint16_t explosion_radius, uint16_t board_size_x, uint16_t board_size_y);
+
+    // Bombs have to be added in the order of their ids.
+    void add_bomb(BombId id, Position position, const positions_set_t &blocks);
+    void remove_bomb(BombId id);
+
+    // Updates footprints crossing a cell where a block has been placed or destroyed.
+    void block_changed(Position position, const positions_set_t &blocks);
+
+    // Returns fields which a bomb's explosion would reach now.
+    const positions_list_t &footprint(BombId id) const { return footprints.at(id - first_bomb).fields; }
+
+    // Returns true if an explosion of any bomb on the board would reach the cell.
+    bool in_danger(Position position) const;
+};
+
+#endif //BOMBOWE_ROBOTY_FOOTPRINT_CACHE_H
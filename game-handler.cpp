@@ -1,7 +1,8 @@
 #include "game-handler.h"
+#include "message-serializer.h"
 
 // This function reads and returns player id and player data from a buffer.
-player_id_and_player_t get_player_data(Buffer &msg_buffer) {
+player_id_and_player_t get_player_data(Buffer &msg_buffer, StringTable &strings) {
     PlayerId id = msg_buffer.get_u8();
 
     uint8_t name_len = msg_buffer.get_u8();
@@ -10,95 +11,150 @@ player_id_and_player_t get_player_data(Buffer &msg_buffer) {
     uint8_t address_len = msg_buffer.get_u8();
     std::string player_address = msg_buffer.get_string(address_len);
 
-    return std::make_pair(id, Player(player_name, player_address));
+    return std::make_pair(id, Player(strings, player_name, player_address));
 }
 
 // This function reads and returns player id and score from a buffer.
 player_id_and_score_t get_player_score(Buffer &msg_buffer) {
     PlayerId id = msg_buffer.get_u8();
-    Score score = msg_buffer.get_u32();
+    Score score = msg_buffer.is_compact() ? msg_buffer.get_varint() : msg_buffer.get_u32();
 
     return std::make_pair(id, score);
 }
 
+// This function reads and returns position from a buffer.
+static Position get_position(Buffer &msg_buffer) {
+    if (msg_buffer.is_compact()) {
+        auto x = (uint16_t) msg_buffer.get_varint();
+        auto y = (uint16_t) msg_buffer.get_varint();
+        return {x, y};
+    }
+    uint16_t x = msg_buffer.get_u16();
+    uint16_t y = msg_buffer.get_u16();
+    return {x, y};
+}
+
+// This function reads a bomb id from a buffer.
+static BombId get_bomb_id(Buffer &msg_buffer) {
+    return msg_buffer.is_compact() ? msg_buffer.get_varint() : msg_buffer.get_u32();
+}
+
 // This function reads information about a new bomb from a buffer
 // and places it in the bomb set.
 static void add_bomb(Buffer &msg_buffer, GameState &state, uint16_t timer) {
-    BombId id = msg_buffer.get_u32();
-    uint16_t x = msg_buffer.get_u16();
-    uint16_t y = msg_buffer.get_u16();
+    BombId id = get_bomb_id(msg_buffer);
+    Position position = get_position(msg_buffer);
 
     // add a new bomb to the set
-    state.bombs.insert(std::make_pair(id, Bomb(Position(x, y), timer)));
+    state.bombs.write().insert(std::make_pair(id, Bomb(position, timer)));
 }
 
-// This function calculates explosion fields
-// and adds them to the explosions set.
-static void add_explosion_fields(BombId bomb, uint16_t radius, GameState &state,
-                          uint16_t size_x, uint16_t size_y) {
+void get_explosion_fields(Position bomb, uint16_t radius, const positions_set_t &blocks,
+                          uint16_t size_x, uint16_t size_y, positions_list_t &fields) {
 
-    uint16_t pos_x = state.bombs[bomb].position.x;
-    uint16_t pos_y = state.bombs[bomb].position.y;
+    uint16_t pos_x = bomb.x;
+    uint16_t pos_y = bomb.y;
 
-    state.explosions.insert(Position(pos_x, pos_y)); // explosion center
-    if (state.blocks.find(Position(pos_x, pos_y)) != state.blocks.end()) return;
+    fields.push_back(Position(pos_x, pos_y)); // explosion center
+    if (blocks.find(Position(pos_x, pos_y)) != blocks.end()) return;
 
     for (uint16_t i = 1; i <= radius; i++) { // up
         if (pos_y + i == size_y) break; // break if we "get out of board"
-        state.explosions.insert(Position(pos_x, (uint16_t) (pos_y + i)));
+        fields.push_back(Position(pos_x, (uint16_t) (pos_y + i)));
         // if there is a block on explosion's path, it stops the explosion from spreading
-        if (state.blocks.find(Position(pos_x, (uint16_t) (pos_y + i))) != state.blocks.end()) break;
+        if (blocks.find(Position(pos_x, (uint16_t) (pos_y + i))) != blocks.end()) break;
     }
 
     // analogically
     for (uint16_t i = 1; i <= radius; i++) { // down
         if (pos_y - i == -1) break;
-        state.explosions.insert(Position(pos_x, (uint16_t) (pos_y - i)));
-        if (state.blocks.find(Position(pos_x, (uint16_t) (pos_y - i))) != state.blocks.end()) break;
+        fields.push_back(Position(pos_x, (uint16_t) (pos_y - i)));
+        if (blocks.find(Position(pos_x, (uint16_t) (pos_y - i))) != blocks.end()) break;
     }
 
     for (uint16_t i = 1; i <= radius; i++) { // left
         if (pos_x - i == -1) break;
-        state.explosions.insert(Position((uint16_t) (pos_x - i), pos_y));
-        if (state.blocks.find(Position((uint16_t) (pos_x - i), pos_y)) != state.blocks.end()) break;
+        fields.push_back(Position((uint16_t) (pos_x - i), pos_y));
+        if (blocks.find(Position((uint16_t) (pos_x - i), pos_y)) != blocks.end()) break;
     }
 
     for (uint16_t i = 1; i <= radius; i++) { // right
         if (pos_x + i == size_x) break;
-        state.explosions.insert(Position((uint16_t) (pos_x + i), pos_y));
-        if (state.blocks.find(Position((uint16_t) (pos_x + i), pos_y)) != state.blocks.end()) break;
+        fields.push_back(Position((uint16_t) (pos_x + i), pos_y));
+        if (blocks.find(Position((uint16_t) (pos_x + i), pos_y)) != blocks.end()) break;
     }
 }
 
-// This function reads and returns position from a buffer.
-static Position get_position(Buffer &msg_buffer) {
-    uint16_t x = msg_buffer.get_u16();
-    uint16_t y = msg_buffer.get_u16();
-    return {x, y};
+// This function calculates explosion fields
+// and adds them to the explosions set.
+static void add_explosion_fields(BombId bomb, uint16_t radius, GameState &state,
+                          uint16_t size_x, uint16_t size_y) {
+
+    // the server may have filtered out placement of a far away bomb
+    auto bomb_it = state.bombs.find(bomb);
+    if (bomb_it == state.bombs.end()) return;
+
+    positions_list_t fields{};
+    get_explosion_fields(bomb_it->second.position, radius, state.blocks.get(),
+                         size_x, size_y, fields);
+    state.explosions.write().insert(fields.begin(), fields.end());
+}
+
+// This function reads [count] bit-packed player ids (compact encoding).
+static void get_packed_player_ids(Buffer &msg_buffer, uint32_t count, uint8_t id_bits,
+                                  player_id_set_t &players) {
+    uint32_t bits = 0, bits_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        while (bits_count < id_bits) {
+            bits |= (uint32_t) msg_buffer.get_u8() << bits_count;
+            bits_count += 8;
+        }
+        players.insert((PlayerId) (bits & ((1u << id_bits) - 1)));
+        bits >>= id_bits;
+        bits_count -= id_bits;
+    }
+}
+
+// This function reads a delta-coded position following [previous]
+// on a sorted position list (compact encoding).
+static Position get_next_delta_position(Buffer &msg_buffer, Position previous) {
+    auto dx = (uint16_t) msg_buffer.get_varint();
+    auto y = (uint16_t) msg_buffer.get_varint();
+    if (dx == 0) y = (uint16_t) (previous.y + y);
+    return {(uint16_t) (previous.x + dx), y};
 }
 
 // This function simulates explosion - adds destroyed robots to players_killed,
 // destroyed block positions to blocks_destroyed and explosion positions
 // to state.explosions.
-static void simulate_explosion(Buffer &msg_buffer, uint16_t radius, GameState &state,
-                        uint16_t size_x, uint16_t size_y, player_id_set_t &players_killed,
-                        positions_set_t &blocks_destroyed) {
+static void simulate_explosion(Buffer &msg_buffer, GameParameters &params, GameState &state,
+                        player_id_set_t &players_killed, positions_set_t &blocks_destroyed) {
 
-    BombId bomb_id = msg_buffer.get_u32();
-    add_explosion_fields(bomb_id, radius, state, size_x, size_y);
-    state.bombs.erase(bomb_id);
+    BombId bomb_id = get_bomb_id(msg_buffer);
+    add_explosion_fields(bomb_id, params.explosion_radius, state, params.size_x, params.size_y);
+    state.bombs.write().erase(bomb_id);
 
     // helper sets - players_killed and blocks_destroyed
     // ensure that a (player doesn't die)/(block doesn't explode) twice in a turn
-    uint32_t destroyed_players = msg_buffer.get_u32();
-    for (size_t i = 0; i < destroyed_players; i++) {
-        PlayerId player = msg_buffer.get_u8();
-        players_killed.insert(player);
+    uint32_t destroyed_players = msg_buffer.get_length();
+    if (msg_buffer.is_compact()) {
+        get_packed_player_ids(msg_buffer, destroyed_players,
+                              player_id_bits(params.players_count), players_killed);
+    }
+    else {
+        for (size_t i = 0; i < destroyed_players; i++) {
+            PlayerId player = msg_buffer.get_u8();
+            players_killed.insert(player);
+        }
     }
 
-    uint32_t destroyed_blocks = msg_buffer.get_u32();
+    uint32_t destroyed_blocks = msg_buffer.get_length();
+    Position block_position{0, 0};
     for (size_t i = 0; i < destroyed_blocks; i++) {
-        Position block_position = get_position(msg_buffer);
+        if (msg_buffer.is_compact() && i > 0)
+            block_position = get_next_delta_position(msg_buffer, block_position);
+        else
+            block_position = get_position(msg_buffer);
         blocks_destroyed.insert(block_position);
     }
 }
@@ -109,16 +165,15 @@ static void move_player(Buffer &msg_buffer, GameState &state) {
     PlayerId id = msg_buffer.get_u8();
     Position pos = get_position(msg_buffer);
 
-    // delete old, insert new player position
-    state.player_positions.erase(id);
-    state.player_positions.insert(std::make_pair(id, pos));
+    // replace the player position
+    state.player_positions.write().insert_or_assign(id, pos);
 }
 
 // This function reads new block position from a buffer and
 // adds the block GameState.
 static void add_block(Buffer &msg_buffer, GameState &state) {
     Position block_position = get_position(msg_buffer);
-    state.blocks.insert(block_position);
+    state.blocks.write().insert(block_position);
 }
 
 // This function calculates game state after one turn.
@@ -126,15 +181,16 @@ void aggregate_game_state(Buffer &msg_buffer, GameState &state,
                           GameParameters &params) {
 
     // firstly, reduce every bomb's timer
-    for (const auto& bomb: state.bombs)
-        state.bombs[bomb.first].timer = (uint16_t) (state.bombs[bomb.first].timer - 1);
+    for (auto &bomb: state.bombs.write())
+        bomb.second.timer = (uint16_t) (bomb.second.timer - 1);
 
     player_id_set_t players_killed = {};
     positions_set_t blocks_destroyed = {};
-    uint16_t turn = msg_buffer.get_u16();
+    uint16_t turn = msg_buffer.is_compact() ? (uint16_t) msg_buffer.get_varint() :
+                                              msg_buffer.get_u16();
     state.turn = turn;
 
-    uint32_t events_list_size = msg_buffer.get_u32();
+    uint32_t events_list_size = msg_buffer.get_length();
     for (size_t i = 0; i < events_list_size; i++) {
         uint8_t event_type = msg_buffer.get_u8();
 
@@ -143,8 +199,7 @@ void aggregate_game_state(Buffer &msg_buffer, GameState &state,
                 add_bomb(msg_buffer, state, params.bomb_timer);
                 break;
             case BombExploded:
-                simulate_explosion(msg_buffer, params.explosion_radius, state,
-                                   params.size_x, params.size_y, players_killed,
+                simulate_explosion(msg_buffer, params, state, players_killed,
                                    blocks_destroyed);
                 break;
             case PlayerMoved:
@@ -156,7 +211,56 @@ void aggregate_game_state(Buffer &msg_buffer, GameState &state,
         }
     }
     for (auto player: players_killed)
-        state.scores[player] += 1; // add scores
+        state.scores.write()[player] += 1; // add scores
     for (const auto& block: blocks_destroyed)
-        state.blocks.erase(block); // destroy blocks
+        state.blocks.write().erase(block); // destroy blocks
+}
+
+void read_game_snapshot(Buffer &msg_buffer, GameState &state, StringTable &strings) {
+    auto get_u16_or_varint = [&msg_buffer]() {
+        return msg_buffer.is_compact() ? (uint16_t) msg_buffer.get_varint() :
+                                         msg_buffer.get_u16();
+    };
+
+    players_map_t players{};
+    positions_set_t blocks{};
+    player_positions_map_t player_positions{};
+    uint16_t turn = get_u16_or_varint();
+
+    uint32_t players_count = msg_buffer.get_length();
+    for (size_t i = 0; i < players_count; i++)
+        players.insert(get_player_data(msg_buffer, strings));
+
+    uint32_t positions_count = msg_buffer.get_length();
+    for (size_t i = 0; i < positions_count; i++) {
+        PlayerId id = msg_buffer.get_u8();
+        player_positions.insert(std::make_pair(id, get_position(msg_buffer)));
+    }
+
+    uint32_t blocks_count = msg_buffer.get_length();
+    Position block_position{0, 0};
+    for (size_t i = 0; i < blocks_count; i++) {
+        if (msg_buffer.is_compact() && i > 0)
+            block_position = get_next_delta_position(msg_buffer, block_position);
+        else
+            block_position = get_position(msg_buffer);
+        blocks.insert(block_position);
+    }
+
+    state = GameState(players, blocks, player_positions);
+    state.turn = turn;
+
+    uint32_t bombs_count = msg_buffer.get_length();
+    for (size_t i = 0; i < bombs_count; i++) {
+        BombId id = get_bomb_id(msg_buffer);
+        Position position = get_position(msg_buffer);
+        uint16_t timer = get_u16_or_varint();
+        state.bombs.write().insert(std::make_pair(id, Bomb(position, timer)));
+    }
+
+    uint32_t scores_count = msg_buffer.get_length();
+    for (size_t i = 0; i < scores_count; i++) {
+        player_id_and_score_t score = get_player_score(msg_buffer);
+        state.scores.write()[score.first] = score.second;
+    }
 }
@@ -3,11 +3,20 @@
 
 #include "definitions.h"
 
-player_id_and_player_t get_player_data(Buffer &msg_buffer);
+// This function reads player id and player data, interning their strings in [strings].
+player_id_and_player_t get_player_data(Buffer &msg_buffer, StringTable &strings);
 
 player_id_and_score_t get_player_score(Buffer &msg_buffer);
 
+// This function calculates fields covered by explosion of a bomb
+// and appends them to [fields]. Used both by the client and the server.
+void get_explosion_fields(Position bomb, uint16_t radius, const positions_set_t &blocks,
+                          uint16_t size_x, uint16_t size_y, positions_list_t &fields);
+
 void aggregate_game_state(Buffer &msg_buffer, GameState &state,
                           GameParameters &params);
 
+// This function reads GameSnapshot message (without its type) into [state].
+void read_game_snapshot(Buffer &msg_buffer, GameState &state, StringTable &strings);
+
 #endif //BOMBOWE_ROBOTY_GAME_HANDLER_H
@@ -0,0 +1,204 @@
+#include "game-rules.h"
+#include "game-handler.h"
+
+// This function returns a random position on the board.
+static Position random_position(ServerOptions &options, std::minstd_rand &random) {
+    auto x = (uint16_t) ((uint16_t) random() % options.size_x);
+    auto y = (uint16_t) ((uint16_t) random() % options.size_y);
+    return {x, y};
+}
+
+events_list_t start_game(ServerGame &game, ServerOptions &options,
+                         players_map_t &players, std::minstd_rand &random) {
+
+    positions_set_t initial_blocks;
+    player_positions_map_t player_positions;
+    for (int i = 0; i < options.initial_blocks; i++)
+        initial_blocks.insert(random_position(options, random));
+
+    for (auto &player: players)
+        player_positions.insert(std::make_pair(player.first,
+                                               random_position(options, random)));
+
+    game.state = GameState(players, initial_blocks, player_positions);
+    game.next_bomb_id = 0;
+    game.footprints.reset(options.explosion_radius, options.size_x, options.size_y);
+
+    events_list_t events{};
+    for (auto player_pos : game.state.player_positions) {
+        Event event;
+        event.initialize_player_moved(player_pos.first, player_pos.second);
+        events.push_back(event);
+    }
+
+    for (auto block : game.state.blocks) {
+        Event event;
+        event.initialize_block_placed(block);
+        events.push_back(event);
+    }
+    return events;
+}
+
+events_list_t restore_game(ServerGame &game, ServerOptions &options, GameState &state,
+                           BombId next_bomb_id) {
+    game.state = state;
+    game.next_bomb_id = next_bomb_id;
+    game.footprints.reset(options.explosion_radius, options.size_x, options.size_y);
+
+    events_list_t events{};
+    for (auto &player_pos : game.state.player_positions) {
+        Event event;
+        event.initialize_player_moved(player_pos.first, player_pos.second);
+        events.push_back(event);
+    }
+    for (auto block : game.state.blocks) {
+        Event event;
+        event.initialize_block_placed(block);
+        events.push_back(event);
+    }
+    // bombs are ordered by id, as the footprint cache needs
+    for (auto &bomb : game.state.bombs) {
+        game.footprints.add_bomb(bomb.first, bomb.second.position, game.state.blocks.get());
+        Event event;
+        event.initialize_bomb_placed(bomb.first, bomb.second.position, bomb.second.owner);
+        events.push_back(event);
+    }
+    return events;
+}
+
+// This function explodes a bomb - finds destroyed robots and blocks in its
+// footprint and adds BombExploded event to the events list.
+static void explode_bomb(BombId id, Bomb &bomb, ServerGame &game, events_list_t &events,
+                         player_id_set_t &robots_destroyed, positions_set_t &blocks_destroyed) {
+
+    GameState &state = game.state;
+    const positions_list_t &fields = game.footprints.footprint(id);
+
+    player_id_list_t robots{};
+    positions_list_t blocks{};
+    positions_set_t fields_set(fields.begin(), fields.end());
+    for (auto &player_pos : state.player_positions) {
+        if (fields_set.find(player_pos.second) != fields_set.end())
+            robots.push_back(player_pos.first);
+    }
+    for (auto &field : fields) {
+        if (state.blocks.find(field) != state.blocks.end())
+            blocks.push_back(field);
+    }
+
+    state.explosions.write().insert(fields.begin(), fields.end());
+    robots_destroyed.insert(robots.begin(), robots.end());
+    blocks_destroyed.insert(blocks.begin(), blocks.end());
+
+    Event event;
+    event.initialize_bomb_exploded(id, robots, blocks, bomb.position, bomb.owner);
+    events.push_back(event);
+    game.footprints.remove_bomb(id);
+}
+
+// This function moves a robot in a given direction,
+// if the target field is on the board and there is no block on it.
+static bool move_robot(Position &position, uint8_t direction, GameState &state,
+                       ServerOptions &options) {
+    int x = position.x, y = position.y;
+    switch ((Direction) direction) {
+        case Up: y++; break;
+        case Right: x++; break;
+        case Down: y--; break;
+        case Left: x--; break;
+    }
+
+    if (x < 0 || y < 0 || x >= options.size_x || y >= options.size_y) return false;
+    Position target((uint16_t) x, (uint16_t) y);
+    if (state.blocks.find(target) != state.blocks.end()) return false;
+
+    position = target;
+    return true;
+}
+
+// This function applies a player's action and adds the resulting event.
+static void apply_action(PlayerId id, PlayerAction &action, ServerGame &game,
+                         ServerOptions &options, events_list_t &events) {
+
+    GameState &state = game.state;
+    Position position = state.player_positions.at(id);
+    Event event;
+
+    switch (action.type) {
+        case ClientPlaceBomb:
+            state.bombs.write().insert(std::make_pair(game.next_bomb_id,
+                                              Bomb(position, options.bomb_timer, id)));
+            game.footprints.add_bomb(game.next_bomb_id, position, state.blocks.get());
+            event.initialize_bomb_placed(game.next_bomb_id++, position, id);
+            events.push_back(event);
+            break;
+        case ClientPlaceBlock:
+            if (state.blocks.write().insert(position).second) {
+                game.footprints.block_changed(position, state.blocks.get());
+                event.initialize_block_placed(position, id);
+                events.push_back(event);
+            }
+            break;
+        case ClientMove:
+            // only a move changes the positions, so only it may copy them
+            if (move_robot(position, action.direction, state, options)) {
+                state.player_positions.write()[id] = position;
+                event.initialize_player_moved(id, position);
+                events.push_back(event);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+events_list_t play_turn(ServerGame &game, ServerOptions &options,
+                        actions_table_t &actions, std::minstd_rand &random) {
+
+    GameState &state = game.state;
+    events_list_t events{};
+    player_id_set_t robots_destroyed{};
+    positions_set_t blocks_destroyed{};
+    if (!state.explosions.empty()) state.explosions = {};
+
+    // firstly, reduce every bomb's timer and explode bombs;
+    // the containers are only written, and so copied, when they change
+    if (!state.bombs.empty()) {
+        bombs_map_t &bombs = state.bombs.write();
+        for (auto it = bombs.begin(); it != bombs.end();) {
+            it->second.timer = (uint16_t) (it->second.timer - 1);
+            if (it->second.timer > 0) {
+                it++;
+                continue;
+            }
+            explode_bomb(it->first, it->second, game, events, robots_destroyed, blocks_destroyed);
+            it = bombs.erase(it);
+        }
+    }
+
+    // destroyed robots are respawned, the others do what players requested
+    for (auto &player : state.players) {
+        PlayerId id = player.first;
+        if (robots_destroyed.find(id) != robots_destroyed.end()) {
+            Position position = random_position(options, random);
+            state.player_positions.write()[id] = position;
+            Event event;
+            event.initialize_player_moved(id, position);
+            events.push_back(event);
+            continue;
+        }
+
+        if (actions[id].has_value())
+            apply_action(id, *actions[id], game, options, events);
+    }
+
+    for (auto robot : robots_destroyed)
+        state.scores.write()[robot] += 1;
+    for (const auto &block : blocks_destroyed) {
+        state.blocks.write().erase(block);
+        game.footprints.block_changed(block, state.blocks.get());
+    }
+
+    state.turn++;
+    return events;
+}
@@ -0,0 +1,33 @@
+#ifndef BOMBOWE_ROBOTY_GAME_RULES_H
+#define BOMBOWE_ROBOTY_GAME_RULES_H
+
+#include <random>
+#include "definitions.h"
+#include "footprint-cache.h"
+
+// A structure holding the server's state of a game.
+struct ServerGame {
+    GameState state;
+    BombId next_bomb_id = 0;
+    FootprintCache footprints; // of the bombs in state
+};
+
+// Places blocks and robots at random positions.
+// Returns events of turn 0.
+events_list_t start_game(ServerGame &game, ServerOptions &options,
+                         players_map_t &players, std::minstd_rand &random);
+
+// Restores a game from its state, e.g. read from a checkpoint.
+// Returns events recreating the state - robots, blocks and bombs,
+// for clients following the game from its start. BombPlaced has no timer,
+// so these clients show restored bombs with the full timer; clients which
+// negotiated capabilities get a GameSnapshot with the remaining timers.
+events_list_t restore_game(ServerGame &game, ServerOptions &options, GameState &state,
+                           BombId next_bomb_id);
+
+// Plays one turn - explodes bombs, respawns destroyed robots and applies
+// players' actions. Returns events of the turn.
+events_list_t play_turn(ServerGame &game, ServerOptions &options,
+                        actions_table_t &actions, std::minstd_rand &random);
+
+#endif //BOMBOWE_ROBOTY_GAME_RULES_H
@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <cstring>
+#include "gateway-control.h"
+
+template<typename T>
+static void put(std::vector<char> &out, T value) {
+    out.insert(out.end(), (char *) &value, (char *) &value + sizeof(T));
+}
+
+void serialize_backend_report(std::vector<char> &out, const BackendReport &report) {
+    out.clear();
+    put(out, report.instance);
+    put(out, report.port);
+    put(out, report.players_count);
+    put(out, report.connections);
+    put(out, report.rooms);
+    put(out, report.lobby_sessions);
+    put(out, (uint32_t) report.hello.size());
+    out.insert(out.end(), report.hello.begin(), report.hello.end());
+}
+
+bool parse_backend_report(const char *data, size_t length, BackendReport &report) {
+    size_t position = 0;
+    auto get = [&]<typename T>(T &value) {
+        if (length - position < sizeof(T)) return false;
+        memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    };
+
+    uint32_t hello_length;
+    if (!get(report.instance) || !get(report.port) || !get(report.players_count) ||
+        !get(report.connections) || !get(report.rooms) ||
+        !get(report.lobby_sessions) || !get(hello_length) || length - position != hello_length)
+        return false;
+    report.hello.assign(data + position, hello_length);
+    return hello_length > 0 && report.players_count > 0;
+}
+
+void serialize_client_address(std::vector<char> &out, const std::string &address) {
+    auto length = (uint8_t) std::min(address.size(), (size_t) UINT8_MAX);
+    put(out, (uint8_t) GATEWAY_CLIENT_ADDRESS);
+    put(out, length);
+    out.insert(out.end(), address.begin(), address.begin() + length);
+}
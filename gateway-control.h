@@ -0,0 +1,50 @@
+#ifndef BOMBOWE_ROBOTY_GATEWAY_CONTROL_H
+#define BOMBOWE_ROBOTY_GATEWAY_CONTROL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+Reports of robots-server processes to robots-gateway on the same host. Every
+server started with --gateway-control sends a datagram to the gateway's Unix
+socket every GATEWAY_REPORT_MS: its instance number and port, how loaded it is,
+how many clients watch the lobby of its filling room and its Hello message,
+which the gateway sends to new clients before it knows which server they go to.
+A server which stops reporting for GATEWAY_BACKEND_TIMEOUT_MS - e.g. restarted -
+gets no new clients.
+The reports use the host's byte order.
+
+    report: instance:u8 port:u16 players_count:u8 connections:u32 rooms:u32
+            lobby_sessions:u32 hello_length:u32 hello
+
+The gateway connects to a server from the loopback address, so the client's
+bytes are preceded by its address, which servers with --gateway-control read
+as the first message of a loopback connection and give to the player:
+
+    client address: GATEWAY_CLIENT_ADDRESS:u8 length:u8 address
+*/
+
+#define GATEWAY_REPORT_MS          200
+#define GATEWAY_BACKEND_TIMEOUT_MS 1000
+#define GATEWAY_CLIENT_ADDRESS     0xff
+
+struct BackendReport {
+    uint8_t instance;
+    uint16_t port;
+    uint8_t players_count; // of a game
+    uint32_t connections;
+    uint32_t rooms;
+    uint32_t lobby_sessions; // in the filling room or not in any room yet
+    std::string hello;
+};
+
+void serialize_backend_report(std::vector<char> &out, const BackendReport &report);
+
+// Returns false if a datagram isn't a correct report.
+bool parse_backend_report(const char *data, size_t length, BackendReport &report);
+
+// Serializes the client address message, the address is cut to 255 bytes.
+void serialize_client_address(std::vector<char> &out, const std::string &address);
+
+#endif //BOMBOWE_ROBOTY_GATEWAY_CONTROL_H
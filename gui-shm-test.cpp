@@ -0,0 +1,130 @@
+// Tests of the shared-memory GUI transport - a reader racing a writer sees
+// only whole frames, never older than the one it was woken for, waits time
+// out when nothing is published and frame numbers survive a new writer.
+
+#include <chrono>
+#include <cstring>
+#include <system_error>
+#include <thread>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "gui-shm.h"
+#include "test-utils.h"
+
+#define TEST_FRAMES 5000
+
+// Frames hold their number, then its lowest byte repeated, of a length
+// depending on it, so a torn frame doesn't match its own number.
+static size_t frame_length(uint32_t frame) {
+    return sizeof(frame) + (frame * 7919) % (GUI_SHM_BUFFER_SIZE / 2);
+}
+
+static void write_frame(GuiShmWriter &writer, uint32_t frame) {
+    char *data = writer.begin_frame();
+    size_t length = frame_length(frame);
+    memcpy(data, &frame, sizeof(frame));
+    memset(data + sizeof(frame), (char) frame, length - sizeof(frame));
+    writer.publish_frame(length);
+}
+
+// Checked while the writer may overwrite the frame. The reader gives up
+// the processor in the middle, so torn frames are given to its parse
+// now and then, even on a single core.
+static bool whole_frame(const char *data, size_t length, uint32_t &frame) {
+    if (length < sizeof(frame)) return false;
+    memcpy(&frame, data, sizeof(frame));
+    if (length != frame_length(frame)) return false;
+    for (size_t i = sizeof(frame); i < length; i++) {
+        if (i == length / 2) std::this_thread::yield();
+        if (data[i] != (char) frame) return false;
+    }
+    return true;
+}
+
+// Reads the latest frame, checking it is whole, has the returned number
+// and isn't older than [at_least]. Returns its number.
+static uint32_t read_checked(GuiShmReader &reader, uint32_t at_least) {
+    bool whole = false;
+    uint32_t written = 0;
+    uint32_t frame = reader.read_latest([&](const char *data, size_t length) {
+        whole = whole_frame(data, length, written); // only the last call counts
+    });
+    CHECK(whole);
+    CHECK(written == frame);
+    CHECK(frame - at_least < UINT32_MAX / 2); // not older, with wrapping
+    return frame;
+}
+
+static void test_racing_writer(const std::string &name) {
+    GuiShmWriter writer(name);
+    GuiShmReader reader(name);
+    uint32_t first = reader.wait_for_frame(UINT32_MAX, 0);
+
+    // the writer lets the reader go on after every second frame,
+    // which overwrites the frame the reader may be in the middle of
+    std::thread writer_thread([&writer, first] {
+        for (uint32_t frame = first + 1; frame <= first + TEST_FRAMES; frame++) {
+            write_frame(writer, frame);
+            if (frame % 2 == 0) std::this_thread::yield();
+        }
+    });
+    uint32_t last = first, reads = 0;
+    while (last != first + TEST_FRAMES) {
+        uint32_t woken = reader.wait_for_frame(last, 1000);
+        CHECK(woken != last);
+        if (woken == last) break;
+        last = read_checked(reader, woken);
+        reads++;
+    }
+    writer_thread.join();
+    CHECK(reads > 0);
+    CHECK(read_checked(reader, last) == first + TEST_FRAMES);
+}
+
+static void test_waiting(const std::string &name) {
+    GuiShmWriter writer(name);
+    GuiShmReader reader(name);
+    write_frame(writer, 1);
+    uint32_t last = read_checked(reader, 0);
+
+    // nothing is published, so the wait ends after its timeout
+    auto start = std::chrono::steady_clock::now();
+    CHECK(reader.wait_for_frame(last, 50) == last);
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(45));
+
+    // a reader waiting without a limit is woken by the next frame
+    std::thread writer_thread([&writer, last] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        write_frame(writer, last + 1);
+    });
+    CHECK(reader.wait_for_frame(last, -1) == last + 1);
+    writer_thread.join();
+    CHECK(read_checked(reader, last + 1) == last + 1);
+
+    // a new writer of the segment goes on with frame numbers the reader knows
+    GuiShmWriter next_writer(name);
+    write_frame(next_writer, last + 2);
+    CHECK(reader.wait_for_frame(last + 1, 0) == last + 2);
+    CHECK(read_checked(reader, last + 2) == last + 2);
+}
+
+static void test_missing_segment(const std::string &name) {
+    bool thrown = false;
+    try {
+        GuiShmReader reader(name);
+    }
+    catch (std::system_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+int main() {
+    std::string name = "/robots-gui-shm-test-" + std::to_string(getpid());
+    test_missing_segment(name);
+    test_racing_writer(name);
+    shm_unlink(name.c_str());
+    test_waiting(name);
+    shm_unlink(name.c_str());
+    return test_result();
+}
@@ -0,0 +1,107 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "gui-shm.h"
+
+// Maps the segment with a given name, creating it if [create] is set.
+static GuiShmSegment *map_segment(const std::string &name, bool create) {
+    int fd = shm_open(name.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0600);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+
+    if (create && ftruncate(fd, sizeof(GuiShmSegment)) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+    }
+
+    void *memory = mmap(nullptr, sizeof(GuiShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (memory == MAP_FAILED) throw std::system_error(error, std::generic_category(), "mmap " + name);
+    return (GuiShmSegment *) memory;
+}
+
+// Futex operations on a word of a shared mapping, so not FUTEX_PRIVATE_FLAG.
+static void futex_wait(std::atomic<uint32_t> &word, uint32_t value, int timeout_ms) {
+    timespec timeout{timeout_ms / 1000, (long) (timeout_ms % 1000) * 1000000};
+    syscall(SYS_futex, (uint32_t *) &word, FUTEX_WAIT, value, timeout_ms < 0 ? nullptr : &timeout,
+            nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t> &word) {
+    syscall(SYS_futex, (uint32_t *) &word, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+GuiShmWriter::GuiShmWriter(const std::string &name) {
+    segment = map_segment(name, true);
+
+    // a GUI may still be attached to the segment of a previous client,
+    // so frame numbers go on from there
+    if (memcmp(segment->magic, GUI_SHM_MAGIC, sizeof(segment->magic)) == 0 &&
+        segment->version == GUI_SHM_VERSION) {
+        next_frame = segment->frames.load(std::memory_order_relaxed);
+        return;
+    }
+    segment->version = GUI_SHM_VERSION;
+    segment->frames.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(segment->magic, GUI_SHM_MAGIC, sizeof(segment->magic));
+}
+
+GuiShmWriter::~GuiShmWriter() {
+    munmap(segment, sizeof(GuiShmSegment));
+}
+
+char *GuiShmWriter::begin_frame() {
+    next_frame++;
+    GuiShmBuffer &buffer = segment->buffers[next_frame % 2];
+    buffer.sequence.store(buffer.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    // the odd sequence must be visible before any of the data
+    std::atomic_thread_fence(std::memory_order_release);
+    return buffer.data;
+}
+
+void GuiShmWriter::publish_frame(size_t length) {
+    GuiShmBuffer &buffer = segment->buffers[next_frame % 2];
+    buffer.length = (uint32_t) length;
+    buffer.sequence.store(buffer.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    // seq_cst pairs with the reader's, so either it sees the frame or we see it waiting
+    segment->frames.store(next_frame, std::memory_order_seq_cst);
+    if (segment->waiters.load(std::memory_order_seq_cst) != 0)
+        futex_wake(segment->frames);
+}
+
+GuiShmReader::GuiShmReader(const std::string &name) {
+    segment = map_segment(name, false);
+    if (memcmp(segment->magic, GUI_SHM_MAGIC, sizeof(segment->magic)) != 0 ||
+        segment->version != GUI_SHM_VERSION) {
+        munmap(segment, sizeof(GuiShmSegment));
+        throw std::runtime_error(name + " is not a robots gui segment");
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+GuiShmReader::~GuiShmReader() {
+    munmap(segment, sizeof(GuiShmSegment));
+}
+
+uint32_t GuiShmReader::wait_for_frame(uint32_t last_frame, int timeout_ms) {
+    uint32_t frame = segment->frames.load(std::memory_order_acquire);
+    if (frame != last_frame) return frame;
+
+    segment->waiters.fetch_add(1, std::memory_order_seq_cst);
+    frame = segment->frames.load(std::memory_order_seq_cst);
+    if (frame == last_frame) {
+        futex_wait(segment->frames, last_frame, timeout_ms);
+        frame = segment->frames.load(std::memory_order_acquire);
+    }
+    segment->waiters.fetch_sub(1, std::memory_order_relaxed);
+    return frame;
+}
@@ -0,0 +1,100 @@
+#ifndef BOMBOWE_ROBOTY_GUI_SHM_H
+#define BOMBOWE_ROBOTY_GUI_SHM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+Shared-memory transport to a GUI on the same host. The client serializes
+Lobby and Game messages straight into a POSIX shared memory segment instead
+of sending them over UDP loopback. Only the newest message matters, so the
+segment holds two buffers: the writer fills the one not holding the latest
+frame, then publishes it by bumping the frame counter. Each buffer has its
+own sequence number, odd while the buffer is written, so a reader which was
+overtaken twice while reading sees the change and reads again.
+A reader waits for a new frame with a futex on the frame counter - it works
+across processes mapping the segment, which find it by name. The GUI still
+sends its input to the client over UDP.
+*/
+
+#define GUI_SHM_MAGIC       "ROBOTSHM"
+#define GUI_SHM_VERSION     1
+#define GUI_SHM_BUFFER_SIZE 65507 // like a UDP datagram
+
+struct GuiShmBuffer {
+    std::atomic<uint32_t> sequence; // odd while the buffer is written
+    uint32_t length;
+    char data[GUI_SHM_BUFFER_SIZE];
+};
+
+struct GuiShmSegment {
+    char magic[8];
+    uint32_t version;
+    std::atomic<uint32_t> frames; // published, the latest is in buffers[frames % 2]
+    std::atomic<uint32_t> waiters; // readers sleeping on frames
+    GuiShmBuffer buffers[2];
+};
+
+// The client's side. Frames have to be written one at a time.
+class GuiShmWriter {
+private:
+    GuiShmSegment *segment;
+    uint32_t next_frame = 0;
+
+public:
+    // Creates the segment or takes over an existing one.
+    // Throws std::system_error if it can't be created or mapped.
+    explicit GuiShmWriter(const std::string &name);
+    ~GuiShmWriter();
+
+    GuiShmWriter(const GuiShmWriter &) = delete;
+    GuiShmWriter &operator=(const GuiShmWriter &) = delete;
+
+    // Returns the buffer of the next frame, GUI_SHM_BUFFER_SIZE bytes long.
+    char *begin_frame();
+
+    // Publishes the frame written since begin_frame and wakes waiting readers.
+    void publish_frame(size_t length);
+};
+
+// The GUI's side.
+class GuiShmReader {
+private:
+    GuiShmSegment *segment;
+
+public:
+    // Maps an existing segment. Throws std::system_error if there is none
+    // or std::runtime_error if it isn't a segment of this version.
+    explicit GuiShmReader(const std::string &name);
+    ~GuiShmReader();
+
+    GuiShmReader(const GuiShmReader &) = delete;
+    GuiShmReader &operator=(const GuiShmReader &) = delete;
+
+    // Waits until a frame other than [last_frame] is published, at most
+    // [timeout_ms] milliseconds (-1 - without a limit), and returns its number.
+    // Returns [last_frame] if there is no new frame after all.
+    uint32_t wait_for_frame(uint32_t last_frame, int timeout_ms = -1);
+
+    // Calls [parse](data, length) on the newest frame where it lies in the segment
+    // and returns the frame's number. If the writer overwrote the frame meanwhile,
+    // the data may have been torn and [parse] is called again on a newer one.
+    template<typename Parse>
+    uint32_t read_latest(Parse &&parse) {
+        while (true) {
+            uint32_t frame = segment->frames.load(std::memory_order_acquire);
+            GuiShmBuffer &buffer = segment->buffers[frame % 2];
+            uint32_t sequence = buffer.sequence.load(std::memory_order_acquire);
+            if (sequence % 2 == 1) continue;
+
+            parse((const char *) buffer.data,
+                  std::min((size_t) buffer.length, (size_t) GUI_SHM_BUFFER_SIZE));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (buffer.sequence.load(std::memory_order_relaxed) == sequence) return frame;
+        }
+    }
+};
+
+#endif //BOMBOWE_ROBOTY_GUI_SHM_H
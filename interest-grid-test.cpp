@@ -0,0 +1,81 @@
+// Tests of area-of-interest filtering - a client following turns built by
+// the grid learns of every bomb whose explosion can reach its area, so it
+// draws explosions reaching into the area, and isn't sent far away events.
+
+#include "definitions.h"
+#include "game-handler.h"
+#include "interest-grid.h"
+#include "test-utils.h"
+
+#define SIZE             30
+#define CELL_SIZE        4
+#define RADIUS           3
+#define EXPLOSION_RADIUS 3
+
+// Builds a turn of [events] for a recipient at [center] and applies it to the client's [known] state.
+static void send_turn(InterestGrid &grid, InterestState &interest, uint16_t turn, events_list_t &events,
+                      const GameState &game, Position center, GameState &known, GameParameters &params) {
+    EventFragments fragments;
+    serialize_event_fragments(events, fragments);
+    grid.index(events);
+    std::vector<char> message;
+    grid.build_turn(message, turn, fragments, center, RADIUS, interest, game, false);
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    Buffer buffer(socket);
+    buffer.insert_data(message.data() + 1, message.size() - 1);
+    aggregate_game_state(buffer, known, params);
+    CHECK(buffer.get_parsed_len() == buffer.get_msg_len());
+}
+
+static void test_bombs_reaching_area() {
+    StringTable strings;
+    players_map_t players;
+    players.insert(std::make_pair((PlayerId) 0, Player(strings, "near", "a")));
+    players.insert(std::make_pair((PlayerId) 1, Player(strings, "far", "b")));
+    positions_set_t blocks;
+    player_positions_map_t positions = {{0, {5, 5}}, {1, {25, 25}}};
+    GameState game(players, blocks, positions);
+    positions_set_t no_blocks;
+    player_positions_map_t no_positions;
+    GameState known(players, no_blocks, no_positions);
+    GameParameters params("test", 2, SIZE, SIZE, 100, EXPLOSION_RADIUS, 5);
+    InterestGrid grid(SIZE, SIZE, CELL_SIZE, EXPLOSION_RADIUS, 1);
+    InterestState interest;
+    Position center(5, 5);
+
+    // a bomb placed outside the area with an explosion reaching into it, a far one,
+    // and one placed before which the recipient hasn't been sent
+    events_list_t events(2);
+    events[0].initialize_bomb_placed(1, {(uint16_t) (5 + RADIUS + EXPLOSION_RADIUS), 5}, 0);
+    events[1].initialize_bomb_placed(2, {20, 20}, 1);
+    game.bombs.write()[1] = Bomb(events[0].position, 5);
+    game.bombs.write()[2] = Bomb(events[1].position, 5);
+    game.bombs.write()[3] = Bomb({5, (uint16_t) (5 - RADIUS - EXPLOSION_RADIUS + 1)}, 2);
+    send_turn(grid, interest, 1, events, game, center, known, params);
+    CHECK(known.bombs.get().count(1) == 1);
+    CHECK(known.bombs.get().count(2) == 0);
+    CHECK(known.bombs.get().count(3) == 1);
+    CHECK(known.player_positions.get().at(0) == center);
+
+    // the recipient sees the explosions reaching its area, bombs aren't sent again
+    player_id_list_t no_robots;
+    positions_list_t no_destroyed;
+    events.assign(3, Event());
+    events[0].initialize_bomb_exploded(1, no_robots, no_destroyed, game.bombs.get().at(1).position, 0);
+    events[1].initialize_bomb_exploded(2, no_robots, no_destroyed, game.bombs.get().at(2).position, 1);
+    events[2].initialize_bomb_exploded(3, no_robots, no_destroyed, game.bombs.get().at(3).position, 1);
+    game.bombs.write().clear();
+    send_turn(grid, interest, 2, events, game, center, known, params);
+    CHECK(known.bombs.get().empty());
+    CHECK(known.explosions.get().contains(Position((uint16_t) (5 + RADIUS), 5)));
+    CHECK(known.explosions.get().contains(Position(5, (uint16_t) (5 - RADIUS))));
+    CHECK(!known.explosions.get().contains(Position(20, 20)));
+    CHECK(interest.bombs.empty());
+}
+
+int main() {
+    test_bombs_reaching_area();
+    return test_result();
+}
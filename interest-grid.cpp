@@ -0,0 +1,231 @@
+#include <algorithm>
+#include "interest-grid.h"
+#include "message-serializer.h"
+
+void serialize_event_fragments(events_list_t &events, EventFragments &fragments) {
+    size_t total_len = 0;
+    for (auto &event : events)
+        total_len += get_event_len(event);
+
+    fragments.bytes.resize(total_len);
+    fragments.offsets.assign(1, 0);
+
+    char *dest_ptr = fragments.bytes.data();
+    for (auto &event : events) {
+        size_t len = serialize_event(dest_ptr, event);
+        fragments.offsets.push_back(fragments.offsets.back() + len);
+    }
+}
+
+void serialize_compact_event_fragments(events_list_t &events, EventFragments &fragments,
+                                       uint8_t id_bits) {
+    fragments.bytes.clear();
+    fragments.offsets.assign(1, 0);
+
+    for (auto &event : events) {
+        serialize_compact_event(fragments.bytes, event, id_bits);
+        fragments.offsets.push_back(fragments.bytes.size());
+    }
+}
+
+InterestGrid::InterestGrid(uint16_t size_x, uint16_t size_y, uint16_t cell_size,
+                           uint16_t explosion_radius, uint8_t id_bits):
+        cell_size(std::max(cell_size, (uint16_t) 1)), explosion_radius(explosion_radius),
+        id_bits(id_bits) {
+
+    columns = (uint16_t) ((size_x + this->cell_size - 1) / this->cell_size);
+    rows = (uint16_t) ((size_y + this->cell_size - 1) / this->cell_size);
+    cells.resize((size_t) columns * rows);
+}
+
+// Adds a fragment to the cells of its position and, for an explosion,
+// of every field within [reach] in the four directions.
+void InterestGrid::add_to_cells(uint32_t fragment, Position position, uint16_t reach) {
+    auto row = (uint16_t) (position.y / cell_size);
+    auto column = (uint16_t) (position.x / cell_size);
+    auto first_column = (uint16_t) (std::max(position.x - reach, 0) / cell_size);
+    auto last_column = (uint16_t) std::min((position.x + reach) / cell_size, columns - 1);
+    auto first_row = (uint16_t) (std::max(position.y - reach, 0) / cell_size);
+    auto last_row = (uint16_t) std::min((position.y + reach) / cell_size, rows - 1);
+
+    for (uint16_t c = first_column; c <= last_column; c++)
+        cells[(size_t) row * columns + c].push_back(fragment);
+    for (uint16_t r = first_row; r <= last_row; r++)
+        if (r != row) cells[(size_t) r * columns + column].push_back(fragment);
+}
+
+void InterestGrid::index(const events_list_t &events) {
+    for (auto &cell : cells)
+        cell.clear(); // keeps capacity between turns
+    scopes.clear();
+    broadcast.clear();
+    explosions.clear();
+    block_changes.clear();
+
+    for (uint32_t i = 0; i < events.size(); i++) {
+        const Event &event = events[i];
+        EventScope scope{event.event_id, event.bomb_id, event.position, 0};
+        switch ((EventType) event.event_id) {
+            case BombPlaced:
+                // a recipient gets a bomb whose explosion may reach its area
+                scope.reach = explosion_radius;
+                break;
+            case BombExploded:
+                scope.reach = explosion_radius;
+                explosions.push_back(i);
+                if (!event.robots_destroyed.empty()) broadcast.push_back(i);
+                for (auto &block : event.blocks_destroyed)
+                    block_changes.emplace_back(i, block);
+                break;
+            case PlayerMoved:
+                scope.id = event.player_id;
+                break;
+            case BlockPlaced:
+                block_changes.emplace_back(i, event.position);
+                break;
+            default:
+                break;
+        }
+        scopes.push_back(scope);
+        add_to_cells(i, scope.position, scope.reach);
+    }
+}
+
+// Helper function - checks if a position lies in the area of interest.
+static bool in_area(Position p, Position center, uint16_t radius) {
+    return std::abs(p.x - center.x) <= radius && std::abs(p.y - center.y) <= radius;
+}
+
+// Helper function - checks if a position or a field within [reach] of it
+// in one of the four directions lies in the area of interest.
+static bool reaches_area(Position p, uint16_t reach, Position center, uint16_t radius) {
+    int dx = std::abs(p.x - center.x), dy = std::abs(p.y - center.y);
+    return (dx <= radius + reach && dy <= radius) || (dx <= radius && dy <= radius + reach);
+}
+
+void InterestGrid::build_turn(std::vector<char> &out, uint16_t turn_nr,
+                              const EventFragments &fragments, Position center,
+                              uint16_t radius, InterestState &state,
+                              const GameState &game, bool compact) {
+
+    if (state.revealed_cells.size() != cells.size())
+        state.revealed_cells.assign(cells.size(), false);
+
+    std::vector<uint32_t> &selected = state.selected;
+    positions_list_t &revealed_blocks = state.revealed_blocks;
+    selected.clear();
+    revealed_blocks.clear();
+    state.revealed_bombs.clear();
+    state.moved_robots.clear();
+
+    // events the recipient gets wherever they happen
+    selected.insert(selected.end(), broadcast.begin(), broadcast.end());
+    for (uint32_t fragment : explosions)
+        if (state.bombs.contains(scopes[fragment].id)) selected.push_back(fragment);
+    for (auto &[fragment, block] : block_changes)
+        if (state.revealed_cells[cell_index(block)]) selected.push_back(fragment);
+
+    auto first_column = (uint16_t) (std::max(center.x - radius, 0) / cell_size);
+    auto first_row = (uint16_t) (std::max(center.y - radius, 0) / cell_size);
+    auto last_column = (uint16_t) std::min((center.x + radius) / cell_size, columns - 1);
+    auto last_row = (uint16_t) std::min((center.y + radius) / cell_size, rows - 1);
+
+    for (uint16_t row = first_row; row <= last_row; row++) {
+        for (uint16_t column = first_column; column <= last_column; column++) {
+            size_t cell = (size_t) row * columns + column;
+            for (uint32_t fragment : cells[cell]) {
+                const EventScope &scope = scopes[fragment];
+                if (reaches_area(scope.position, scope.reach, center, radius))
+                    selected.push_back(fragment);
+            }
+
+            if (state.revealed_cells[cell]) continue;
+            state.revealed_cells[cell] = true;
+
+            // blocks are ordered by x, then by y - scan every column of the cell
+            auto y_begin = (uint16_t) (row * cell_size);
+            auto y_end = (uint32_t) y_begin + cell_size;
+            for (uint32_t x = (uint32_t) column * cell_size;
+                 x < (uint32_t) (column + 1) * cell_size; x++) {
+
+                auto it = game.blocks.get().lower_bound(Position((uint16_t) x, y_begin));
+                for (; it != game.blocks.end() && it->x == x && it->y < y_end; it++)
+                    revealed_blocks.push_back(*it);
+            }
+        }
+    }
+    // events have to be sent in their original order, each once
+    std::sort(selected.begin(), selected.end());
+    selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+
+    for (uint32_t fragment : selected) {
+        const EventScope &scope = scopes[fragment];
+        if (scope.event_id == BombPlaced) state.bombs.insert(scope.id);
+        else if (scope.event_id == BombExploded) state.bombs.erase(scope.id);
+        else if (scope.event_id == PlayerMoved) state.robots[(PlayerId) scope.id] = scope.position;
+    }
+    // bombs placed before that can reach the area now, e.g. in a revealed cell
+    for (auto &[bomb_id, bomb] : game.bombs) {
+        if (state.bombs.contains(bomb_id) || !reaches_area(bomb.position, explosion_radius, center, radius))
+            continue;
+        state.bombs.insert(bomb_id);
+        state.revealed_bombs.emplace_back(bomb_id, bomb.position);
+    }
+    // clients place robots at (0, 0) until they are sent where they are
+    for (auto &[player_id, position] : game.player_positions) {
+        Position &known = state.robots.try_emplace(player_id, 0, 0).first->second;
+        if (known == position || (!in_area(known, center, radius) && !in_area(position, center, radius)))
+            continue;
+        known = position;
+        state.moved_robots.emplace_back(player_id, position);
+    }
+
+    auto events_count = (uint32_t) (selected.size() + revealed_blocks.size() +
+                                    state.revealed_bombs.size() + state.moved_robots.size());
+    out.clear();
+    if (compact) {
+        serialize_compact_turn_header(out, turn_nr, events_count);
+    }
+    else {
+        out.resize(TURN_HEADER_LENGTH);
+        serialize_turn_header(out.data(), turn_nr, events_count);
+    }
+
+    auto append_event = [&](Event &event) {
+        if (compact) {
+            serialize_compact_event(out, event, id_bits);
+            return;
+        }
+        size_t offset = out.size();
+        out.resize(offset + get_event_len(event));
+        char *dest_ptr = out.data() + offset;
+        serialize_event(dest_ptr, event);
+    };
+    for (auto &block : revealed_blocks) {
+        Event event;
+        event.initialize_block_placed(block);
+        append_event(event);
+    }
+    for (auto &[player_id, position] : state.moved_robots) {
+        Event event;
+        event.initialize_player_moved(player_id, position);
+        append_event(event);
+    }
+    for (auto &[bomb_id, position] : state.revealed_bombs) {
+        Event event;
+        event.initialize_bomb_placed(bomb_id, position);
+        append_event(event);
+    }
+    for (uint32_t fragment : selected) {
+        out.insert(out.end(), fragments.bytes.begin() + (long) fragments.offsets[fragment],
+                   fragments.bytes.begin() + (long) fragments.offsets[fragment + 1]);
+    }
+}
+
+void InterestGrid::synchronize(InterestState &state, const GameState &game) {
+    state.revealed_cells.assign(cells.size(), true);
+    state.robots = game.player_positions.get();
+    state.bombs.clear();
+    for (auto &bomb : game.bombs)
+        state.bombs.insert(bomb.first);
+}
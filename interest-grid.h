@@ -0,0 +1,102 @@
+#ifndef BOMBOWE_ROBOTY_INTEREST_GRID_H
+#define BOMBOWE_ROBOTY_INTEREST_GRID_H
+
+#include "definitions.h"
+
+/*
+Area-of-interest filtering of turn events.
+Every event of a turn is serialized once into a shared fragment buffer.
+Events are indexed by a grid of square cells - a bomb in every cell its
+explosion may reach - so a recipient's turn is built by copying only
+the fragments from cells near the recipient.
+A recipient must not be left with a wrong picture of what it has seen, so
+some events are sent to it wherever they happen: explosions destroying robots
+(every client counts all scores), explosions of bombs it was sent and changes
+of blocks in cells it was revealed. A robot which leaves the area, or gets into
+it without moving, is sent to the recipient as moved to where it is, and a bomb
+placed earlier whose explosion can reach the area, e.g. in a newly revealed cell,
+is sent as placed in this turn - the client counts its timer from the full one.
+*/
+
+// Pre-serialized events of a single turn.
+// Fragment i occupies bytes [offsets[i], offsets[i + 1]).
+struct EventFragments {
+    std::vector<char> bytes;
+    std::vector<size_t> offsets;
+
+    [[nodiscard]] size_t count() const { return offsets.size() - 1; }
+};
+
+// Per-recipient filtering state - what the recipient knows about the game.
+// Blocks from a cell are sent once, when the cell gets into the area.
+struct InterestState {
+    std::vector<bool> revealed_cells;
+    player_positions_map_t robots; // positions the recipient was sent last
+    std::set<BombId> bombs; // bombs the recipient was sent
+
+    // reused between turns
+    std::vector<uint32_t> selected;
+    positions_list_t revealed_blocks;
+    std::vector<std::pair<BombId, Position>> revealed_bombs;
+    std::vector<std::pair<PlayerId, Position>> moved_robots;
+};
+
+class InterestGrid {
+private:
+    // What an event of the current turn touches.
+    struct EventScope {
+        uint8_t event_id;
+        uint32_t id; // of the bomb or the player
+        Position position;
+        uint16_t reach; // an explosion reaches this far in the four directions
+    };
+
+    uint16_t cell_size;
+    uint16_t columns;
+    uint16_t rows;
+    uint16_t explosion_radius;
+    uint8_t id_bits;
+    std::vector<std::vector<uint32_t>> cells; // fragment indices per cell
+    std::vector<EventScope> scopes; // by fragment index
+    std::vector<uint32_t> broadcast; // explosions destroying robots
+    std::vector<uint32_t> explosions;
+    std::vector<std::pair<uint32_t, Position>> block_changes; // fragment and block
+
+    [[nodiscard]] size_t cell_index(Position p) const {
+        return (size_t) (p.y / cell_size) * columns + p.x / cell_size;
+    }
+
+    void add_to_cells(uint32_t fragment, Position position, uint16_t reach);
+
+public:
+    InterestGrid(uint16_t size_x, uint16_t size_y, uint16_t cell_size,
+                 uint16_t explosion_radius, uint8_t id_bits);
+
+    // Replaces grid content with events of a new turn,
+    // fragment i being the serialized event i.
+    void index(const events_list_t &events);
+
+    // Builds a turn message containing events within [radius] (in both axes)
+    // from [center], events the recipient has to get wherever they happen,
+    // BlockPlaced events for blocks in newly revealed cells, BombPlaced events
+    // for earlier bombs reaching the area and PlayerMoved events for robots
+    // crossing the area. [game] is the state after the turn.
+    // The message is written to [out]. [compact] has to match the encoding
+    // of the fragments.
+    void build_turn(std::vector<char> &out, uint16_t turn_nr,
+                    const EventFragments &fragments, Position center,
+                    uint16_t radius, InterestState &state,
+                    const GameState &game, bool compact);
+
+    // Marks the whole game as known to a recipient sent a snapshot of it.
+    void synchronize(InterestState &state, const GameState &game);
+};
+
+// Serializes every event of a turn into a separate fragment.
+void serialize_event_fragments(events_list_t &events, EventFragments &fragments);
+
+// The same as above, in compact encoding.
+void serialize_compact_event_fragments(events_list_t &events, EventFragments &fragments,
+                                       uint8_t id_bits);
+
+#endif //BOMBOWE_ROBOTY_INTEREST_GRID_H
@@ -0,0 +1,161 @@
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "leaderboard.h"
+
+// Helper function - throws std::system_error for the last failed system call.
+static void throw_errno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+Leaderboard::Leaderboard(const std::string &path, bool read_only): read_only(read_only) {
+    fd = open(path.c_str(), read_only ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+    if (fd < 0) throw_errno("open " + path);
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) < 0) throw_errno("fstat " + path);
+    auto size = (size_t) file_stat.st_size;
+    bool created = size == 0 && !read_only;
+
+    if (created) {
+        size = sizeof(LeaderboardHeader) + LEADERBOARD_INITIAL_CAPACITY * sizeof(LeaderboardRecord);
+        if (ftruncate(fd, (off_t) size) < 0) throw_errno("ftruncate " + path);
+    }
+    else if (size < sizeof(LeaderboardHeader)) {
+        throw std::runtime_error(path + " is not a leaderboard file");
+    }
+    file_size = size;
+
+    // the writer maps the largest possible file, pages past its end are never touched
+    mapping_size = read_only ? size : std::max(size, sizeof(LeaderboardHeader) +
+                                                     LEADERBOARD_MAX_RECORDS * sizeof(LeaderboardRecord));
+    void *new_mapping = mmap(nullptr, mapping_size, read_only ? PROT_READ : PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+    if (new_mapping == MAP_FAILED) throw_errno("mmap " + path);
+    mapping = (char *) new_mapping;
+
+    if (created) {
+        memcpy(header().magic, LEADERBOARD_MAGIC, sizeof(header().magic));
+        header().version = LEADERBOARD_VERSION;
+        header().record_size = sizeof(LeaderboardRecord);
+        header().records_count = 0;
+    }
+
+    if (memcmp(header().magic, LEADERBOARD_MAGIC, sizeof(header().magic)) != 0 ||
+        header().version != LEADERBOARD_VERSION ||
+        header().record_size != sizeof(LeaderboardRecord) ||
+        header().records_count > capacity())
+        throw std::runtime_error(path + " is not a leaderboard file");
+
+    index.reserve(header().records_count);
+    for (uint32_t i = 0; i < header().records_count; i++)
+        index.emplace(records()[i].name, i);
+
+    if (!read_only) flusher = std::thread([this] { flush_loop(); });
+}
+
+Leaderboard::~Leaderboard() {
+    if (flusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex);
+            stopping = true;
+        }
+        flush_requested.notify_one();
+        flusher.join();
+    }
+    if (mapping) munmap(mapping, mapping_size);
+    close(fd);
+}
+
+size_t Leaderboard::capacity() const {
+    return (file_size.load(std::memory_order_relaxed) - sizeof(LeaderboardHeader)) /
+           sizeof(LeaderboardRecord);
+}
+
+// Returns the record of a player, adding it (and growing the file twice,
+// if it is full) for a new name.
+uint32_t Leaderboard::find_or_add(const std::string &name) {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    auto it = index.find(name);
+    if (it != index.end()) return it->second;
+
+    if (header().records_count == capacity()) {
+        size_t new_capacity = std::min(2 * capacity(), (size_t) LEADERBOARD_MAX_RECORDS);
+        if (new_capacity == capacity()) throw std::runtime_error("leaderboard is full");
+        size_t new_size = sizeof(LeaderboardHeader) + new_capacity * sizeof(LeaderboardRecord);
+        if (ftruncate(fd, (off_t) new_size) < 0) throw_errno("ftruncate");
+        file_size = new_size;
+    }
+
+    auto record_nr = (uint32_t) header().records_count;
+    LeaderboardRecord &record = records()[record_nr];
+    record = {};
+    memcpy(record.name, name.data(), std::min(name.size(), (size_t) UINT8_MAX));
+    header().records_count++;
+
+    index.emplace(name, record_nr);
+    return record_nr;
+}
+
+// Adds to a statistic, which players of other rooms with the same name may update too.
+static void add_to_record(uint64_t &statistic) {
+    std::atomic_ref<uint64_t>(statistic).fetch_add(1, std::memory_order_relaxed);
+}
+
+void Leaderboard::start_game(players_map_t &players, LeaderboardGame &game) {
+    for (auto &player : players)
+        game.records[player.first] = find_or_add(std::string(player.second.name.view()));
+}
+
+void Leaderboard::record_turn(events_list_t &events, LeaderboardGame &game) {
+    // a robot dies at most once a turn, like in scores
+    player_id_set_t destroyed{};
+
+    for (auto &event : events) {
+        if (event.event_id != (uint8_t) EventType::BombExploded) continue;
+
+        for (auto robot : event.robots_destroyed) {
+            if (!destroyed.insert(robot).second) continue;
+            add_to_record(records()[game.records[robot]].deaths);
+            if (robot != event.player_id) add_to_record(records()[game.records[event.player_id]].kills);
+        }
+    }
+}
+
+void Leaderboard::end_game(const scores_map_t &scores, LeaderboardGame &game) {
+    Score best_score = UINT32_MAX;
+    for (auto &player_and_score : scores)
+        best_score = std::min(best_score, player_and_score.second);
+
+    for (auto &player_and_score : scores) {
+        LeaderboardRecord &record = records()[game.records[player_and_score.first]];
+        add_to_record(record.games);
+        if (player_and_score.second == best_score) add_to_record(record.wins);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        flush_pending = true;
+    }
+    flush_requested.notify_one();
+}
+
+// The flushing thread - writes the file to the disk when requested,
+// outside the game loop.
+void Leaderboard::flush_loop() {
+    std::unique_lock<std::mutex> lock(flush_mutex);
+    while (true) {
+        flush_requested.wait(lock, [this] { return flush_pending || stopping; });
+        flush_pending = false;
+        bool stop = stopping;
+        lock.unlock();
+
+        if (msync(mapping, file_size, MS_SYNC) < 0 && debug)
+            std::cerr << "leaderboard flush: " << strerror(errno) << "\n";
+        if (stop) return;
+        lock.lock();
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef BOMBOWE_ROBOTY_LEADERBOARD_H
+#define BOMBOWE_ROBOTY_LEADERBOARD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "definitions.h"
+
+/*
+A persistent leaderboard - statistics of every player name that has ever
+played on the server. The file is a header followed by fixed-size records,
+mapped into memory, so rooms update statistics with single relaxed atomic
+additions. Address space for LEADERBOARD_MAX_RECORDS records is mapped once,
+so the file grows without moving the mapping under other rooms' feet.
+An in-memory hash index maps player names to records and is rebuilt from
+the file on start. Records live in the page cache, so they survive a
+server crash; a flushing thread writes them to the disk after every game.
+The file uses the host's byte order and isn't meant to be moved between hosts.
+*/
+
+#define LEADERBOARD_MAGIC            "ROBOTSLB"
+#define LEADERBOARD_VERSION          1
+#define LEADERBOARD_INITIAL_CAPACITY 1024 // records
+#define LEADERBOARD_MAX_RECORDS      (1 << 24)
+
+struct LeaderboardHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t records_count;
+};
+
+struct LeaderboardRecord {
+    char name[UINT8_MAX + 1]; // zero-terminated
+    uint64_t kills; // robots destroyed by the player's bombs, except their own
+    uint64_t deaths;
+    uint64_t games;
+    uint64_t wins; // games ended with the lowest score, ties included
+};
+
+// Records of the players of a game, kept by its room.
+struct LeaderboardGame {
+    uint32_t records[UINT8_MAX + 1]{};
+};
+
+class Leaderboard {
+private:
+    int fd;
+    bool read_only;
+    char *mapping = nullptr;
+    size_t mapping_size = 0;
+    std::atomic<size_t> file_size{0};
+
+    // Guards the index and adding records.
+    std::mutex index_mutex;
+    std::unordered_map<std::string, uint32_t> index;
+
+    std::mutex flush_mutex;
+    std::condition_variable flush_requested;
+    bool flush_pending = false;
+    bool stopping = false;
+    std::thread flusher;
+
+    LeaderboardHeader &header() { return *(LeaderboardHeader *) mapping; }
+    LeaderboardRecord *records() { return (LeaderboardRecord *) (mapping + sizeof(LeaderboardHeader)); }
+    [[nodiscard]] size_t capacity() const;
+
+    uint32_t find_or_add(const std::string &name);
+    void flush_loop();
+
+public:
+    // Opens or creates the leaderboard file. Throws std::system_error
+    // if the file can't be used and std::runtime_error if it isn't a leaderboard.
+    explicit Leaderboard(const std::string &path, bool read_only = false);
+    ~Leaderboard();
+
+    Leaderboard(const Leaderboard &) = delete;
+    Leaderboard &operator=(const Leaderboard &) = delete;
+
+    // Finds records of the game's players, adding new players.
+    void start_game(players_map_t &players, LeaderboardGame &game);
+
+    // Counts kills and deaths of a turn.
+    void record_turn(events_list_t &events, LeaderboardGame &game);
+
+    // Counts games and wins and requests flushing the file.
+    void end_game(const scores_map_t &scores, LeaderboardGame &game);
+
+    [[nodiscard]] size_t size() { return header().records_count; }
+    const LeaderboardRecord &record(size_t i) { return records()[i]; }
+};
+
+#endif //BOMBOWE_ROBOTY_LEADERBOARD_H
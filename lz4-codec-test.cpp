@@ -0,0 +1,100 @@
+// Tests of the LZ4 codec - round trips of compressible and incompressible
+// data of lengths around the codec's limits, and malformed blocks.
+
+#include <random>
+#include <string>
+#include "lz4-codec.h"
+#include "test-utils.h"
+
+// Data repeating a short pattern with some noise, like a board of blocks.
+static std::vector<char> compressible(size_t len, std::mt19937 &random) {
+    std::vector<char> data(len);
+    for (size_t i = 0; i < len; i++)
+        data[i] = (char) (random() % 16 == 0 ? random() : i % 7);
+    return data;
+}
+
+static std::vector<char> incompressible(size_t len, std::mt19937 &random) {
+    std::vector<char> data(len);
+    for (auto &byte : data)
+        byte = (char) random();
+    return data;
+}
+
+static bool round_trip(Lz4Compressor &compressor, const std::vector<char> &data, size_t header_len = 0) {
+    size_t compressed_len = compressor.compress(data.data(), data.size(), header_len);
+    std::vector<char> compressed(compressor.data() + header_len, compressor.data() + header_len + compressed_len);
+    std::vector<char> output(data.size());
+    return lz4_decompress(compressed.data(), compressed.size(), output.data(), output.size()) &&
+           output == data;
+}
+
+static void test_round_trips() {
+    std::mt19937 random(1);
+    Lz4Compressor compressor;
+    // lengths around the last literals and match limit, the compression
+    // threshold of the server and the largest match offset
+    for (size_t len : {0, 1, 4, 5, 11, 12, 13, 16, 17, 255, 256, 1023, 1024, 1025,
+                       65535, 65536, 65537, 200000}) {
+        CHECK(round_trip(compressor, compressible(len, random)));
+        CHECK(round_trip(compressor, incompressible(len, random)));
+        CHECK(round_trip(compressor, std::vector<char>(len, 'x')));
+    }
+    CHECK(round_trip(compressor, compressible(1000, random), 9));
+}
+
+static void test_compression_ratio() {
+    std::mt19937 random(2);
+    Lz4Compressor compressor;
+    std::vector<char> zeros(1 << 16, 0);
+    CHECK(compressor.compress(zeros.data(), zeros.size(), 0) < zeros.size() / 100);
+
+    // incompressible data grows at most by the bound of the format
+    std::vector<char> noise = incompressible(1 << 16, random);
+    CHECK(compressor.compress(noise.data(), noise.size(), 0) <= noise.size() + noise.size() / 255 + 16);
+}
+
+static void test_malformed_blocks() {
+    std::mt19937 random(3);
+    Lz4Compressor compressor;
+    std::vector<char> data = compressible(4096, random);
+    size_t compressed_len = compressor.compress(data.data(), data.size(), 0);
+    std::vector<char> compressed(compressor.data(), compressor.data() + compressed_len);
+    std::vector<char> output(data.size() + 1);
+
+    // every truncation is rejected
+    for (size_t len = 0; len < compressed.size(); len++)
+        CHECK(!lz4_decompress(compressed.data(), len, output.data(), data.size()));
+    // the output has to have exactly the given length
+    CHECK(!lz4_decompress(compressed.data(), compressed.size(), output.data(), data.size() - 1));
+    CHECK(!lz4_decompress(compressed.data(), compressed.size(), output.data(), data.size() + 1));
+
+    // a match before the start of the output
+    const char before_start[] = {0x10, 'a', 0x05, 0x00, 0x00};
+    CHECK(!lz4_decompress(before_start, sizeof(before_start), output.data(), 5));
+    // a match with offset 0
+    const char zero_offset[] = {0x10, 'a', 0x00, 0x00};
+    CHECK(!lz4_decompress(zero_offset, sizeof(zero_offset), output.data(), 5));
+    // literals longer than the input
+    const char long_literals[] = {(char) 0xf0, 0x10, 'a'};
+    CHECK(!lz4_decompress(long_literals, sizeof(long_literals), output.data(), 32));
+    // a length extension cut off
+    const char cut_length[] = {(char) 0xf0, (char) 255};
+    CHECK(!lz4_decompress(cut_length, sizeof(cut_length), output.data(), 300));
+
+    // corrupted bytes never write past the output, whether or not they are detected
+    for (int i = 0; i < 1000; i++) {
+        std::vector<char> corrupted = compressed;
+        corrupted[random() % corrupted.size()] = (char) random();
+        std::vector<char> guarded(data.size() + 64, '#');
+        lz4_decompress(corrupted.data(), corrupted.size(), guarded.data(), data.size());
+        CHECK(std::string(guarded.begin() + (long) data.size(), guarded.end()) == std::string(64, '#'));
+    }
+}
+
+int main() {
+    test_round_trips();
+    test_compression_ratio();
+    test_malformed_blocks();
+    return test_result();
+}
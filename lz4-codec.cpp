@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cstring>
+#include "lz4-codec.h"
+
+#define LZ4_HASH_BITS       12
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5  // the last bytes are always literals
+#define LZ4_MATCH_LIMIT     12 // no match starts closer to the end
+#define LZ4_MAX_OFFSET      65535
+
+static uint32_t read_u32(const char *ptr) {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(uint32_t));
+    return value;
+}
+
+static uint32_t hash_position(const char *ptr) {
+    return (read_u32(ptr) * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// Writes a length extension - 255 bytes followed by the rest.
+static void put_length(char *&dest_ptr, size_t length) {
+    while (length >= 255) {
+        *dest_ptr++ = (char) 255;
+        length -= 255;
+    }
+    *dest_ptr++ = (char) length;
+}
+
+// Writes a sequence - literals and a match (if match_length > 0).
+static void put_sequence(char *&dest_ptr, const char *literals, size_t literals_length,
+                         size_t offset, size_t match_length) {
+    char *token = dest_ptr++;
+    size_t match_code = match_length > 0 ? match_length - LZ4_MIN_MATCH : 0;
+
+    *token = (char) ((std::min(literals_length, (size_t) 15) << 4) |
+                     std::min(match_code, (size_t) 15));
+    if (literals_length >= 15) put_length(dest_ptr, literals_length - 15);
+    memcpy(dest_ptr, literals, literals_length);
+    dest_ptr += literals_length;
+
+    if (match_length == 0) return; // the last sequence
+    *dest_ptr++ = (char) (offset & 0xff);
+    *dest_ptr++ = (char) (offset >> 8);
+    if (match_code >= 15) put_length(dest_ptr, match_code - 15);
+}
+
+Lz4Compressor::Lz4Compressor(): table(1 << LZ4_HASH_BITS) {}
+
+size_t Lz4Compressor::compress(const char *src, size_t len, size_t header_len) {
+    size_t bound = len + len / 255 + 16;
+    if (output.size() < header_len + bound) output.resize(header_len + bound);
+    std::fill(table.begin(), table.end(), 0);
+
+    char *dest_ptr = output.data() + header_len;
+    size_t anchor = 0, position = 0;
+
+    if (len >= LZ4_MATCH_LIMIT) {
+        size_t match_limit = len - LZ4_MATCH_LIMIT;
+        while (position < match_limit) {
+            uint32_t hash = hash_position(src + position);
+            size_t candidate = table[hash]; // positions are stored + 1
+            table[hash] = (uint32_t) position + 1;
+
+            if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET ||
+                read_u32(src + candidate - 1) != read_u32(src + position)) {
+                position++;
+                continue;
+            }
+
+            size_t match = candidate - 1;
+            size_t match_length = LZ4_MIN_MATCH;
+            while (position + match_length < len - LZ4_LAST_LITERALS &&
+                   src[match + match_length] == src[position + match_length])
+                match_length++;
+
+            put_sequence(dest_ptr, src + anchor, position - anchor,
+                         position - match, match_length);
+            position += match_length;
+            anchor = position;
+        }
+    }
+    put_sequence(dest_ptr, src + anchor, len - anchor, 0, 0);
+
+    return (size_t) (dest_ptr - (output.data() + header_len));
+}
+
+// Reads a length extension. Returns false if it exceeds the input.
+static bool get_length(const char *&src_ptr, const char *src_end, size_t &length) {
+    uint8_t byte;
+    do {
+        if (src_ptr == src_end) return false;
+        byte = (uint8_t) *src_ptr++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool lz4_decompress(const char *src, size_t src_len, char *dst, size_t dst_len) {
+    const char *src_ptr = src, *src_end = src + src_len;
+    char *dest_ptr = dst, *dest_end = dst + dst_len;
+
+    while (src_ptr < src_end) {
+        auto token = (uint8_t) *src_ptr++;
+
+        size_t literals_length = token >> 4;
+        if (literals_length == 15 && !get_length(src_ptr, src_end, literals_length))
+            return false;
+        if ((size_t) (src_end - src_ptr) < literals_length ||
+            (size_t) (dest_end - dest_ptr) < literals_length)
+            return false;
+
+        memcpy(dest_ptr, src_ptr, literals_length);
+        src_ptr += literals_length;
+        dest_ptr += literals_length;
+        if (src_ptr == src_end) break; // the last sequence has no match
+
+        if (src_end - src_ptr < 2) return false;
+        size_t offset = (uint8_t) src_ptr[0] | ((size_t) (uint8_t) src_ptr[1] << 8);
+        src_ptr += 2;
+        if (offset == 0 || offset > (size_t) (dest_ptr - dst)) return false;
+
+        size_t match_length = token & 0x0f;
+        if (match_length == 15 && !get_length(src_ptr, src_end, match_length))
+            return false;
+        match_length += LZ4_MIN_MATCH;
+        if ((size_t) (dest_end - dest_ptr) < match_length) return false;
+
+        // matches may overlap with their output, copy byte by byte
+        const char *match = dest_ptr - offset;
+        for (size_t i = 0; i < match_length; i++)
+            dest_ptr[i] = match[i];
+        dest_ptr += match_length;
+    }
+    return dest_ptr == dest_end;
+}
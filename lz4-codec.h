@@ -0,0 +1,35 @@
+#ifndef BOMBOWE_ROBOTY_LZ4_CODEC_H
+#define BOMBOWE_ROBOTY_LZ4_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+An in-tree implementation of the LZ4 block format, used for compressing
+large server messages (e.g. turn 0 on a block-heavy board).
+*/
+
+// A reusable compression context - the hash table and the output buffer
+// are allocated once and reused by every following compression.
+class Lz4Compressor {
+private:
+    std::vector<uint32_t> table;
+    std::vector<char> output;
+
+public:
+    Lz4Compressor();
+
+    // Compresses [len] bytes of [src]. The result is placed in data()
+    // after [header_len] bytes left for the caller.
+    // Returns the compressed length (without the header).
+    size_t compress(const char *src, size_t len, size_t header_len);
+
+    [[nodiscard]] char *data() { return output.data(); }
+};
+
+// Decompresses an LZ4 block into exactly [dst_len] bytes.
+// Returns false if the block is malformed.
+bool lz4_decompress(const char *src, size_t src_len, char *dst, size_t dst_len);
+
+#endif //BOMBOWE_ROBOTY_LZ4_CODEC_H
@@ -0,0 +1,122 @@
+#include <thread>
+#include "matchmaker.h"
+
+Matchmaker::Matchmaker(ServerOptions &options, Leaderboard *leaderboard,
+                       EventExport *event_export, CheckpointStore *checkpoints):
+        options(options), leaderboard(leaderboard), event_export(event_export),
+        checkpoints(checkpoints) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (checkpoints) recover_rooms();
+    filling_room.store(open_room(), std::memory_order_release);
+}
+
+// Creates a new room, without starting its thread. Every room gets a backend
+// of its own, as backends keep per-thread state, e.g. an io_uring ring.
+// Called with the mutex locked.
+Room *Matchmaker::create_room() {
+    if (rooms.size() > UINT16_MAX) throw std::runtime_error("too many rooms");
+    auto room_id = (uint16_t) rooms.size();
+    rooms.push_back(std::make_unique<Room>(options, create_backend(options.backend), leaderboard,
+                                           event_export, checkpoints, *this, room_id));
+    return rooms.back().get();
+}
+
+// Returns an idle room or creates a new one, with its own thread.
+// Called with the mutex locked.
+Room *Matchmaker::open_room() {
+    if (!idle_rooms.empty()) {
+        Room *room = idle_rooms.back();
+        idle_rooms.pop_back();
+        return room;
+    }
+
+    Room *room = create_room();
+    std::thread([room] { room->run(); }).detach();
+
+    if (debug) std::cerr << "opened room " << room->id << "\n";
+    return room;
+}
+
+// Creates rooms up to the last one with a checkpoint, so tokens of its
+// players lead to it. Rooms without a game are idle.
+// Called with the mutex locked.
+void Matchmaker::recover_rooms() {
+    auto recovered = checkpoints->take_recovered();
+    if (recovered.empty()) return;
+
+    while (rooms.size() <= recovered.rbegin()->first) {
+        Room *room = create_room();
+        auto checkpoint_it = recovered.find(room->id);
+        bool resumed = checkpoint_it != recovered.end() &&
+                       room->recover({checkpoint_it->second.data(), checkpoint_it->second.size()});
+        if (checkpoint_it != recovered.end() && !resumed)
+            std::cerr << "room " << room->id << ": malformed checkpoint\n";
+        if (!resumed) idle_rooms.push_back(room);
+        std::thread([room] { room->run(); }).detach();
+    }
+}
+
+// Replaces the filling room if it is still [room].
+void Matchmaker::replace_filling_room(Room *room) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (filling_room.load(std::memory_order_relaxed) == room)
+        filling_room.store(open_room(), std::memory_order_release);
+}
+
+void Matchmaker::move_session(const session_ptr_t &session, Room *room) {
+    if (session->room) session->room->remove_session(session);
+    session->room = room;
+    room->add_session(session);
+}
+
+void Matchmaker::add_session(const session_ptr_t &session, std::optional<uint64_t> token) {
+    Room *room = nullptr;
+    if (token.has_value()) {
+        size_t room_id = *token >> TOKEN_ROOM_SHIFT;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (room_id < rooms.size()) room = rooms[room_id].get();
+    }
+    if (!room) room = filling_room.load(std::memory_order_acquire);
+
+    session->room = room;
+    room->add_session(session, token);
+}
+
+void Matchmaker::remove_session(const session_ptr_t &session) {
+    if (session->room) session->room->remove_session(session);
+}
+
+void Matchmaker::join(const session_ptr_t &session, std::string &name) {
+    if (session->acting_player.load(std::memory_order_acquire) >= 0) return;
+
+    while (true) {
+        Room *room = filling_room.load(std::memory_order_acquire);
+        if (session->room != room) move_session(session, room);
+        if (room->join(session, name)) return;
+        // the room has just filled up, before its thread replaced it
+        replace_filling_room(room);
+    }
+}
+
+void Matchmaker::set_capabilities(const session_ptr_t &session, uint8_t capabilities) {
+    // capabilities come before the session is registered in any room
+    Room *room = session->room ? session->room : filling_room.load(std::memory_order_acquire);
+    room->set_capabilities(session, capabilities);
+}
+
+void Matchmaker::set_action(const session_ptr_t &session, PlayerAction action) {
+    if (session->room) session->room->set_action(session, action);
+}
+
+size_t Matchmaker::lobby_sessions() {
+    return filling_room.load(std::memory_order_acquire)->lobby_sessions();
+}
+
+void Matchmaker::game_started(Room &room) {
+    replace_filling_room(&room);
+}
+
+void Matchmaker::game_ended(Room &room) {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle_rooms.push_back(&room);
+}
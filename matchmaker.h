@@ -0,0 +1,62 @@
+#ifndef BOMBOWE_ROBOTY_MATCHMAKER_H
+#define BOMBOWE_ROBOTY_MATCHMAKER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "server-room.h"
+
+/*
+The matchmaker groups joining players into rooms of players_count. There is
+always one filling room - new sessions watch its lobby and every Join goes
+there, so joining is O(1). When the filling room starts its game (full or after
+the lobby timeout), an idle room (one whose game has ended) or a new one takes
+its place. The filling room is an atomic pointer, so accepting a session takes
+no lock; the mutex guards only the list of rooms and is taken when a room starts
+or ends its game and when a session resumes with a token.
+*/
+
+class Matchmaker : public RoomListener {
+private:
+    ServerOptions &options;
+    Leaderboard *leaderboard;
+    EventExport *event_export;
+    CheckpointStore *checkpoints;
+
+    std::atomic<Room *> filling_room{nullptr};
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Room>> rooms; // indexed by room id, never shrinks
+    std::vector<Room *> idle_rooms;
+
+    Room *create_room();
+    Room *open_room();
+    void recover_rooms();
+    void replace_filling_room(Room *room);
+    void move_session(const session_ptr_t &session, Room *room);
+
+public:
+    // Resumes games of the checkpoints, if there are any, in rooms of their ids.
+    Matchmaker(ServerOptions &options, Leaderboard *leaderboard,
+               EventExport *event_export, CheckpointStore *checkpoints);
+
+    // Registers a session in the filling room, or in the room of its
+    // session token, if it has one.
+    void add_session(const session_ptr_t &session, std::optional<uint64_t> token = {});
+    void remove_session(const session_ptr_t &session);
+
+    // Moves the session to the filling room, if it is elsewhere, and joins it there.
+    void join(const session_ptr_t &session, std::string &name);
+
+    void set_capabilities(const session_ptr_t &session, uint8_t capabilities);
+    void set_action(const session_ptr_t &session, PlayerAction action);
+
+    // Returns the number of sessions in the filling room.
+    size_t lobby_sessions();
+
+    void game_started(Room &room) override;
+    void game_ended(Room &room) override;
+};
+
+#endif //BOMBOWE_ROBOTY_MATCHMAKER_H
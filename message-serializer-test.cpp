@@ -0,0 +1,170 @@
+// Tests of the compact encoding - turns of played games and snapshots
+// parsed by the client in both encodings give the same state, and
+// varints and bit-packed ids survive their extreme values.
+
+#include "definitions.h"
+#include "game-handler.h"
+#include "game-rules.h"
+#include "message-serializer.h"
+#include "test-utils.h"
+
+// Returns a buffer of an unconnected socket, parsing only [message] after its type.
+static std::unique_ptr<Buffer> message_buffer(boost::asio::ip::tcp::socket &socket,
+                                              const std::vector<char> &message, bool compact) {
+    auto buffer = std::make_unique<Buffer>(socket);
+    buffer->insert_data(message.data() + 1, message.size() - 1);
+    buffer->set_compact(compact);
+    return buffer;
+}
+
+static bool same_bombs(const bombs_map_t &a, const bombs_map_t &b) {
+    if (a.size() != b.size()) return false;
+    for (auto &[id, bomb] : a) {
+        auto it = b.find(id);
+        if (it == b.end() || !(it->second.position == bomb.position) || it->second.timer != bomb.timer)
+            return false;
+    }
+    return true;
+}
+
+static bool same_state(const GameState &a, const GameState &b) {
+    return a.turn == b.turn && a.player_positions.get() == b.player_positions.get() &&
+           a.blocks.get() == b.blocks.get() && a.scores.get() == b.scores.get() &&
+           same_bombs(a.bombs.get(), b.bombs.get());
+}
+
+static ServerOptions test_rules(uint8_t players_count) {
+    ServerOptions rules{};
+    rules.bomb_timer = 3;
+    rules.players_count = players_count;
+    rules.explosion_radius = 3;
+    rules.initial_blocks = 60;
+    rules.game_length = 200;
+    rules.size_x = 20;
+    rules.size_y = 20;
+    return rules;
+}
+
+// Plays a game with random actions, parsing every turn in both encodings.
+static void test_turns(uint8_t players_count, uint32_t seed) {
+    ServerOptions rules = test_rules(players_count);
+    GameParameters params("test", players_count, rules.size_x, rules.size_y, rules.game_length,
+                          rules.explosion_radius, rules.bomb_timer);
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    StringTable strings;
+    std::minstd_rand random(seed);
+
+    players_map_t players;
+    for (uint16_t id = 0; id < players_count; id++)
+        players.insert(std::make_pair((PlayerId) id, Player(strings, "player" + std::to_string(id), "addr")));
+    positions_set_t no_blocks;
+    player_positions_map_t no_positions;
+    GameState standard_state(players, no_blocks, no_positions);
+    GameState compact_state(players, no_blocks, no_positions);
+
+    ServerGame game;
+    events_list_t events = start_game(game, rules, players, random);
+    std::vector<char> standard, compact;
+    uint8_t id_bits = player_id_bits(players_count);
+    actions_table_t actions{};
+    for (uint16_t turn = 0; turn <= rules.game_length; turn++) {
+        if (turn > 0) {
+            for (uint16_t id = 0; id < players_count; id++) {
+                auto type = random() % 4 == 0 ? ClientPlaceBomb : random() % 4 == 0 ? ClientPlaceBlock : ClientMove;
+                actions[id] = PlayerAction{type, (uint8_t) (random() % DIRECTIONS_NUMBER)};
+            }
+            events = play_turn(game, rules, actions, random);
+        }
+
+        standard.clear();
+        serialize_turn_message(standard, events, turn);
+        compact.clear();
+        serialize_compact_turn_message(compact, events, turn, id_bits);
+        CHECK(compact.size() <= standard.size());
+
+        auto standard_buffer = message_buffer(socket, standard, false);
+        aggregate_game_state(*standard_buffer, standard_state, params);
+        CHECK(standard_buffer->get_parsed_len() == standard_buffer->get_msg_len());
+        auto compact_buffer = message_buffer(socket, compact, true);
+        aggregate_game_state(*compact_buffer, compact_state, params);
+        CHECK(compact_buffer->get_parsed_len() == compact_buffer->get_msg_len());
+
+        CHECK(same_state(standard_state, compact_state));
+        CHECK(compact_state.blocks.get() == game.state.blocks.get());
+        CHECK(compact_state.player_positions.get() == game.state.player_positions.get());
+    }
+
+    // a snapshot of the finished game gives the same state in both encodings
+    for (bool compact_snapshot : {false, true}) {
+        std::vector<char> snapshot;
+        serialize_game_snapshot_message(snapshot, game.state, compact_snapshot);
+        auto buffer = message_buffer(socket, snapshot, compact_snapshot);
+        GameState state;
+        read_game_snapshot(*buffer, state, strings);
+        CHECK(buffer->get_parsed_len() == buffer->get_msg_len());
+        CHECK(state.turn == game.state.turn);
+        CHECK(state.blocks.get() == game.state.blocks.get());
+        CHECK(state.player_positions.get() == game.state.player_positions.get());
+        CHECK(state.scores.get() == game.state.scores.get());
+        CHECK(state.players.get().size() == players.size());
+        for (auto &[id, player] : players)
+            CHECK(state.players.get().at(id).name.view() == player.name.view());
+    }
+}
+
+// Varints of extreme values and id lists of all widths in a BombExploded event.
+static void test_extreme_values() {
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+
+    for (uint32_t players_count : {1u, 2u, 3u, 17u, 128u, 255u}) {
+        uint8_t id_bits = player_id_bits((uint8_t) players_count);
+        CHECK(id_bits >= 1 && (id_bits == 8 || (1u << id_bits) >= players_count));
+
+        GameParameters params("test", (uint8_t) players_count, UINT16_MAX, UINT16_MAX, 1, 0, UINT16_MAX);
+        positions_set_t blocks = {{0, 0}, {0, 127}, {0, 128}, {UINT16_MAX, 0}, {UINT16_MAX, UINT16_MAX}};
+        Event placed{};
+        placed.event_id = BombPlaced;
+        placed.bomb_id = UINT32_MAX;
+        placed.position = {UINT16_MAX, UINT16_MAX};
+        Event exploded{};
+        exploded.event_id = BombExploded;
+        exploded.bomb_id = UINT32_MAX;
+        for (uint32_t id = 0; id < players_count; id += 2)
+            exploded.robots_destroyed.push_back((PlayerId) id);
+        exploded.robots_destroyed.push_back((PlayerId) (players_count - 1));
+        exploded.blocks_destroyed.assign(blocks.begin(), blocks.end());
+
+        std::vector<char> message;
+        events_list_t placing = {placed};
+        serialize_compact_turn_message(message, placing, UINT16_MAX, id_bits);
+        players_map_t players;
+        player_positions_map_t player_positions;
+        GameState state(players, blocks, player_positions);
+        auto buffer = message_buffer(socket, message, true);
+        aggregate_game_state(*buffer, state, params);
+        CHECK(state.turn == UINT16_MAX);
+        CHECK(state.bombs.get().count(UINT32_MAX) == 1);
+        CHECK(state.bombs.get().at(UINT32_MAX).position == placed.position);
+
+        message.clear();
+        events_list_t exploding = {exploded};
+        serialize_compact_turn_message(message, exploding, 0, id_bits);
+        buffer = message_buffer(socket, message, true);
+        aggregate_game_state(*buffer, state, params);
+        CHECK(buffer->get_parsed_len() == buffer->get_msg_len());
+        CHECK(state.bombs.get().empty());
+        CHECK(state.blocks.get().empty());
+        for (auto id : exploded.robots_destroyed)
+            CHECK(state.scores.get().at(id) == 1);
+        CHECK(state.scores.get().size() == (players_count + 1) / 2 + (players_count % 2 == 0 ? 1 : 0));
+    }
+}
+
+int main() {
+    for (uint8_t players_count : {(uint8_t) 1, (uint8_t) 2, (uint8_t) 5, (uint8_t) 25})
+        test_turns(players_count, players_count * 7919u);
+    test_extreme_values();
+    return test_result();
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "message-serializer.h"
 
 // Helper function - copies [size] bites from src ptr to dest ptr.
@@ -6,6 +7,14 @@ void put_data_into_buffer(char *&dest_ptr, void *src, size_t size) {
     dest_ptr += size;
 }
 
+// Helper function - makes room for [len] bytes at the end of a growable
+// buffer and returns a pointer to them.
+static char *append_space(std::vector<char> &out, size_t len) {
+    size_t offset = out.size();
+    out.resize(offset + len);
+    return out.data() + offset;
+}
+
 static void put_uint_32_into_buffer(char *&dest_ptr, uint32_t number) {
     uint32_t number_to_send = htonl(number);
     put_data_into_buffer(dest_ptr, &number_to_send, sizeof(uint32_t));
@@ -21,23 +30,20 @@ static size_t serialize_object_size(char *&dest_ptr, uint32_t size) {
     return sizeof(uint32_t);
 }
 
-static size_t serialize_players_map(char *&dest_ptr, players_map_t &map) {
+static size_t serialize_players_map(char *&dest_ptr, const players_map_t &map) {
     size_t total_size = serialize_object_size(dest_ptr, (uint32_t) map.size());
 
     for (auto &player: map) { // serialize elements in a loop
         uint8_t player_id = player.first;
-        std::string player_name = player.second.name;
-        std::string player_address = player.second.address;
-        auto player_name_len = (uint8_t) player_name.length();
-        auto player_address_len = (uint8_t) player_address.length();
+        // interned strings are kept with their lengths in front
+        std::string_view player_name = player.second.name.encoded();
+        std::string_view player_address = player.second.address.encoded();
 
         put_data_into_buffer(dest_ptr, &player_id, 1);
-        put_data_into_buffer(dest_ptr, &player_name_len, 1);
-        put_data_into_buffer(dest_ptr, (void *) player_name.c_str(), player_name_len);
-        put_data_into_buffer(dest_ptr, &player_address_len, 1);
-        put_data_into_buffer(dest_ptr, (void *) player_address.c_str(), player_address_len);
+        put_data_into_buffer(dest_ptr, (void *) player_name.data(), player_name.length());
+        put_data_into_buffer(dest_ptr, (void *) player_address.data(), player_address.length());
 
-        total_size += (3 * sizeof(uint8_t) + player_name_len + player_address_len);
+        total_size += sizeof(uint8_t) + player_name.length() + player_address.length();
     }
     return total_size;
 }
@@ -54,7 +60,7 @@ static size_t serialize_bomb(char *&dest_ptr, const Bomb &bomb) {
     return 3 * sizeof(uint16_t);
 }
 
-static size_t serialize_player_positions_map(char *&dest_ptr, player_positions_map_t &map) {
+static size_t serialize_player_positions_map(char *&dest_ptr, const player_positions_map_t &map) {
     size_t total_size = serialize_object_size(dest_ptr, (uint32_t) map.size());
 
     for (const auto &player_and_pos: map) { // serialize elements in a loop
@@ -67,7 +73,7 @@ static size_t serialize_player_positions_map(char *&dest_ptr, player_positions_m
     return total_size;
 }
 
-static size_t serialize_scores_map(char *&dest_ptr, scores_map_t &map) {
+static size_t serialize_scores_map(char *&dest_ptr, const scores_map_t &map) {
     size_t total_size = serialize_object_size(dest_ptr, (uint32_t) map.size());
 
     for (auto player_and_score: map) { // serialize elements in a loop
@@ -82,7 +88,7 @@ static size_t serialize_scores_map(char *&dest_ptr, scores_map_t &map) {
     return total_size;
 }
 
-static size_t serialize_position_set(char *&dest_ptr, positions_set_t &positions) {
+static size_t serialize_position_set(char *&dest_ptr, const positions_set_t &positions) {
     size_t total_size = serialize_object_size(dest_ptr, (uint32_t) positions.size());
 
     for(const auto &pos: positions) // serialize elements in a loop
@@ -91,7 +97,7 @@ static size_t serialize_position_set(char *&dest_ptr, positions_set_t &positions
     return total_size;
 }
 
-static size_t serialize_bomb_list(char *&dest_ptr, bombs_map_t &bombs) {
+static size_t serialize_bomb_list(char *&dest_ptr, const bombs_map_t &bombs) {
     size_t total_size = serialize_object_size(dest_ptr, (uint32_t) bombs.size());
 
     for (auto &bomb: bombs)
@@ -118,7 +124,7 @@ static void serialize_player_id_list(char *&dest_ptr, player_id_list_t &players)
 }
 
 size_t serialize_lobby_message(GameParameters &parameters, char buffer[],
-                               players_map_t players) {
+                               players_map_t &players) {
 
     State msg_type = Lobby;
     char *dest_ptr = buffer;
@@ -160,19 +166,20 @@ size_t serialize_game_message(GameParameters &parameters, GameState &state,
 
     size_t total_size = name_length + 2 * sizeof(uint8_t) + 4 * sizeof(uint16_t);
 
-    total_size += serialize_players_map(dest_ptr, state.players);
-    total_size += serialize_player_positions_map(dest_ptr, state.player_positions);
-    total_size += serialize_position_set(dest_ptr, state.blocks);
-    total_size += serialize_bomb_list(dest_ptr, state.bombs);
-    total_size += serialize_position_set(dest_ptr, state.explosions);
-    total_size += serialize_scores_map(dest_ptr, state.scores);
+    total_size += serialize_players_map(dest_ptr, state.players.get());
+    total_size += serialize_player_positions_map(dest_ptr, state.player_positions.get());
+    total_size += serialize_position_set(dest_ptr, state.blocks.get());
+    total_size += serialize_bomb_list(dest_ptr, state.bombs.get());
+    total_size += serialize_position_set(dest_ptr, state.explosions.get());
+    total_size += serialize_scores_map(dest_ptr, state.scores.get());
 
     return total_size;
 }
 
-void serialize_hello_message(char buffer[], ServerOptions &options) {
+void serialize_hello_message(std::vector<char> &out, ServerOptions &options) {
+    size_t msg_len = options.server_name.length() + 5 * sizeof(uint16_t) + 3 * sizeof(uint8_t);
     ServerMessage msg_type = Hello;
-    char *dest_ptr = buffer;
+    char *dest_ptr = append_space(out, msg_len);
     put_data_into_buffer(dest_ptr, &msg_type, sizeof(uint8_t));
 
     uint8_t name_length = (uint8_t) options.server_name.length();
@@ -188,62 +195,297 @@ void serialize_hello_message(char buffer[], ServerOptions &options) {
     put_uint_16_into_buffer(dest_ptr, options.bomb_timer);
 }
 
-void serialize_accepted_player_message(char buffer[], std::string &name,
-                                       std::string &address, uint8_t id) {
-
+void serialize_accepted_player_message(std::vector<char> &out, Player &player, uint8_t id) {
+    std::string_view name = player.name.encoded(), address = player.address.encoded();
+    size_t msg_len = name.length() + address.length() + 2 * sizeof(uint8_t);
     ServerMessage msg_type = AcceptedPlayer;
-    char *dest_ptr = buffer;
+    char *dest_ptr = append_space(out, msg_len);
     put_data_into_buffer(dest_ptr, &msg_type, sizeof(uint8_t));
 
     put_data_into_buffer(dest_ptr, &id, sizeof(uint8_t));
-    uint8_t name_length = (uint8_t) name.length();
-    put_data_into_buffer(dest_ptr, &name_length, sizeof(uint8_t));
-    put_data_into_buffer(dest_ptr, (void *) name.c_str(),
-                         name_length);
+    put_data_into_buffer(dest_ptr, (void *) name.data(), name.length());
+    put_data_into_buffer(dest_ptr, (void *) address.data(), address.length());
+}
 
-    uint8_t address_length = (uint8_t) address.length();
-    put_data_into_buffer(dest_ptr, &address_length, sizeof(uint8_t));
-    put_data_into_buffer(dest_ptr, (void *) address.c_str(),
-                         address_length);
+// This functions calculates game_started message length.
+static size_t get_game_started_len(players_map_t &players) {
+    size_t result = sizeof(uint8_t) + sizeof(uint32_t);
+
+    for (auto &player : players) {
+        result += sizeof(uint8_t); // id
+        result += player.second.name.encoded().length();
+        result += player.second.address.encoded().length();
+    }
+
+    return result;
 }
 
-void serialize_game_started_message(char buffer[], players_map_t &players) {
+void serialize_game_started_message(std::vector<char> &out, players_map_t &players) {
     ServerMessage msg_type = GameStarted;
-    char *dest_ptr = buffer;
+    char *dest_ptr = append_space(out, get_game_started_len(players));
     put_data_into_buffer(dest_ptr, &msg_type, sizeof(uint8_t));
 
     serialize_players_map(dest_ptr, players);
 }
 
-void serialize_turn_message(char buffer[], events_list_t &events, uint16_t turn_nr) {
+void serialize_game_ended_message(std::vector<char> &out, const scores_map_t &scores) {
+    size_t msg_len = sizeof(uint8_t) + sizeof(uint32_t) +
+                     scores.size() * (sizeof(PlayerId) + sizeof(Score));
+    ServerMessage msg_type = GameEnded;
+    char *dest_ptr = append_space(out, msg_len);
+    put_data_into_buffer(dest_ptr, &msg_type, sizeof(uint8_t));
+
+    serialize_scores_map(dest_ptr, scores);
+}
+
+size_t serialize_event(char *&dest_ptr, Event &event) {
+    char *start_ptr = dest_ptr;
+    uint8_t id = event.event_id;
+    put_data_into_buffer(dest_ptr, &id, sizeof(uint8_t));
+
+    switch ((EventType) id) {
+        case BombPlaced:
+            put_uint_32_into_buffer(dest_ptr, event.bomb_id);
+            serialize_position(dest_ptr, event.position);
+            break;
+        case BombExploded:
+            put_uint_32_into_buffer(dest_ptr, event.bomb_id);
+            serialize_player_id_list(dest_ptr, event.robots_destroyed);
+            serialize_position_list(dest_ptr, event.blocks_destroyed);
+            break;
+        case PlayerMoved:
+            put_data_into_buffer(dest_ptr, &event.player_id, sizeof(uint8_t));
+            serialize_position(dest_ptr, event.position);
+            break;
+        case BlockPlaced:
+            serialize_position(dest_ptr, event.position);
+            break;
+    }
+    return (size_t) (dest_ptr - start_ptr);
+}
+
+size_t get_event_len(Event &event) {
+    size_t result = sizeof(uint8_t); // event id
+
+    switch ((EventType) event.event_id) {
+        case BombPlaced:
+            result += sizeof(BombId) + 2 * sizeof(uint16_t); // bomb id and position
+            break;
+        case BombExploded:
+            result += sizeof(BombId) + 2 * sizeof(uint32_t);
+            result += (event.blocks_destroyed.size()) * (2 * sizeof(uint16_t));
+            result += (event.robots_destroyed.size()) * (sizeof (PlayerId));
+            break;
+        case PlayerMoved:
+            result += sizeof(PlayerId) + 2 * sizeof(uint16_t); // player id and position
+            break;
+        case BlockPlaced:
+            result += 2 * sizeof(uint16_t); // position
+            break;
+    }
+    return result;
+}
+
+void serialize_turn_header(char buffer[], uint16_t turn_nr, uint32_t events_count) {
     ServerMessage msg_type = Turn;
     char *dest_ptr = buffer;
     put_data_into_buffer(dest_ptr, &msg_type, sizeof(uint8_t));
 
     put_uint_16_into_buffer(dest_ptr, turn_nr);
-    put_uint_32_into_buffer(dest_ptr, (uint32_t) events.size());
-
-    uint8_t id;
-    for (auto &event : events) {
-        id = event.event_id;
-        put_data_into_buffer(dest_ptr, &id, sizeof(uint8_t));
-        switch ((EventType) id) {
-            case BombPlaced:
-                put_uint_32_into_buffer(dest_ptr, event.bomb_id);
-                serialize_position(dest_ptr, event.position);
-                break;
-            case BombExploded:
-                put_uint_32_into_buffer(dest_ptr, event.bomb_id);
-                serialize_player_id_list(dest_ptr, event.robots_destroyed);
-                serialize_position_list(dest_ptr, event.blocks_destroyed);
-                break;
-            case PlayerMoved:
-                put_data_into_buffer(dest_ptr, &event.player_id, sizeof(uint8_t));
-                serialize_position(dest_ptr, event.position);
-                break;
-            case BlockPlaced:
-                serialize_position(dest_ptr, event.position);
-                break;
+    put_uint_32_into_buffer(dest_ptr, events_count);
+}
+
+void serialize_turn_message(std::vector<char> &out, events_list_t &events, uint16_t turn_nr) {
+    size_t msg_len = TURN_HEADER_LENGTH;
+    for (auto &event : events)
+        msg_len += get_event_len(event);
+
+    char *buffer = append_space(out, msg_len);
+    serialize_turn_header(buffer, turn_nr, (uint32_t) events.size());
+    char *dest_ptr = buffer + TURN_HEADER_LENGTH;
+
+    for (auto &event : events)
+        serialize_event(dest_ptr, event);
+}
+
+static void put_varint(std::vector<char> &out, uint32_t number) {
+    while (number >= 0x80) {
+        out.push_back((char) ((number & 0x7f) | 0x80));
+        number >>= 7;
+    }
+    out.push_back((char) number);
+}
+
+static void put_compact_position(std::vector<char> &out, const Position &position) {
+    put_varint(out, position.x);
+    put_varint(out, position.y);
+}
+
+static void put_compact_position_list(std::vector<char> &out, positions_list_t positions) {
+    put_varint(out, (uint32_t) positions.size());
+    std::sort(positions.begin(), positions.end());
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (i == 0) {
+            put_compact_position(out, positions[i]);
+            continue;
+        }
+        auto dx = (uint16_t) (positions[i].x - positions[i - 1].x);
+        put_varint(out, dx);
+        put_varint(out, dx == 0 ? (uint16_t) (positions[i].y - positions[i - 1].y) :
+                                  positions[i].y);
+    }
+}
+
+static void put_packed_player_ids(std::vector<char> &out, player_id_list_t &players,
+                                  uint8_t id_bits) {
+    put_varint(out, (uint32_t) players.size());
+
+    uint32_t bits = 0, bits_count = 0;
+    for (auto id : players) {
+        bits |= (uint32_t) id << bits_count;
+        bits_count += id_bits;
+        while (bits_count >= 8) {
+            out.push_back((char) (bits & 0xff));
+            bits >>= 8;
+            bits_count -= 8;
+        }
+    }
+    if (bits_count > 0) out.push_back((char) bits);
+}
+
+uint8_t player_id_bits(uint8_t players_count) {
+    uint8_t bits = 1;
+    while (bits < 8 && (1u << bits) < players_count) bits++;
+    return bits;
+}
+
+void serialize_compact_game_started_message(std::vector<char> &out, players_map_t &players) {
+    out.push_back((char) GameStarted);
+    put_varint(out, (uint32_t) players.size());
+
+    for (auto &player : players) {
+        out.push_back((char) player.first);
+        std::string_view name = player.second.name.encoded(), address = player.second.address.encoded();
+        out.insert(out.end(), name.begin(), name.end());
+        out.insert(out.end(), address.begin(), address.end());
+    }
+}
+
+void serialize_compact_turn_header(std::vector<char> &out, uint16_t turn_nr,
+                                   uint32_t events_count) {
+    out.push_back((char) Turn);
+    put_varint(out, turn_nr);
+    put_varint(out, events_count);
+}
+
+void serialize_compact_event(std::vector<char> &out, Event &event, uint8_t id_bits) {
+    out.push_back((char) event.event_id);
+
+    switch ((EventType) event.event_id) {
+        case BombPlaced:
+            put_varint(out, event.bomb_id);
+            put_compact_position(out, event.position);
+            break;
+        case BombExploded:
+            put_varint(out, event.bomb_id);
+            put_packed_player_ids(out, event.robots_destroyed, id_bits);
+            put_compact_position_list(out, event.blocks_destroyed);
+            break;
+        case PlayerMoved:
+            out.push_back((char) event.player_id);
+            put_compact_position(out, event.position);
+            break;
+        case BlockPlaced:
+            put_compact_position(out, event.position);
+            break;
+    }
+}
+
+void serialize_compact_turn_message(std::vector<char> &out, events_list_t &events,
+                                    uint16_t turn_nr, uint8_t id_bits) {
+    serialize_compact_turn_header(out, turn_nr, (uint32_t) events.size());
+
+    for (auto &event : events)
+        serialize_compact_event(out, event, id_bits);
+}
+
+void serialize_compact_game_ended_message(std::vector<char> &out, const scores_map_t &scores) {
+    out.push_back((char) GameEnded);
+    put_varint(out, (uint32_t) scores.size());
+
+    for (auto &player_and_score : scores) {
+        out.push_back((char) player_and_score.first);
+        put_varint(out, player_and_score.second);
+    }
+}
+
+void serialize_game_snapshot_message(std::vector<char> &out, GameState &state, bool compact) {
+    // numbers are varints in compact encoding
+    auto put_number = [&]<typename T>(T number) {
+        if (compact) {
+            put_varint(out, number);
+            return;
         }
+        size_t offset = out.size();
+        out.resize(offset + sizeof(T));
+        char *dest_ptr = out.data() + offset;
+        if constexpr (sizeof(T) == sizeof(uint16_t)) put_uint_16_into_buffer(dest_ptr, number);
+        else put_uint_32_into_buffer(dest_ptr, number);
+    };
+    auto put_u16_or_varint = [&](uint16_t number) { put_number(number); };
+    auto put_u32_or_varint = [&](uint32_t number) { put_number(number); };
+    auto put_position = [&](const Position &position) {
+        put_u16_or_varint(position.x);
+        put_u16_or_varint(position.y);
+    };
+
+    out.push_back((char) GameSnapshot);
+    put_u16_or_varint(state.turn);
+
+    put_u32_or_varint((uint32_t) state.players.size());
+    for (auto &player : state.players) {
+        out.push_back((char) player.first);
+        std::string_view name = player.second.name.encoded(), address = player.second.address.encoded();
+        out.insert(out.end(), name.begin(), name.end());
+        out.insert(out.end(), address.begin(), address.end());
+    }
+
+    put_u32_or_varint((uint32_t) state.player_positions.size());
+    for (auto &player_and_pos : state.player_positions) {
+        out.push_back((char) player_and_pos.first);
+        put_position(player_and_pos.second);
+    }
+
+    if (compact) {
+        put_compact_position_list(out, positions_list_t(state.blocks.begin(),
+                                                        state.blocks.end()));
+    }
+    else {
+        put_u32_or_varint((uint32_t) state.blocks.size());
+        for (auto &block : state.blocks)
+            put_position(block);
     }
+
+    put_u32_or_varint((uint32_t) state.bombs.size());
+    for (auto &bomb : state.bombs) {
+        put_u32_or_varint(bomb.first);
+        put_position(bomb.second.position);
+        put_u16_or_varint(bomb.second.timer);
+    }
+
+    put_u32_or_varint((uint32_t) state.scores.size());
+    for (auto &player_and_score : state.scores) {
+        out.push_back((char) player_and_score.first);
+        put_u32_or_varint(player_and_score.second);
+    }
+}
+
+void serialize_session_token_message(char buffer[], uint64_t token) {
+    char *dest_ptr = buffer;
+    auto msg_type = (uint8_t) SessionToken;
+
+    put_data_into_buffer(dest_ptr, &msg_type, sizeof(uint8_t));
+    put_uint_32_into_buffer(dest_ptr, (uint32_t) (token >> 32));
+    put_uint_32_into_buffer(dest_ptr, (uint32_t) token);
 }
@@ -10,18 +10,71 @@ void put_data_into_buffer(char *&dest_ptr, void *src, size_t size);
 // The functions below serialize different types of messages and put them into
 // a given buffer. They use helper functions defined in message-serializer.cpp
 
-size_t serialize_lobby_message(GameParameters &parameters, char buffer[], players_map_t players);
+size_t serialize_lobby_message(GameParameters &parameters, char buffer[], players_map_t &players);
 
 size_t serialize_game_message(GameParameters &parameters, GameState &state, char buffer[]);
 
-void serialize_hello_message(char buffer[], ServerOptions &options);
+// Server messages are appended to a growable buffer, which keeps its memory
+// when cleared, so one buffer can be reused for many messages.
 
-void serialize_accepted_player_message(char buffer[], std::string &name,
-                                       std::string &address, uint8_t id);
+void serialize_hello_message(std::vector<char> &out, ServerOptions &options);
 
-void serialize_game_started_message(char buffer[], players_map_t &players);
+void serialize_accepted_player_message(std::vector<char> &out, Player &player, uint8_t id);
 
-void serialize_turn_message(char buffer[], events_list_t &events, uint16_t turn_nr);
+void serialize_game_started_message(std::vector<char> &out, players_map_t &players);
 
+void serialize_turn_message(std::vector<char> &out, events_list_t &events, uint16_t turn_nr);
+
+void serialize_game_ended_message(std::vector<char> &out, const scores_map_t &scores);
+
+// Serializes the first TURN_HEADER_LENGTH bytes of a turn message
+// (message type, turn number and events count).
+void serialize_turn_header(char buffer[], uint16_t turn_nr, uint32_t events_count);
+
+// Serializes a single turn event, returns its size in bytes.
+size_t serialize_event(char *&dest_ptr, Event &event);
+
+// Returns the size of a serialized event in bytes.
+size_t get_event_len(Event &event);
+
+
+/*
+Compact encoding of server messages, used after both sides agreed on
+CAPABILITY_COMPACT_ENCODING. Hello and AcceptedPlayer are not changed.
+- lengths, turn numbers, bomb ids and scores are LEB128 varints,
+- positions are two varints,
+- position lists are sorted and delta-coded: after the first position
+  comes the x difference and then y difference (if x didn't change)
+  or y itself,
+- player id lists are bit-packed, with player_id_bits(players_count)
+  bits per id, least significant bits first.
+*/
+
+// Returns number of bits needed for a player id in a compact id list.
+uint8_t player_id_bits(uint8_t players_count);
+
+void serialize_compact_game_started_message(std::vector<char> &out, players_map_t &players);
+
+void serialize_compact_turn_header(std::vector<char> &out, uint16_t turn_nr,
+                                   uint32_t events_count);
+
+void serialize_compact_event(std::vector<char> &out, Event &event, uint8_t id_bits);
+
+void serialize_compact_turn_message(std::vector<char> &out, events_list_t &events,
+                                    uint16_t turn_nr, uint8_t id_bits);
+
+void serialize_compact_game_ended_message(std::vector<char> &out, const scores_map_t &scores);
+
+/*
+GameSnapshot message - the current state of the game, sent instead of
+GameStarted and all turns so far to clients which negotiated capabilities:
+type, turn, players map, player positions map, blocks list, bombs map
+(bomb id, position and timer) and scores map, in the encoding agreed
+with the client.
+*/
+void serialize_game_snapshot_message(std::vector<char> &out, GameState &state, bool compact);
+
+// Serializes SessionToken message.
+void serialize_session_token_message(char buffer[], uint64_t token);
 
 #endif //BOMBOWE_ROBOTY_MESSAGE_SERIALIZER_H
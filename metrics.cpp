@@ -0,0 +1,269 @@
+#include <mutex>
+#include <sstream>
+#include "metrics.h"
+
+using boost::asio::ip::tcp;
+
+ServerGauges server_gauges;
+
+const uint64_t TICK_BUCKETS_US[HISTOGRAM_BUCKETS] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000
+};
+
+const uint64_t TURN_EVENTS_BUCKETS[HISTOGRAM_BUCKETS] = {
+    0, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 5000
+};
+
+static const char *CLIENT_MESSAGE_NAMES[CLIENT_MESSAGES_NUMBER] = {
+    "join", "place_bomb", "place_block", "move", "capabilities", "resume"
+};
+
+static const char *SERVER_MESSAGE_NAMES[SERVER_MESSAGES_NUMBER + 1] = {
+    "hello", "accepted_player", "game_started", "turn", "game_ended",
+    "capabilities", "compressed", "session_token", "game_snapshot"
+};
+
+void Histogram::observe(uint64_t value, const uint64_t bounds[HISTOGRAM_BUCKETS]) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (value <= bounds[i]) {
+            add_to_counter(buckets[i]);
+            break;
+        }
+    }
+    add_to_counter(count);
+    add_to_counter(sum, value);
+}
+
+// Helper function - adds a counter of another thread to [dest].
+static void add_counter(std::atomic<uint64_t> &dest, const std::atomic<uint64_t> &src) {
+    add_to_counter(dest, src.load(std::memory_order_relaxed));
+}
+
+static void add_histogram(Histogram &dest, const Histogram &src) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        add_counter(dest.buckets[i], src.buckets[i]);
+    add_counter(dest.count, src.count);
+    add_counter(dest.sum, src.sum);
+}
+
+static void add_metrics(ThreadMetrics &dest, const ThreadMetrics &src) {
+    for (size_t i = 0; i < CLIENT_MESSAGES_NUMBER; i++) {
+        add_counter(dest.messages_in[i], src.messages_in[i]);
+        add_counter(dest.bytes_in[i], src.bytes_in[i]);
+    }
+    for (size_t i = 0; i <= SERVER_MESSAGES_NUMBER; i++) {
+        add_counter(dest.messages_out[i], src.messages_out[i]);
+        add_counter(dest.bytes_out[i], src.bytes_out[i]);
+    }
+    add_counter(dest.decode_errors, src.decode_errors);
+    add_counter(dest.rate_limited_messages, src.rate_limited_messages);
+    add_counter(dest.rate_limit_disconnects, src.rate_limit_disconnects);
+    add_histogram(dest.tick_duration, src.tick_duration);
+    add_histogram(dest.tick_lateness, src.tick_lateness);
+    add_histogram(dest.turn_events, src.turn_events);
+}
+
+// Counters of all running threads and a sum of counters of finished ones.
+static std::mutex registry_mutex;
+static std::vector<ThreadMetrics *> registry;
+static ThreadMetrics finished_threads;
+
+// Registers counters of a thread for its lifetime.
+struct RegisteredMetrics {
+    ThreadMetrics metrics;
+
+    RegisteredMetrics() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(&metrics);
+    }
+
+    ~RegisteredMetrics() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        add_metrics(finished_threads, metrics);
+        std::erase(registry, &metrics);
+    }
+};
+
+ThreadMetrics &thread_metrics() {
+    thread_local RegisteredMetrics registered;
+    return registered.metrics;
+}
+
+void count_sent_message(const char *data, size_t length) {
+    auto type = (uint8_t) data[0];
+    if (type > SERVER_MESSAGES_NUMBER) return;
+
+    ThreadMetrics &metrics = thread_metrics();
+    add_to_counter(metrics.messages_out[type]);
+    add_to_counter(metrics.bytes_out[type], length);
+}
+
+// Helper functions writing metrics in the text format.
+static void write_header(std::ostream &out, const char *name, const char *type,
+                         const char *help) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+static void write_histogram(std::ostream &out, const char *name, const char *help,
+                            const Histogram &histogram, const uint64_t bounds[HISTOGRAM_BUCKETS],
+                            double scale) {
+    write_header(out, name, "histogram", help);
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        cumulative += histogram.buckets[i].load(std::memory_order_relaxed);
+        out << name << "_bucket{le=\"" << (double) bounds[i] * scale << "\"} " << cumulative << "\n";
+    }
+    uint64_t count = histogram.count.load(std::memory_order_relaxed);
+    out << name << "_bucket{le=\"+Inf\"} " << count << "\n";
+    out << name << "_sum " << (double) histogram.sum.load(std::memory_order_relaxed) * scale << "\n";
+    out << name << "_count " << count << "\n";
+}
+
+static void write_per_type(std::ostream &out, const char *name, const char *help,
+                           const std::atomic<uint64_t> counters[], const char *names[],
+                           size_t types) {
+    write_header(out, name, "counter", help);
+    for (size_t i = 0; i < types; i++) {
+        out << name << "{type=\"" << names[i] << "\"} " <<
+            counters[i].load(std::memory_order_relaxed) << "\n";
+    }
+}
+
+static void write_gauge(std::ostream &out, const char *name, const char *help,
+                        const std::atomic<int64_t> &gauge) {
+    write_header(out, name, "gauge", help);
+    out << name << " " << gauge.load(std::memory_order_relaxed) << "\n";
+}
+
+std::string metrics_text() {
+    ThreadMetrics total;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        add_metrics(total, finished_threads);
+        for (auto metrics : registry)
+            add_metrics(total, *metrics);
+    }
+
+    std::ostringstream out;
+    write_histogram(out, "robots_tick_duration_seconds", "Time of playing and sending a turn.",
+                    total.tick_duration, TICK_BUCKETS_US, 1e-6);
+    write_histogram(out, "robots_tick_lateness_seconds", "Delay of a turn after its planned time.",
+                    total.tick_lateness, TICK_BUCKETS_US, 1e-6);
+    write_histogram(out, "robots_turn_events", "Events in a turn.",
+                    total.turn_events, TURN_EVENTS_BUCKETS, 1);
+    write_per_type(out, "robots_received_messages_total", "Messages received from clients.",
+                   total.messages_in, CLIENT_MESSAGE_NAMES, CLIENT_MESSAGES_NUMBER);
+    write_per_type(out, "robots_received_bytes_total", "Bytes of messages received from clients.",
+                   total.bytes_in, CLIENT_MESSAGE_NAMES, CLIENT_MESSAGES_NUMBER);
+    write_per_type(out, "robots_sent_messages_total", "Messages sent to clients.",
+                   total.messages_out, SERVER_MESSAGE_NAMES, SERVER_MESSAGES_NUMBER + 1);
+    write_per_type(out, "robots_sent_bytes_total", "Bytes of messages sent to clients.",
+                   total.bytes_out, SERVER_MESSAGE_NAMES, SERVER_MESSAGES_NUMBER + 1);
+    write_header(out, "robots_decode_errors_total", "counter", "Incorrect messages from clients.");
+    out << "robots_decode_errors_total " << total.decode_errors.load() << "\n";
+    write_header(out, "robots_rate_limited_messages_total", "counter",
+                 "Messages from clients dropped for exceeding rate limits.");
+    out << "robots_rate_limited_messages_total " << total.rate_limited_messages.load() << "\n";
+    write_header(out, "robots_rate_limit_disconnects_total", "counter",
+                 "Clients disconnected for exceeding rate limits.");
+    out << "robots_rate_limit_disconnects_total " << total.rate_limit_disconnects.load() << "\n";
+    write_gauge(out, "robots_connections", "Client connections.", server_gauges.connections);
+    write_gauge(out, "robots_sessions", "Connected clients registered in rooms.", server_gauges.sessions);
+    write_gauge(out, "robots_rooms", "Game rooms.", server_gauges.rooms);
+    write_gauge(out, "robots_pending_actions", "Players' actions taken by the last turn.",
+                server_gauges.pending_actions);
+    write_gauge(out, "robots_outgoing_batch_messages", "Messages in the last batch sent to clients.",
+                server_gauges.outgoing_batch);
+    return out.str();
+}
+
+// A client has this much time to send its request, so that
+// idle connections don't stay open forever.
+static const auto METRICS_REQUEST_TIMEOUT = std::chrono::seconds(1);
+
+namespace {
+
+// A single connection to the metrics endpoint. Connections are handled
+// asynchronously, so a slow client doesn't block the others.
+struct MetricsConnection : std::enable_shared_from_this<MetricsConnection> {
+    tcp::socket socket;
+    boost::asio::steady_timer deadline;
+    boost::asio::streambuf request{8192};
+    std::string response;
+
+    explicit MetricsConnection(tcp::socket socket)
+        : socket(std::move(socket)), deadline(this->socket.get_executor()) {}
+
+    void start() {
+        auto self = shared_from_this();
+        deadline.expires_after(METRICS_REQUEST_TIMEOUT);
+        deadline.async_wait([self](const boost::system::error_code &ec) {
+            if (ec) return; // cancelled after the response was sent
+            boost::system::error_code ignored;
+            self->socket.close(ignored);
+        });
+        boost::asio::async_read_until(socket, request, "\r\n\r\n",
+            [self](const boost::system::error_code &ec, size_t) {
+                if (ec) {
+                    self->deadline.cancel();
+                    return;
+                }
+                self->respond();
+            });
+    }
+
+    // Answers the request with metrics for GET /metrics and with 404 for anything else.
+    void respond() {
+        std::istream request_stream(&request);
+        std::string method, path;
+        request_stream >> method >> path;
+
+        if (method == "GET" && (path == "/metrics" || path == "/")) {
+            std::string body = metrics_text();
+            response = "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                       "Connection: close\r\n\r\n" + body;
+        }
+        else {
+            response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        }
+
+        // the deadline keeps running - a client that doesn't read the response is closed too
+        auto self = shared_from_this();
+        boost::asio::async_write(socket, boost::asio::buffer(response),
+            [self](const boost::system::error_code &, size_t) {
+                self->deadline.cancel();
+                boost::system::error_code ignored;
+                self->socket.shutdown(tcp::socket::shutdown_both, ignored);
+                self->socket.close(ignored);
+            });
+    }
+};
+
+} // namespace
+
+static void accept_metrics_connection(tcp::acceptor &acceptor) {
+    acceptor.async_accept([&acceptor](const boost::system::error_code &ec, tcp::socket socket) {
+        if (!ec)
+            std::make_shared<MetricsConnection>(std::move(socket))->start();
+        else if (debug)
+            std::cerr << "metrics accept: " << ec.message() << "\n";
+        accept_metrics_connection(acceptor);
+    });
+}
+
+void serve_metrics(boost::asio::io_context &io_context, tcp::acceptor &acceptor) {
+    accept_metrics_connection(acceptor);
+    while (true) {
+        try {
+            io_context.run();
+        }
+        catch (std::exception &e) {
+            if (debug) std::cerr << "metrics: " << e.what() << "\n";
+        }
+        io_context.restart();
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef BOMBOWE_ROBOTY_METRICS_H
+#define BOMBOWE_ROBOTY_METRICS_H
+
+#include <atomic>
+#include "definitions.h"
+
+/*
+Server metrics in Prometheus text format, served over plain HTTP.
+Counters are kept per thread - every thread updates only its own block
+with relaxed loads and stores, without locks or atomic read-modify-write.
+Blocks are summed up only when the metrics are scraped; counters of
+finished threads are added to a common block when the thread exits.
+*/
+
+#define HISTOGRAM_BUCKETS 12
+
+// A histogram with HISTOGRAM_BUCKETS upper bounds given when observing,
+// values above the last bound are counted only in the total count.
+struct Histogram {
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS]{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+
+    void observe(uint64_t value, const uint64_t bounds[HISTOGRAM_BUCKETS]);
+};
+
+// Counters of a single thread.
+struct ThreadMetrics {
+    std::atomic<uint64_t> messages_in[CLIENT_MESSAGES_NUMBER]{};
+    std::atomic<uint64_t> bytes_in[CLIENT_MESSAGES_NUMBER]{};
+    // SERVER_MESSAGES_NUMBER is the last server message type
+    std::atomic<uint64_t> messages_out[SERVER_MESSAGES_NUMBER + 1]{};
+    std::atomic<uint64_t> bytes_out[SERVER_MESSAGES_NUMBER + 1]{};
+    std::atomic<uint64_t> decode_errors{0};
+    std::atomic<uint64_t> rate_limited_messages{0}; // dropped
+    std::atomic<uint64_t> rate_limit_disconnects{0};
+    Histogram tick_duration; // microseconds
+    Histogram tick_lateness; // microseconds
+    Histogram turn_events;
+};
+
+// Current values, set by the thread owning them.
+struct ServerGauges {
+    std::atomic<int64_t> connections{0}; // including clients not in a room yet
+    std::atomic<int64_t> sessions{0};
+    std::atomic<int64_t> rooms{0};
+    std::atomic<int64_t> pending_actions{0}; // actions taken by the last turn
+    std::atomic<int64_t> outgoing_batch{0}; // messages in the last sent batch
+};
+
+extern ServerGauges server_gauges;
+
+extern const uint64_t TICK_BUCKETS_US[HISTOGRAM_BUCKETS];
+extern const uint64_t TURN_EVENTS_BUCKETS[HISTOGRAM_BUCKETS];
+
+// Returns counters of the calling thread, registering them on the first call.
+ThreadMetrics &thread_metrics();
+
+// Adds [value] to a counter owned by the calling thread.
+inline void add_to_counter(std::atomic<uint64_t> &counter, uint64_t value = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Counts a message sent to a client, by its first byte.
+void count_sent_message(const char *data, size_t length);
+
+// Returns all metrics in Prometheus text format.
+std::string metrics_text();
+
+// Serves metrics over HTTP by running [io_context], which should be used
+// only by [acceptor]. Requests not sent within a second are dropped.
+// Never returns, meant to be run by a separate thread.
+[[noreturn]] void serve_metrics(boost::asio::io_context &io_context,
+                                boost::asio::ip::tcp::acceptor &acceptor);
+
+#endif //BOMBOWE_ROBOTY_METRICS_H
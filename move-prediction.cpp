@@ -0,0 +1,96 @@
+#include "move-prediction.h"
+
+// Prefix of IPv4 addresses seen by a server listening on IPv6.
+#define IPV4_MAPPED_PREFIX "::ffff:"
+
+// This function returns an address without the IPv4-mapped IPv6 prefix.
+static std::string_view plain_address(std::string_view address) {
+    std::string_view view(address);
+    if (view.starts_with(IPV4_MAPPED_PREFIX)) view.remove_prefix(strlen(IPV4_MAPPED_PREFIX));
+    return view;
+}
+
+void find_own_player(MovePrediction &prediction, const players_map_t &players,
+                     const std::string &name, const std::string &address) {
+    clear_prediction(prediction);
+    if (!prediction.enabled) return;
+
+    std::optional<PlayerId> by_name, by_address;
+    for (auto &player : players) {
+        if (player.second.name.view() != name) continue;
+        if (!by_name.has_value()) by_name = player.first;
+        if (!by_address.has_value() &&
+            plain_address(player.second.address.view()) == plain_address(address))
+            by_address = player.first;
+    }
+    prediction.own_id = by_address.has_value() ? by_address : by_name;
+}
+
+void clear_prediction(MovePrediction &prediction) {
+    prediction.own_id.reset();
+    prediction.pending.clear();
+}
+
+bool add_pending_move(MovePrediction &prediction, GameState &state, uint8_t direction) {
+    if (!prediction.own_id.has_value()) return false;
+
+    if (!prediction.pending.empty() && prediction.pending.back().turn == state.turn)
+        prediction.pending.back().direction = direction;
+    else
+        prediction.pending.push_back({state.turn, direction});
+    return true;
+}
+
+bool cancel_pending_move(MovePrediction &prediction, GameState &state) {
+    if (prediction.pending.empty() || prediction.pending.back().turn != state.turn) return false;
+    prediction.pending.pop_back();
+    return true;
+}
+
+std::optional<OwnRobot> get_own_robot(MovePrediction &prediction, GameState &state) {
+    if (!prediction.own_id.has_value()) return {};
+
+    auto position_it = state.player_positions.find(*prediction.own_id);
+    auto score_it = state.scores.find(*prediction.own_id);
+    if (position_it == state.player_positions.end() || score_it == state.scores.end()) return {};
+    return OwnRobot{position_it->second, score_it->second};
+}
+
+void reconcile_moves(MovePrediction &prediction, GameState &state, const OwnRobot &before) {
+    std::optional<OwnRobot> after = get_own_robot(prediction, state);
+    if (!after.has_value()) return;
+
+    bool moved = after->position.x != before.position.x || after->position.y != before.position.y;
+    bool destroyed = after->score != before.score;
+
+    // moves sent before the previous Turn had time to reach the server
+    int acknowledged = moved || destroyed ? state.turn : state.turn - 1;
+    while (!prediction.pending.empty() && prediction.pending.front().turn < acknowledged)
+        prediction.pending.pop_front();
+}
+
+// This function moves a robot in a given direction, if the target field is
+// on the board and there is no block on it - like the server does.
+static void predict_step(Position &position, uint8_t direction, GameState &state,
+                         GameParameters &params) {
+    int x = position.x, y = position.y;
+    switch ((Direction) direction) {
+        case Up: y++; break;
+        case Right: x++; break;
+        case Down: y--; break;
+        case Left: x--; break;
+    }
+
+    if (x < 0 || y < 0 || x >= params.size_x || y >= params.size_y) return;
+    Position target((uint16_t) x, (uint16_t) y);
+    if (state.blocks.find(target) != state.blocks.end()) return;
+    position = target;
+}
+
+Position predicted_position(MovePrediction &prediction, GameState &state,
+                            GameParameters &params) {
+    Position position = state.player_positions.at(*prediction.own_id);
+    for (auto &move : prediction.pending)
+        predict_step(position, move.direction, state, params);
+    return position;
+}
@@ -0,0 +1,54 @@
+#ifndef BOMBOWE_ROBOTY_MOVE_PREDICTION_H
+#define BOMBOWE_ROBOTY_MOVE_PREDICTION_H
+
+#include "definitions.h"
+
+/*
+Client-side prediction of the player's own moves. A Move from gui is sent
+to the server and recorded as pending, and gui gets the game state with the
+player's robot where its pending moves take it, without waiting for a Turn.
+The server applies the last action of a player in a turn, so a move replaces
+a pending one sent after the same Turn and placing a bomb or a block cancels it.
+A move sent after Turn t-1 is expected in Turn t. If the robot moved or was
+destroyed in Turn t, moves sent before it are acknowledged; otherwise the
+last of them may have reached the server too late and stays pending until
+Turn t+1. Pending moves are replayed from the position sent by the server,
+so there are at most two of them and the server's state isn't changed: a frame
+for gui with a predicted position is a copy of the state sharing its containers,
+only the player positions are copied.
+*/
+
+// The player's robot before a Turn is applied.
+struct OwnRobot {
+    Position position;
+    Score score;
+};
+
+// This function finds the player's robot among players of a new game - the player
+// with the client's name and, if a few players have it, the client's
+// (address):(port), as seen by the server.
+void find_own_player(MovePrediction &prediction, const players_map_t &players,
+                     const std::string &name, const std::string &address);
+
+// This function forgets the player's robot and its pending moves.
+void clear_prediction(MovePrediction &prediction);
+
+// This function records a move sent to the server after the last Turn.
+// Returns false if the client doesn't play in the game.
+bool add_pending_move(MovePrediction &prediction, GameState &state, uint8_t direction);
+
+// This function drops the move sent after the last Turn, replaced by another action.
+// Returns false if there is no such move.
+bool cancel_pending_move(MovePrediction &prediction, GameState &state);
+
+// This function returns the player's robot before a Turn is applied to [state].
+std::optional<OwnRobot> get_own_robot(MovePrediction &prediction, GameState &state);
+
+// This function drops pending moves acknowledged by a Turn applied to [state].
+void reconcile_moves(MovePrediction &prediction, GameState &state, const OwnRobot &before);
+
+// This function returns the position of the player's robot after its pending moves.
+Position predicted_position(MovePrediction &prediction, GameState &state,
+                            GameParameters &params);
+
+#endif //BOMBOWE_ROBOTY_MOVE_PREDICTION_H
@@ -58,11 +58,27 @@ bool check_client_options(ClientOptions &options, int argc, char *argv[]) {
             ("help,h", "produce help msg_buffer")
             ("gui-address,d", p_options::value<std::string>(&options.gui_address),
              "<(host name):(port) lub (IPv4):(port) lub (IPv6):(port)>")
+            ("mirror-address", p_options::value<std::vector<std::string>>(&options.mirror_addresses),
+             "also send messages for gui to this address, can be given many times")
+            ("gui-shm", p_options::value<std::string>(&options.gui_shm),
+             "pass messages to gui on this host through a shared memory segment with this name")
             ("player-name,n", p_options::value<std::string>(&options.player_name),
              "player name")
             ("port,p", p_options::value<uint16_t>(&options.port), "port")
             ("server-address,s", p_options::value<std::string>(&options.server_address),
-             "server address");
+             "server address")
+            ("compact-encoding", p_options::bool_switch(&options.compact_encoding),
+             "ask the server for compact encoding of messages")
+            ("compression", p_options::bool_switch(&options.compression),
+             "ask the server for compression of large messages")
+            ("reconnect", p_options::bool_switch(&options.reconnect),
+             "reconnect to the server and resume the game after losing connection")
+            ("connect-timeout", p_options::value<uint64_t>(&options.connect_timeout),
+             "give up connecting to the server after this many milliseconds (default 10000)")
+            ("predict-moves", p_options::bool_switch(&options.predict_moves),
+             "show own moves to gui at once, before the server confirms them")
+            ("trace-file", p_options::value<std::string>(&options.trace_file),
+             "write binary trace records to this file, robots-trace decodes it");
 
     p_options::variables_map options_map;
     p_options::store(p_options::parse_command_line(argc, argv, desc), options_map);
@@ -85,13 +101,17 @@ bool check_client_options(ClientOptions &options, int argc, char *argv[]) {
 bool check_server_options(ServerOptions &options, int argc, char *argv[]) {
     //handling options using boost::program_options
 
+    // uint8_t would be parsed as a single character
+    uint16_t players_count = 0;
+    uint16_t instance = 0;
+
     p_options::options_description desc("Allowed options");
     desc.add_options()
             ("help,h", "produce help msg_buffer")
             ("port,p", p_options::value<uint16_t>(&options.port), "port")
             ("bomb-timer,b", p_options::value<uint16_t>(&options.bomb_timer),
              "bomb timer")
-            ("players-count,c", p_options::value<uint8_t>(&options.players_count),
+            ("players-count,c", p_options::value<uint16_t>(&players_count),
              "players count")
             ("turn-duration,d", p_options::value<uint64_t>(&options.turn_duration),
              "turn duration")
@@ -108,7 +128,42 @@ bool check_server_options(ServerOptions &options, int argc, char *argv[]) {
             ("size-y,y", p_options::value<uint16_t>(&options.size_y),
              "board size y")
             ("server-name,n", p_options::value<std::string>(&options.server_name),
-             "server name");
+             "server name")
+            ("interest-radius,r", p_options::value<uint16_t>(&options.interest_radius),
+             "send clients only events within this distance (0 - all events)")
+            ("backend", p_options::value<std::string>(&options.backend),
+             "networking backend: asio (default) or io_uring")
+            ("compact-encoding", p_options::bool_switch(&options.compact_encoding),
+             "allow clients to use compact encoding of messages")
+            ("compression", p_options::bool_switch(&options.compression),
+             "allow clients to receive compressed messages")
+            ("compression-threshold", p_options::value<uint32_t>(&options.compression_threshold),
+             "compress messages longer than this many bytes (default 1024)")
+            ("leaderboard", p_options::value<std::string>(&options.leaderboard),
+             "keep players' statistics in this file")
+            ("export-file", p_options::value<std::string>(&options.export_file),
+             "write events of all games to this file in columnar format, robots-events reads it")
+            ("checkpoint-file", p_options::value<std::string>(&options.checkpoint_file),
+             "checkpoint games in progress to this file and resume them after a restart")
+            ("checkpoint-interval", p_options::value<uint16_t>(&options.checkpoint_interval),
+             "checkpoint games every this many turns (default 10)")
+            ("metrics-port", p_options::value<uint16_t>(&options.metrics_port),
+             "serve Prometheus metrics on this port of 127.0.0.1 (0 - disabled)")
+            ("rate-limit-messages", p_options::value<uint32_t>(&options.rate_limit_messages),
+             "drop messages of a client over this many a second (0 - unlimited)")
+            ("rate-limit-bytes", p_options::value<uint32_t>(&options.rate_limit_bytes),
+             "drop messages of a client over this many bytes a second (0 - unlimited)")
+            ("accept-threads", p_options::value<uint16_t>(&options.accept_threads),
+             "number of threads accepting connections on SO_REUSEPORT sockets (default 1)")
+            ("gateway-control", p_options::value<std::string>(&options.gateway_control),
+             "report load to robots-gateway listening on this Unix socket")
+            ("instance", p_options::value<uint16_t>(&instance),
+             "number of this server behind a gateway, carried in session tokens (default 0)")
+            ("lobby-timeout", p_options::value<uint64_t>(&options.lobby_timeout),
+             "start a room's game with fewer players this many milliseconds "
+             "after the first one joined (0 - wait for a full room)")
+            ("trace-file", p_options::value<std::string>(&options.trace_file),
+             "write binary trace records to this file, robots-trace decodes it");
 
     p_options::variables_map options_map;
     p_options::store(p_options::parse_command_line(argc, argv, desc), options_map);
@@ -130,5 +185,227 @@ bool check_server_options(ServerOptions &options, int argc, char *argv[]) {
     all_options_provided &= check_if_option_provided(options_map, "size-x");
     all_options_provided &= check_if_option_provided(options_map, "size-y");
 
+    if (players_count == 0 || players_count > UINT8_MAX) {
+        std::cerr << "players-count has to be between 1 and " << UINT8_MAX << "\n";
+        return false;
+    }
+    options.players_count = (uint8_t) players_count;
+
+    if (instance > UINT8_MAX) {
+        std::cerr << "instance has to be at most " << UINT8_MAX << "\n";
+        return false;
+    }
+    options.instance = (uint8_t) instance;
+
+    if (options.accept_threads == 0) {
+        std::cerr << "accept-threads has to be positive\n";
+        return false;
+    }
+
+    // the longest message, Join, has to fit into the bucket
+    if (options.rate_limit_bytes != 0 && options.rate_limit_bytes < 2 + UINT8_MAX) {
+        std::cerr << "rate-limit-bytes has to be 0 or at least " << 2 + UINT8_MAX << "\n";
+        return false;
+    }
+
+    if (options.checkpoint_interval == 0) {
+        std::cerr << "checkpoint-interval has to be positive\n";
+        return false;
+    }
+
+    return all_options_provided;
+}
+
+bool check_loadgen_options(LoadgenOptions &options, int argc, char *argv[]) {
+    //handling options using boost::program_options
+
+    p_options::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help msg_buffer")
+            ("server-address,s", p_options::value<std::string>(&options.server_address),
+             "server address")
+            ("sessions,n", p_options::value<uint32_t>(&options.sessions),
+             "number of connections")
+            ("players,c", p_options::value<uint32_t>(&options.players),
+             "number of connections joining the game")
+            ("duration,t", p_options::value<uint32_t>(&options.duration),
+             "test duration in seconds")
+            ("move-interval,m", p_options::value<uint32_t>(&options.move_interval),
+             "interval between players' moves in milliseconds")
+            ("connect-only", p_options::bool_switch(&options.connect_only),
+             "only connect, wait for Hello and disconnect again, report connections per second");
+
+    p_options::variables_map options_map;
+    p_options::store(p_options::parse_command_line(argc, argv, desc), options_map);
+    p_options::notify(options_map);
+
+    if (options_map.count("help")) {
+        std::cout << desc << "\n";
+        exit(EXIT_SUCCESS);
+    }
+
+    return check_if_option_provided(options_map, "server-address");
+}
+
+bool check_leaderboard_options(LeaderboardOptions &options, int argc, char *argv[]) {
+    //handling options using boost::program_options
+
+    p_options::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help msg_buffer")
+            ("file,f", p_options::value<std::string>(&options.file),
+             "leaderboard file")
+            ("top,t", p_options::value<uint32_t>(&options.top),
+             "number of players to print (default 10)");
+
+    p_options::variables_map options_map;
+    p_options::store(p_options::parse_command_line(argc, argv, desc), options_map);
+    p_options::notify(options_map);
+
+    if (options_map.count("help")) {
+        std::cout << desc << "\n";
+        exit(EXIT_SUCCESS);
+    }
+
+    return check_if_option_provided(options_map, "file");
+}
+
+bool check_trace_options(TraceOptions &options, int argc, char *argv[]) {
+    //handling options using boost::program_options
+
+    p_options::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help msg_buffer")
+            ("file,f", p_options::value<std::string>(&options.file),
+             "trace file");
+
+    p_options::variables_map options_map;
+    p_options::store(p_options::parse_command_line(argc, argv, desc), options_map);
+    p_options::notify(options_map);
+
+    if (options_map.count("help")) {
+        std::cout << desc << "\n";
+        exit(EXIT_SUCCESS);
+    }
+
+    return check_if_option_provided(options_map, "file");
+}
+
+bool check_events_options(EventsOptions &options, int argc, char *argv[]) {
+    //handling options using boost::program_options
+
+    p_options::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help msg_buffer")
+            ("file,f", p_options::value<std::string>(&options.file),
+             "export file")
+            ("columns,c", p_options::value<std::string>(&options.columns),
+             "comma-separated columns to print (default game,turn,type,player,bomb,x,y)")
+            ("count", p_options::bool_switch(&options.count),
+             "print only the number of events");
+
+    p_options::variables_map options_map;
+    p_options::store(p_options::parse_command_line(argc, argv, desc), options_map);
+    p_options::notify(options_map);
+
+    if (options_map.count("help")) {
+        std::cout << desc << "\n";
+        exit(EXIT_SUCCESS);
+    }
+
+    return check_if_option_provided(options_map, "file");
+}
+
+bool check_sim_options(SimOptions &options, int argc, char *argv[]) {
+    //handling options using boost::program_options
+
+    // uint8_t would be parsed as a single character
+    uint16_t players_count = 0;
+    ServerOptions &game = options.game;
+
+    p_options::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help msg_buffer")
+            ("bomb-timer,b", p_options::value<uint16_t>(&game.bomb_timer),
+             "bomb timer")
+            ("players-count,c", p_options::value<uint16_t>(&players_count),
+             "players count")
+            ("explosion-radius,e", p_options::value<uint16_t>(&game.explosion_radius),
+             "explosion radius")
+            ("initial-blocks,k", p_options::value<uint16_t>(&game.initial_blocks),
+             "initial blocks")
+            ("game-length,l", p_options::value<uint16_t>(&game.game_length),
+             "game length")
+            ("seed,s", p_options::value<uint32_t>(&game.seed),
+             "seed of the first game, every next game uses the next one")
+            ("size-x,x", p_options::value<uint16_t>(&game.size_x),
+             "board size x")
+            ("size-y,y", p_options::value<uint16_t>(&game.size_y),
+             "board size y")
+            ("games,g", p_options::value<uint32_t>(&options.games),
+             "number of games (default 1000)")
+            ("threads,j", p_options::value<uint16_t>(&options.threads),
+             "number of threads (default - one per core)")
+            ("bot", p_options::value<std::string>(&options.bot),
+             "bots' behaviour: random (default) or bomber")
+            ("csv", p_options::bool_switch(&options.csv),
+             "print statistics as a CSV header and row")
+            ("export-file", p_options::value<std::string>(&options.export_file),
+             "write events of all games to this file in columnar format, robots-events reads it");
+
+    p_options::variables_map options_map;
+    p_options::store(p_options::parse_command_line(argc, argv, desc), options_map);
+    p_options::notify(options_map);
+
+    if (options_map.count("help")) {
+        std::cout << desc << "\n";
+        exit(EXIT_SUCCESS);
+    }
+
+    bool all_options_provided = true;
+    all_options_provided &= check_if_option_provided(options_map, "bomb-timer");
+    all_options_provided &= check_if_option_provided(options_map, "players-count");
+    all_options_provided &= check_if_option_provided(options_map, "explosion-radius");
+    all_options_provided &= check_if_option_provided(options_map, "initial-blocks");
+    all_options_provided &= check_if_option_provided(options_map, "game-length");
+    all_options_provided &= check_if_option_provided(options_map, "size-x");
+    all_options_provided &= check_if_option_provided(options_map, "size-y");
+
+    if (players_count == 0 || players_count > UINT8_MAX) {
+        std::cerr << "players-count has to be between 1 and " << UINT8_MAX << "\n";
+        return false;
+    }
+    game.players_count = (uint8_t) players_count;
+
+    if (options.bot != "random" && options.bot != "bomber") {
+        std::cerr << "bot has to be random or bomber\n";
+        return false;
+    }
+
+    return all_options_provided;
+}
+
+bool check_gateway_options(GatewayOptions &options, int argc, char *argv[]) {
+    //handling options using boost::program_options
+
+    p_options::options_description desc("Allowed options");
+    desc.add_options()
+            ("help,h", "produce help msg_buffer")
+            ("port,p", p_options::value<uint16_t>(&options.port), "port")
+            ("control,c", p_options::value<std::string>(&options.control),
+             "Unix socket which servers started with --gateway-control report to");
+
+    p_options::variables_map options_map;
+    p_options::store(p_options::parse_command_line(argc, argv, desc), options_map);
+    p_options::notify(options_map);
+
+    if (options_map.count("help")) {
+        std::cout << desc << "\n";
+        exit(EXIT_SUCCESS);
+    }
+
+    bool all_options_provided = true;
+    all_options_provided &= check_if_option_provided(options_map, "port");
+    all_options_provided &= check_if_option_provided(options_map, "control");
     return all_options_provided;
 }
@@ -3,6 +3,7 @@
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <boost/program_options.hpp>
 
 #define COLON ':'
@@ -12,9 +13,17 @@ namespace p_options = boost::program_options;
 // A structure for program options.
 struct ClientOptions {
     std::string gui_address;
+    std::vector<std::string> mirror_addresses; // optional
+    std::string gui_shm; // optional, name of a shared memory segment
     std::string player_name;
     uint16_t port;
     std::string server_address;
+    bool compact_encoding = false; // optional
+    bool compression = false; // optional
+    bool reconnect = false; // optional
+    uint64_t connect_timeout = 10000; // optional, in milliseconds
+    bool predict_moves = false; // optional
+    std::string trace_file; // optional
 };
 
 struct ServerOptions {
@@ -29,6 +38,61 @@ struct ServerOptions {
     uint32_t seed; // optional
     uint16_t size_x;
     uint16_t size_y;
+    uint16_t interest_radius = 0; // optional, 0 - every client gets every event
+    std::string backend = "asio"; // optional
+    bool compact_encoding = false; // optional
+    bool compression = false; // optional
+    uint32_t compression_threshold = 1024; // optional, in bytes
+    std::string leaderboard; // optional, leaderboard file path
+    std::string export_file; // optional, columnar export of events
+    std::string checkpoint_file; // optional, checkpoints of games in progress
+    uint16_t checkpoint_interval = 10; // optional, in turns
+    uint16_t metrics_port = 0; // optional, 0 - no metrics
+    uint32_t rate_limit_messages = 0; // optional, per client a second, 0 - unlimited
+    uint32_t rate_limit_bytes = 0; // optional, per client a second, 0 - unlimited
+    uint16_t accept_threads = 1; // optional
+    std::string gateway_control; // optional, socket of robots-gateway to report to
+    uint8_t instance = 0; // optional, distinguishes servers behind a gateway
+    uint64_t lobby_timeout = 0; // optional, in milliseconds, 0 - wait for a full room
+    std::string trace_file; // optional
+};
+
+struct LoadgenOptions {
+    std::string server_address;
+    uint32_t sessions = 100;
+    uint32_t players = 0;
+    uint32_t duration = 10; // seconds
+    uint32_t move_interval = 0; // milliseconds, 0 - players don't move
+    bool connect_only = false; // measure connections per second
+};
+
+struct LeaderboardOptions {
+    std::string file;
+    uint32_t top = 10;
+};
+
+struct TraceOptions {
+    std::string file;
+};
+
+struct GatewayOptions {
+    uint16_t port;
+    std::string control; // the Unix socket servers report to
+};
+
+struct EventsOptions {
+    std::string file;
+    std::string columns = "game,turn,type,player,bomb,x,y";
+    bool count = false;
+};
+
+struct SimOptions {
+    ServerOptions game; // only the game rules are used
+    uint32_t games = 1000;
+    uint16_t threads = 0; // 0 - one per core
+    std::string bot = "random";
+    bool csv = false;
+    std::string export_file; // optional, columnar export of events
 };
 
 // This function checks options correctness.
@@ -39,6 +103,18 @@ void get_hostname_and_port(std::string &address, std::string &hostname, std::str
 
 bool check_server_options(ServerOptions &options, int argc, char *argv[]);
 
+bool check_loadgen_options(LoadgenOptions &options, int argc, char *argv[]);
+
+bool check_leaderboard_options(LeaderboardOptions &options, int argc, char *argv[]);
+
+bool check_trace_options(TraceOptions &options, int argc, char *argv[]);
+
+bool check_events_options(EventsOptions &options, int argc, char *argv[]);
+
+bool check_sim_options(SimOptions &options, int argc, char *argv[]);
+
+bool check_gateway_options(GatewayOptions &options, int argc, char *argv[]);
+
 #define BOMBOWE_ROBOTY_OPTIONS_PARSER_H
 
 #endif //BOMBOWE_ROBOTY_OPTIONS_PARSER_H
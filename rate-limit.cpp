@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <cmath>
+#include "rate-limit.h"
+
+void TokenBucket::refill(std::chrono::steady_clock::time_point now) {
+    if (rate == 0) return;
+    // a second refills the whole bucket, so longer gaps don't need to overflow
+    auto elapsed = (uint64_t) std::clamp<int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_refill).count(),
+            0, (int64_t) SCALE);
+    nanotokens = std::min(nanotokens + elapsed * rate, rate * SCALE);
+    last_refill = now;
+}
+
+void RateLimiter::refill(std::chrono::steady_clock::time_point now) {
+    messages.refill(now);
+    bytes.refill(now);
+
+    if (violations == 0) {
+        last_decay = now;
+        return;
+    }
+    double elapsed = std::chrono::duration<double>(now - last_decay).count();
+    if (elapsed <= 0) return;
+    violations *= std::exp2(-elapsed / RATE_LIMIT_HALF_LIFE);
+    if (violations < 1e-3) violations = 0;
+    last_decay = now;
+}
+
+bool RateLimiter::allow(size_t length) {
+    if (!messages.has(1) || !bytes.has(length)) {
+        violations++;
+        return false;
+    }
+    messages.take(1);
+    bytes.take(length);
+    return true;
+}
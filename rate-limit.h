@@ -0,0 +1,70 @@
+#ifndef BOMBOWE_ROBOTY_RATE_LIMIT_H
+#define BOMBOWE_ROBOTY_RATE_LIMIT_H
+
+#include <chrono>
+#include <cstdint>
+
+/*
+Per-session limits of messages and bytes received from a client. Each limit
+is a token bucket filled at its rate a second and holding at most a second's
+worth, so a client may send a burst after being quiet. Buckets are refilled
+once for every chunk read from the socket and a message takes its tokens
+before its contents are parsed, so messages over the limits are skipped
+without allocating. Every dropped message adds to a violation score of the client,
+which halves every RATE_LIMIT_HALF_LIFE seconds; a client whose score reaches
+RATE_LIMIT_MAX_DROPS is disconnected, also if some of its messages get through.
+Tokens are counted in billionths, so a bucket needs only integer arithmetic.
+*/
+
+// Violation score after which a client is disconnected - dropped messages
+// in a burst, or in a few seconds of sending steadily over the limits.
+#define RATE_LIMIT_MAX_DROPS 256
+#define RATE_LIMIT_HALF_LIFE 5.0 // seconds
+
+class TokenBucket {
+private:
+    static constexpr uint64_t SCALE = 1'000'000'000; // nanotokens in a token
+
+    uint64_t rate; // tokens a second, 0 - unlimited
+    uint64_t nanotokens;
+    std::chrono::steady_clock::time_point last_refill;
+
+public:
+    TokenBucket(uint32_t rate, std::chrono::steady_clock::time_point now):
+            rate(rate), nanotokens(rate * SCALE), last_refill(now) {}
+
+    void refill(std::chrono::steady_clock::time_point now);
+
+    [[nodiscard]] bool has(uint64_t tokens) const {
+        return rate == 0 || nanotokens >= tokens * SCALE;
+    }
+    void take(uint64_t tokens) {
+        if (rate != 0) nanotokens -= tokens * SCALE;
+    }
+};
+
+class RateLimiter {
+private:
+    TokenBucket messages;
+    TokenBucket bytes;
+    double violations = 0; // decaying count of dropped messages
+    std::chrono::steady_clock::time_point last_decay;
+
+public:
+    RateLimiter(uint32_t messages_rate, uint32_t bytes_rate,
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()):
+            messages(messages_rate, now), bytes(bytes_rate, now), last_decay(now) {}
+
+    // Refills both buckets and decays the violation score,
+    // called after reading from the socket.
+    void refill(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    // Takes tokens for a message of [length] bytes. Returns false
+    // if the message is over the limits and has to be dropped.
+    bool allow(size_t length);
+
+    // Returns true if the client keeps sending over the limits.
+    [[nodiscard]] bool exhausted() const { return violations >= RATE_LIMIT_MAX_DROPS; }
+};
+
+#endif //BOMBOWE_ROBOTY_RATE_LIMIT_H
@@ -1,9 +1,14 @@
 #include <thread>
+#include <sys/socket.h>
 #include <boost/asio.hpp>
 #include "options-parser.h"
 #include "definitions.h"
 #include "message-serializer.h"
 #include "game-handler.h"
+#include "move-prediction.h"
+#include "gui-shm.h"
+#include "lz4-codec.h"
+#include "trace.h"
 
 // Global variable defining current state.
 // In addition to Game and Lobby, I defined SendJoin state which
@@ -26,6 +31,21 @@ static void set_state(State state) {
     curr_state_mutex.unlock();
 }
 
+// This function sends a message to the server. The socket may be
+// replaced by the thread receiving from the server, so it is locked.
+// While reconnecting, messages which can't be sent are dropped.
+void send_to_server(ConnectionsData &connections, const char *message, size_t message_size) {
+    boost::system::error_code ec;
+    {
+        std::lock_guard<std::mutex> lock(connections.server_mutex);
+        boost::asio::write(connections.server_socket,
+                           boost::asio::buffer(message, message_size), ec);
+    }
+
+    if (ec && !connections.reconnect) throw boost::system::system_error(ec);
+    trace<TRACE_IO>(TraceEvent::SentToServer, message_size, ec ? 1 : 0);
+}
+
 // This function sends join request with a given player name to the server.
 void send_join_request(ConnectionsData &connections) {
     std::string name = connections.player_name;
@@ -42,45 +62,117 @@ void send_join_request(ConnectionsData &connections) {
 
     memcpy(msg_ptr, name.c_str(), name_len);
 
-    connections.server_socket.send(boost::asio::buffer(
-        std::string(join_msg, message_size)));
+    send_to_server(connections, join_msg, message_size);
+}
+
+// This function asks the server for capabilities this client supports
+// and, after reconnecting during a game, for resuming the player with
+// a given session token. The server answers with a Capabilities message
+// listing accepted capabilities.
+void send_capabilities(ConnectionsData &connections, std::optional<uint64_t> token) {
+    char message[2 + SESSION_TOKEN_LENGTH];
+    char *msg_ptr = message;
+    auto msg_type = (uint8_t) ClientCapabilities;
+    put_data_into_buffer(msg_ptr, &msg_type, sizeof(uint8_t));
+    put_data_into_buffer(msg_ptr, &connections.capabilities, sizeof(uint8_t));
+
+    if (token.has_value()) {
+        msg_type = (uint8_t) ClientResume;
+        uint32_t token_high = htonl((uint32_t) (*token >> 32));
+        uint32_t token_low = htonl((uint32_t) *token);
+        put_data_into_buffer(msg_ptr, &msg_type, sizeof(uint8_t));
+        put_data_into_buffer(msg_ptr, &token_high, sizeof(uint32_t));
+        put_data_into_buffer(msg_ptr, &token_low, sizeof(uint32_t));
+    }
+    send_to_server(connections, message, (size_t) (msg_ptr - message));
+}
+
+// This function returns the buffer to serialize a message for gui into -
+// the next frame of the shared memory segment if there is one.
+static char *gui_buffer(ConnectionsData &connections, char *buffer) {
+    return connections.gui_shm ? connections.gui_shm->begin_frame() : buffer;
+}
+
+// This function sends a message to gui and its mirrors, serialized once,
+// with a single sendmmsg call. With a shared memory segment the message
+// is already in it and only gets published, mirrors still get datagrams.
+// A mirror which can't take the message is skipped, errors of sending
+// to gui itself are thrown. The headers are kept in the connections and
+// reused, so sending allocates nothing; senders hold the status mutex.
+static void send_to_gui(ConnectionsData &connections, const char *buffer, size_t message_size) {
+    auto &endpoints = connections.gui_endpoints;
+    size_t sent = 0;
+    if (connections.gui_shm) {
+        connections.gui_shm->publish_frame(message_size);
+        sent = 1;
+    }
+
+    if (endpoints.size() - sent == 1) {
+        connections.gui_socket.send_to(boost::asio::buffer(buffer, message_size), endpoints[sent]);
+        sent++;
+    }
+    if (sent == endpoints.size()) {
+        trace<TRACE_IO>(TraceEvent::SentToGui, message_size);
+        return;
+    }
+
+    std::vector<mmsghdr> &messages = connections.gui_messages;
+    messages.resize(endpoints.size());
+    connections.gui_message_data = {(void *) buffer, message_size};
+    for (size_t i = sent; i < endpoints.size(); i++) {
+        messages[i].msg_hdr.msg_name = endpoints[i].data();
+        messages[i].msg_hdr.msg_namelen = (socklen_t) endpoints[i].size();
+        messages[i].msg_hdr.msg_iov = &connections.gui_message_data;
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
 
-    if (debug) {
-        std::cerr << "sent " << message_size <<
-        " bytes to " << connections.server_endpoint << "\n";
+    while (sent < messages.size()) {
+        int result = sendmmsg(connections.gui_socket.native_handle(), messages.data() + sent,
+                              (unsigned) (messages.size() - sent), 0);
+        if (result >= 0) {
+            sent += (size_t) result;
+        } else if (errno != EINTR) {
+            if (sent == 0) throw boost::system::system_error(errno, boost::system::system_category());
+            if (debug) std::cerr << "sending to mirror " << endpoints[sent] << ": " << strerror(errno) << "\n";
+            sent++;
+        }
     }
+    trace<TRACE_IO>(TraceEvent::SentToGui, message_size);
 }
 
 // Helper function serializing lobby message and then sending it to gui.
 void send_lobby_to_gui(GameData &status, ConnectionsData &connections,
                        char *buffer) {
 
+    buffer = gui_buffer(connections, buffer);
     size_t message_size = serialize_lobby_message(status.parameters, buffer,
                                                   status.lobby_players);
 
-    connections.gui_socket.send_to(
-            boost::asio::buffer(buffer,message_size), connections.gui_endpoint);
-
-    if (debug) {
-        std::cerr << "sent " << message_size <<
-        " bytes to " << connections.gui_endpoint << "\n";
-    }
+    send_to_gui(connections, buffer, message_size);
 }
 
 // Helper function serializing game message and then sending it to gui.
+// With pending moves the player's robot is shown at its predicted position,
+// set in a snapshot of the state, which copies only the positions map.
 void send_game_to_gui(GameData &status, ConnectionsData &connections,
                       char *buffer) {
 
-    size_t message_size = serialize_game_message(
-            status.parameters,status.game_state, buffer);
+    MovePrediction &prediction = status.prediction;
+    GameState *shown_state = &status.game_state;
+    // built only when a move is predicted, a default state allocates its containers
+    std::optional<GameState> predicted_state;
+    if (prediction.own_id.has_value() && !prediction.pending.empty()) {
+        predicted_state.emplace(status.game_state);
+        predicted_state->player_positions.write()[*prediction.own_id] =
+                predicted_position(prediction, status.game_state, status.parameters);
+        shown_state = &*predicted_state;
+    }
 
-    connections.gui_socket.send_to(
-            boost::asio::buffer(buffer, message_size),connections.gui_endpoint);
+    buffer = gui_buffer(connections, buffer);
+    size_t message_size = serialize_game_message(
+            status.parameters, *shown_state, buffer);
 
-    if (debug) {
-        std::cerr << "sent " << message_size <<
-        " bytes to " << connections.gui_endpoint << "\n";
-    }
+    send_to_gui(connections, buffer, message_size);
 }
 
 // This function checks gui message correctness:,
@@ -90,20 +182,18 @@ bool check_gui_message_correctness(char *gui_message, size_t len) {
     char *msg_ptr = gui_message;
     uint8_t message_type = (*((uint8_t*) msg_ptr));
     if (message_type >= GUI_MESSAGES_NUMBER) return false;
+    trace<TRACE_MESSAGES>(TraceEvent::GuiMessage, message_type);
 
     uint8_t dir;
     msg_ptr += 1;
 
     switch ((GuiMessage) message_type) {
         case PlaceBomb:
-            if (debug) std::cerr << "received PlaceBomb message from gui\n";
             break;
         case PlaceBlock:
-            if (debug) std::cerr << "received PlaceBlock message from gui\n";
             if (len != 1) return false;
             break;
         case Move:
-            if (debug) std::cerr << "received Move message from gui\n";
             if (len != 2) return false;
             dir = *((uint8_t*) msg_ptr);
             if (dir >= DIRECTIONS_NUMBER) return false;
@@ -119,7 +209,7 @@ void parse_hello_message(Buffer &msg_buffer, GameParameters &g) {
     uint8_t message_type = msg_buffer.get_u8();
     if ((ServerMessage) message_type != Hello) exit(EXIT_FAILURE);
 
-    if (debug) std::cerr << "received Hello message from server\n";
+    trace<TRACE_MESSAGES>(TraceEvent::ServerMessage, message_type);
 
     uint8_t server_name_len = msg_buffer.get_u8();
     std::string server_name = msg_buffer.get_string(server_name_len);
@@ -137,12 +227,12 @@ void parse_hello_message(Buffer &msg_buffer, GameParameters &g) {
 }
 
 // This function reads player map from the server and creates new GameState.
-GameState handle_game_started(Buffer &msg_buffer) {
+GameState handle_game_started(Buffer &msg_buffer, StringTable &strings) {
     players_map_t players{};
-    uint32_t map_len = msg_buffer.get_u32();
+    uint32_t map_len = msg_buffer.get_length();
 
     for (size_t i = 0; i < map_len; i++)
-        players.insert(get_player_data(msg_buffer));
+        players.insert(get_player_data(msg_buffer, strings));
 
     positions_set_t initial_blocks{};
     player_positions_map_t initial_player_positions{};
@@ -153,7 +243,7 @@ GameState handle_game_started(Buffer &msg_buffer) {
 // Returns true if they are, false if they aren't.
 bool handle_game_ended(Buffer &msg_buffer, GameState &state) {
     scores_map_t player_scores{};
-    uint32_t map_len = msg_buffer.get_u32();
+    uint32_t map_len = msg_buffer.get_length();
 
     for (size_t i = 0; i < map_len; i++)
         player_scores.insert(get_player_score(msg_buffer));
@@ -166,28 +256,33 @@ bool handle_game_ended(Buffer &msg_buffer, GameState &state) {
 
 // This function parses a message received in Lobby state.
 // Exits if the first byte doesn't represent a valid message type.
-ServerMessage parse_lobby_msg(Buffer &msg_buffer, GameState &g,
-                              players_map_t &lobby_players, GameParameters &params) {
+// Strings of new players are interned in [strings].
+ServerMessage parse_lobby_msg(Buffer &msg_buffer, GameState &g, players_map_t &lobby_players,
+                              GameParameters &params, StringTable &strings) {
 
     uint8_t message_type = msg_buffer.get_u8();
     if (message_type > SERVER_MESSAGES_NUMBER) exit(EXIT_FAILURE);
+    trace<TRACE_MESSAGES>(TraceEvent::ServerMessage, message_type);
 
     positions_set_t initial_blocks{};
     player_positions_map_t initial_player_positions{};
     switch((ServerMessage) message_type) {
         case AcceptedPlayer: // adding player
-            if (debug) std::cerr << "received AcceptedPlayer message from server\n";
-            lobby_players.insert(get_player_data(msg_buffer));
+            lobby_players.insert(get_player_data(msg_buffer, strings));
             return AcceptedPlayer;
         case GameStarted: // starting game
-            if (debug) std::cerr << "received GameStarted message from server\n";
-            g = handle_game_started(msg_buffer);
+            g = handle_game_started(msg_buffer, strings);
             return GameStarted;
         case Turn: // starting game
-            if (debug) std::cerr << "received Turn message from server\n";
             g = GameState(lobby_players, initial_blocks, initial_player_positions);
             aggregate_game_state(msg_buffer, g, params);
             return Turn;
+        case Capabilities: // server accepted some of our capabilities
+            msg_buffer.set_compact(msg_buffer.get_u8() & CAPABILITY_COMPACT_ENCODING);
+            return Capabilities;
+        case GameSnapshot: // joining the game in progress
+            read_game_snapshot(msg_buffer, g, strings);
+            return GameSnapshot;
         default: // ignoring other message types
             return Unexpected;
     }
@@ -199,53 +294,130 @@ ServerMessage parse_in_game_msg(Buffer &msg_buffer, GameState &g, GameParameters
 
     uint8_t message_type = msg_buffer.get_u8();
     if (message_type > SERVER_MESSAGES_NUMBER) exit(EXIT_FAILURE);
+    trace<TRACE_MESSAGES>(TraceEvent::ServerMessage, message_type);
 
     switch((ServerMessage) message_type) {
         case Turn: // aggregating game state
-            if (debug) std::cerr << "received Turn message from server\n";
             g.explosions = {};
             aggregate_game_state(msg_buffer, g, params);
             return Turn;
         case GameEnded: // ending game
-            if (debug) std::cerr << "received GameEnded message from server\n";
             if (!handle_game_ended(msg_buffer, g))
                 std::cerr << "INCORRECT SCORES CALCULATION\n";
             return GameEnded;
+        case Capabilities: // server accepted some of our capabilities
+            msg_buffer.set_compact(msg_buffer.get_u8() & CAPABILITY_COMPACT_ENCODING);
+            return Capabilities;
         default: // we ignore other message types
             return Unexpected;
     }
 }
 
+// This function decompresses a Compressed message into the buffer in place
+// of the message. The content is then parsed like any other data received
+// from the server.
+void unwrap_compressed_message(Buffer &msg_buffer, GameData &status) {
+    msg_buffer.get_u8();
+    uint32_t original_len = msg_buffer.get_u32();
+    uint32_t compressed_len = msg_buffer.get_u32();
+    if (original_len > MAX_DECOMPRESSED_LENGTH || compressed_len > MAX_DECOMPRESSED_LENGTH)
+        exit(EXIT_FAILURE);
+
+    trace<TRACE_MESSAGES>(TraceEvent::CompressedMessage, compressed_len, original_len);
+
+    // the compressed bytes may be split between reads, so they are copied out first
+    status.compressed_message.resize(compressed_len);
+    msg_buffer.get_bytes(status.compressed_message.data(), compressed_len);
+    if (!lz4_decompress(status.compressed_message.data(), compressed_len,
+                        msg_buffer.make_room(original_len), original_len))
+        exit(EXIT_FAILURE);
+}
+
+// This function prints time since losing connection to the server.
+void report_reconnect_time(GameData &status, const char *what) {
+    if (!status.reconnect_start.has_value()) return;
+
+    auto elapsed = std::chrono::steady_clock::now() - *status.reconnect_start;
+    std::cerr << what << " in " << std::chrono::duration_cast<
+            std::chrono::milliseconds>(elapsed).count() << " ms\n";
+}
+
+// This function finds the player's robot in a new game, if the client
+// asked to join it or resumes it, and moves of the robot are predicted.
+void find_own_robot(GameData &status, ConnectionsData &connections) {
+    if (get_state() != Lobby && !status.session_token.has_value()) {
+        clear_prediction(status.prediction);
+        return;
+    }
+
+    boost::system::error_code ec;
+    auto local_endpoint = connections.server_socket.local_endpoint(ec);
+    std::string address;
+    if (!ec) address = local_endpoint.address().to_string() + ":" +
+                       std::to_string(local_endpoint.port());
+    find_own_player(status.prediction, status.game_state.players.get(), connections.player_name, address);
+}
+
 // This function handles a message stored in a buffer received from the server.
 // Acts accordingly to received message.
 void handle_server_message(GameData &status, Buffer &msg_buffer,
                            ConnectionsData &connections) {
 
     char buffer_for_gui[UDP_BUFFER_LENGTH];
+    std::lock_guard<std::mutex> lock(status.mutex);
     if (status.waiting_for_hello) {
         parse_hello_message(msg_buffer, status.parameters);
         status.waiting_for_hello = false;
+        report_reconnect_time(status, "reconnected");
+        if (!status.session_token.has_value()) status.reconnect_start.reset();
         send_lobby_to_gui(status, connections, buffer_for_gui);
     }
     else {
-        if (get_state() == Lobby || get_state() == SendJoin) {
-            ServerMessage msg = parse_lobby_msg(msg_buffer, status.game_state,
-                                                status.lobby_players,status.parameters);
+        if (msg_buffer.peek_u8() == Compressed)
+            unwrap_compressed_message(msg_buffer, status);
 
-            if (msg == GameStarted || msg == Turn) set_state(Game);
+        if (msg_buffer.peek_u8() == SessionToken) {
+            trace<TRACE_MESSAGES>(TraceEvent::ServerMessage, SessionToken);
+            msg_buffer.get_u8();
+            status.session_token = msg_buffer.get_u64();
+        }
+        else if (get_state() == Lobby || get_state() == SendJoin) {
+            ServerMessage msg = parse_lobby_msg(msg_buffer, status.game_state, status.lobby_players,
+                                                status.parameters, status.strings);
+
+            if (msg == Capabilities) status.compact_encoding = msg_buffer.is_compact();
+            else if (msg == GameStarted || msg == Turn) {
+                if (msg == GameStarted) find_own_robot(status, connections);
+                set_state(Game);
+            }
+            else if (msg == GameSnapshot) {
+                find_own_robot(status, connections);
+                set_state(Game);
+                if (status.session_token.has_value())
+                    report_reconnect_time(status, "resumed the game");
+                status.reconnect_start.reset();
+                send_game_to_gui(status, connections, buffer_for_gui);
+            }
             else if (msg == AcceptedPlayer) {
                 send_lobby_to_gui(status, connections, buffer_for_gui);
             }
         }
         else {
+            std::optional<OwnRobot> own_robot = get_own_robot(status.prediction,
+                                                              status.game_state);
             ServerMessage msg = parse_in_game_msg(msg_buffer, status.game_state,
                                                   status.parameters);
 
-            if (msg == Turn) {
+            if (msg == Capabilities) status.compact_encoding = msg_buffer.is_compact();
+            else if (msg == Turn) {
+                if (own_robot.has_value())
+                    reconcile_moves(status.prediction, status.game_state, *own_robot);
                 send_game_to_gui(status, connections, buffer_for_gui);
             }
             else if (msg == GameEnded) {
                 status.lobby_players = {};
+                status.session_token.reset();
+                clear_prediction(status.prediction);
                 send_lobby_to_gui(status, connections, buffer_for_gui);
                 set_state(SendJoin);
             }
@@ -253,36 +425,99 @@ void handle_server_message(GameData &status, Buffer &msg_buffer,
     }
 }
 
-// Function executed by a thread.
-// It receives messages from the server in an endless loop and
-// sends lobby and game state to gui.
-void handle_game_info_from_server(ConnectionsData &connections) {
-    GameData status;
+// This function receives messages from the server in an endless loop and
+// sends lobby and game state to gui. Throws when the connection is lost.
+void receive_server_messages(GameData &status, ConnectionsData &connections) {
+    while (true) {
+        Buffer buffer(connections.server_socket);
+        buffer.set_compact(status.compact_encoding);
+        size_t message_size = buffer.receive_new_data();
 
-    try {
-        while (true) {
-            Buffer buffer(connections.server_socket);
-            size_t message_size = buffer.receive_new_data();
+        trace<TRACE_IO>(TraceEvent::ReceivedFromServer, message_size);
 
-            if (debug) {
-                std::cerr << "received " << message_size <<
-                " bytes from " << connections.server_endpoint << "\n";
-            }
+        while(buffer.get_msg_len() != buffer.get_parsed_len()) {
+            handle_server_message(status, buffer, connections);
+        }
+    }
+}
 
-            while(buffer.get_msg_len() != buffer.get_parsed_len()) {
-                handle_server_message(status, buffer, connections);
-            }
+// This function connects to the server again, waiting between attempts
+// with exponential backoff. Returns false if all attempts failed.
+// The new connection starts from Hello, a player in the game asks
+// the server to resume it with its session token.
+bool reconnect_to_server(GameData &status, ConnectionsData &connections) {
+    status.reconnect_start = std::chrono::steady_clock::now();
+    auto delay = std::chrono::milliseconds(RECONNECT_MIN_DELAY_MS);
+
+    for (int attempt = 0; attempt < RECONNECT_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(delay);
+            delay = std::min(2 * delay, std::chrono::milliseconds(RECONNECT_MAX_DELAY_MS));
+        }
+
+        try {
+            connections.reconnect_to_server();
+        }
+        catch (std::exception &e) {
+            if (debug) std::cerr << "reconnect attempt " << attempt << ": " << e.what() << "\n";
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(status.mutex);
+            status.waiting_for_hello = true;
+            status.compact_encoding = false;
+            status.lobby_players = {};
+            clear_prediction(status.prediction);
         }
+        set_state(SendJoin);
+        send_capabilities(connections, status.session_token);
+        return true;
     }
-    catch (std::exception& e) {
-        std::cerr << "Exception: " << e.what() << "\n";
+    return false;
+}
+
+// Function executed by a thread.
+// It receives messages from the server and sends lobby and game state to gui.
+// With --reconnect it connects again after losing connection.
+void handle_game_info_from_server(ConnectionsData &connections, GameData &status) {
+    while (true) {
+        try {
+            receive_server_messages(status, connections);
+        }
+        catch (std::exception& e) {
+            std::cerr << "Exception: " << e.what() << "\n";
+        }
+
+        if (!connections.reconnect) return;
+        if (!reconnect_to_server(status, connections)) {
+            std::cerr << "could not reconnect to " << connections.server_endpoint << "\n";
+            return;
+        }
     }
 }
 
+// This function shows a move to gui before the server confirms it,
+// if the player plays in the current game. Other actions cancel
+// the move sent in the same turn, as the server applies only the last one.
+void predict_action(GameData &status, ConnectionsData &connections,
+                    GuiMessage action, uint8_t direction) {
+    std::lock_guard<std::mutex> lock(status.mutex);
+    if (get_state() != Game) return;
+    bool changed = action == Move ?
+                   add_pending_move(status.prediction, status.game_state, direction) :
+                   cancel_pending_move(status.prediction, status.game_state);
+    if (!changed) return;
+
+    char buffer_for_gui[UDP_BUFFER_LENGTH];
+    send_game_to_gui(status, connections, buffer_for_gui);
+}
+
 // Function executed by another thread.
 // It receives messages from gui in an endless loop and sends
-// user input to the server.
-void handle_user_input_from_gui(ConnectionsData &connections) {
+// user input to the server. With --predict-moves it shows
+// the player's moves to gui at once.
+void handle_user_input_from_gui(ConnectionsData &connections, GameData &status) {
     char gui_message[UDP_BUFFER_LENGTH];
 
     try {
@@ -292,10 +527,7 @@ void handle_user_input_from_gui(ConnectionsData &connections) {
                 boost::asio::buffer(gui_message, UDP_BUFFER_LENGTH),
                                            sender_endpoint);
 
-            if (debug) {
-                std::cerr << "received " << message_size <<
-                " bytes from " << connections.gui_endpoint << "\n";
-            }
+            trace<TRACE_IO>(TraceEvent::ReceivedFromGui, message_size);
 
             if (check_gui_message_correctness(gui_message, message_size)) {
                 if (get_state() == SendJoin) {
@@ -303,14 +535,11 @@ void handle_user_input_from_gui(ConnectionsData &connections) {
                     set_state(Lobby);
                 }
                 else {
+                    auto action = (GuiMessage) gui_message[0];
                     gui_message[0] = char ((int) gui_message[0] + 1);
-                    connections.server_socket.send(
-                        boost::asio::buffer(gui_message, message_size));
-
-                    if (debug) {
-                        std::cerr << "sent " << message_size <<
-                        " bytes to " << connections.server_endpoint << "\n";
-                    }
+                    send_to_server(connections, gui_message, message_size);
+                    if (status.prediction.enabled)
+                        predict_action(status, connections, action, (uint8_t) gui_message[1]);
                 }
             }
         }
@@ -327,14 +556,19 @@ int main(int argc, char* argv[]) {
     if (!check_client_options(options, argc, argv)) exit(EXIT_FAILURE);
 
     try {
+        if (!options.trace_file.empty()) start_trace_file(options.trace_file);
         ConnectionsData connections_data(options);
+        if (connections_data.capabilities != 0) send_capabilities(connections_data, {});
+
+        GameData status;
+        status.prediction.enabled = options.predict_moves;
 
         std::string player_name = options.player_name;
         std::thread gui_receiver_thread(handle_user_input_from_gui,
-                                        std::ref(connections_data));
+                                        std::ref(connections_data), std::ref(status));
 
         std::thread server_receiver_thread(handle_game_info_from_server,
-                                           std::ref(connections_data));
+                                           std::ref(connections_data), std::ref(status));
 
         gui_receiver_thread.join();
         server_receiver_thread.join();
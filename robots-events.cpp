@@ -0,0 +1,55 @@
+// Robots-events - reads chosen columns of an events file written by robots-server
+// or robots-sim with --export-file and prints them as CSV, one event per line.
+// Columns which aren't chosen are not read at all.
+
+#include <iostream>
+#include <sstream>
+
+#include "options-parser.h"
+#include "event-export.h"
+
+int main(int argc, char *argv[]) {
+    EventsOptions options;
+    if (!check_events_options(options, argc, argv)) exit(EXIT_FAILURE);
+
+    try {
+        EventExportReader reader(options.file);
+        if (options.count) {
+            uint64_t events = 0;
+            for (size_t group = 0; group < reader.groups_count(); group++)
+                events += reader.group_rows(group);
+            std::cout << events << "\n";
+            return 0;
+        }
+
+        std::vector<size_t> columns;
+        std::stringstream names(options.columns);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            auto column = reader.find_column(name);
+            if (!column.has_value()) {
+                std::cerr << "no column " << name << "\n";
+                exit(EXIT_FAILURE);
+            }
+            columns.push_back(*column);
+        }
+
+        std::cout << options.columns << "\n";
+        std::vector<std::vector<uint32_t>> values(columns.size());
+        for (size_t group = 0; group < reader.groups_count(); group++) {
+            for (size_t i = 0; i < columns.size(); i++)
+                reader.read_column(group, columns[i], values[i]);
+
+            for (uint32_t row = 0; row < reader.group_rows(group); row++) {
+                for (size_t i = 0; i < columns.size(); i++)
+                    std::cout << (i > 0 ? "," : "") << values[i][row];
+                std::cout << "\n";
+            }
+        }
+    }
+    catch (std::exception &e) {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
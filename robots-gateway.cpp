@@ -0,0 +1,252 @@
+// Robots-gateway - owns the public port in front of several robots-server
+// processes on the same host, started with --gateway-control. It sends a new
+// client the servers' Hello, reads its first messages and picks a server for it:
+// the server of its session token if it resumes a game, otherwise the server
+// whose filling room is closest to a full game, then the least loaded one.
+// Players of a game so end up on the same server, while games are spread.
+// The server is first told the client's address, then the gateway only moves
+// bytes between the two connections with splice, without parsing them. Servers which stop reporting get no new clients, so they can be
+// restarted one by one while others take new players.
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+#include "options-parser.h"
+#include "definitions.h"
+#include "gateway-control.h"
+
+using boost::asio::ip::tcp;
+
+// Bytes moved by a single splice call.
+#define GATEWAY_SPLICE_LENGTH (64 * 1024)
+
+// Servers which have reported, by port.
+class Backends {
+private:
+    struct Backend {
+        BackendReport report;
+        std::chrono::steady_clock::time_point last_report;
+        uint32_t assigned = 0; // clients sent to it since its last report
+    };
+
+    std::mutex mutex;
+    std::map<uint16_t, Backend> backends;
+
+    static bool alive(const Backend &backend, std::chrono::steady_clock::time_point now) {
+        return now - backend.last_report < std::chrono::milliseconds(GATEWAY_BACKEND_TIMEOUT_MS);
+    }
+
+public:
+    void update(BackendReport &report) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Backend &backend = backends[report.port];
+        backend.report = std::move(report);
+        backend.last_report = std::chrono::steady_clock::now();
+        backend.assigned = 0;
+    }
+
+    // Returns the Hello of a live server.
+    std::optional<std::string> hello() {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        for (auto &backend : backends)
+            if (alive(backend.second, now)) return backend.second.report.hello;
+        return {};
+    }
+
+    // Returns the port of a live server for a new client - of the given
+    // instance, if there is one, otherwise the one whose filling room has most
+    // clients towards a full game, then the one with fewest connections.
+    // Clients sent since a server's last report are counted as in its lobby.
+    std::optional<uint16_t> pick(std::optional<uint8_t> instance) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        auto lobby = [](const Backend &backend) {
+            return (backend.report.lobby_sessions + backend.assigned) % backend.report.players_count;
+        };
+        auto load = [](const Backend &backend) {
+            return backend.report.connections + backend.assigned;
+        };
+
+        Backend *best = nullptr;
+        for (auto &[port, backend] : backends) {
+            if (!alive(backend, now)) continue;
+            if (instance.has_value() && backend.report.instance == *instance) {
+                best = &backend;
+                break;
+            }
+            if (!best || lobby(backend) > lobby(*best) ||
+                (lobby(backend) == lobby(*best) && load(backend) < load(*best)))
+                best = &backend;
+        }
+        if (!best) return {};
+        best->assigned++;
+        return best->report.port;
+    }
+};
+
+// This function receives reports of servers on a Unix socket. Never returns.
+[[noreturn]] void receive_reports(int fd, Backends &backends) {
+    char datagram[UDP_BUFFER_LENGTH];
+    BackendReport report;
+    while (true) {
+        ssize_t length = recv(fd, datagram, sizeof(datagram), 0);
+        if (length > 0 && parse_backend_report(datagram, (size_t) length, report)) backends.update(report);
+    }
+}
+
+// This function reads the client's first messages into [prefix], up to
+// a message deciding where the client goes. Returns the instance from the token
+// of ClientResume, if the client resumes a session. Clients using extensions
+// send them right after connecting; a client which sends nothing for
+// CAPABILITIES_WAIT_MS, e.g. an observer, is placed by load too.
+static std::optional<uint8_t> read_first_messages(int fd, std::vector<char> &prefix) {
+    size_t parsed = 0;
+    char chunk[TCP_BUFFER_LENGTH];
+    auto receive = [&](size_t length) {
+        while (prefix.size() < parsed + length) {
+            pollfd poll_fd{fd, POLLIN, 0};
+            if (poll(&poll_fd, 1, CAPABILITIES_WAIT_MS) <= 0) return false;
+            ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) return false;
+            prefix.insert(prefix.end(), chunk, chunk + received);
+        }
+        return true;
+    };
+
+    while (receive(1)) {
+        auto message_type = (uint8_t) prefix[parsed];
+        if (message_type == ClientCapabilities) {
+            if (!receive(2)) return {};
+            parsed += 2;
+            continue;
+        }
+        if (message_type != ClientResume || !receive(SESSION_TOKEN_LENGTH)) return {};
+
+        uint64_t token;
+        memcpy(&token, prefix.data() + parsed + 1, sizeof(token));
+        return (uint8_t) (be64toh(token) >> TOKEN_INSTANCE_SHIFT);
+    }
+    return {};
+}
+
+// This function reads the server's Hello, which the client has already got from the gateway.
+static void skip_hello(tcp::socket &server) {
+    char header[2];
+    boost::asio::read(server, boost::asio::buffer(header));
+    // name, players count and five uint16_t parameters
+    std::vector<char> rest((uint8_t) header[1] + sizeof(uint8_t) + 5 * sizeof(uint16_t));
+    boost::asio::read(server, boost::asio::buffer(rest));
+}
+
+// This function moves bytes from one socket to another through a pipe, without
+// copying them to user space, until either of them is closed. Then it shuts
+// both down, so forwarding in the other direction ends too.
+static void forward(int from, int to) {
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) == 0) {
+        bool open = true;
+        while (open) {
+            ssize_t received = splice(from, nullptr, pipe_fds[1], nullptr, GATEWAY_SPLICE_LENGTH, SPLICE_F_MOVE);
+            open = received > 0;
+            while (open && received > 0) {
+                ssize_t sent = splice(pipe_fds[0], nullptr, to, nullptr, (size_t) received, SPLICE_F_MOVE);
+                open = sent > 0;
+                received -= sent;
+            }
+        }
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+    shutdown(from, SHUT_RDWR);
+    shutdown(to, SHUT_RDWR);
+}
+
+// This function handles a client connection - sends it Hello, connects it
+// to a server and forwards its bytes until either side disconnects.
+void handle_client_connection(boost::asio::io_context &io_context, Backends &backends, tcp::socket client) {
+    try {
+        client.set_option(tcp::no_delay(true));
+        std::optional<std::string> hello = backends.hello();
+        if (!hello.has_value()) {
+            if (debug) std::cerr << "no servers\n";
+            return;
+        }
+        boost::asio::write(client, boost::asio::buffer(*hello));
+
+        std::vector<char> prefix;
+        std::optional<uint8_t> instance = read_first_messages(client.native_handle(), prefix);
+        std::optional<uint16_t> port = backends.pick(instance);
+        if (!port.has_value()) return;
+
+        tcp::socket server(io_context);
+        server.connect(tcp::endpoint(boost::asio::ip::address_v6::loopback(), *port));
+        server.set_option(tcp::no_delay(true));
+        skip_hello(server);
+        // the server sees the gateway's address, so it is told the client's
+        std::vector<char> header;
+        tcp::endpoint client_endpoint = client.remote_endpoint();
+        serialize_client_address(header, client_endpoint.address().to_string() + ":" +
+                                         std::to_string(client_endpoint.port()));
+        std::array<boost::asio::const_buffer, 2> first_bytes = {boost::asio::buffer(header),
+                                                                boost::asio::buffer(prefix)};
+        boost::asio::write(server, first_bytes);
+        if (debug) std::cerr << client.remote_endpoint() << " goes to port " << *port << "\n";
+
+        std::thread to_server(forward, client.native_handle(), server.native_handle());
+        forward(server.native_handle(), client.native_handle());
+        to_server.join();
+    }
+    catch (std::exception &e) {
+        if (debug) std::cerr << "client connection: " << e.what() << "\n";
+    }
+}
+
+// Main function - receives reports of servers in one thread and accepts clients,
+// every client is handled by a separate thread.
+int main(int argc, char *argv[]) {
+    GatewayOptions options;
+    if (!check_gateway_options(options, argc, argv)) exit(EXIT_FAILURE);
+
+    int control_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    sockaddr_un control_address{};
+    control_address.sun_family = AF_UNIX;
+    strncpy(control_address.sun_path, options.control.c_str(), sizeof(control_address.sun_path) - 1);
+    unlink(options.control.c_str());
+    if (control_fd < 0 || bind(control_fd, (sockaddr *) &control_address, sizeof(control_address)) < 0) {
+        std::cerr << "control socket " << options.control << ": " << strerror(errno) << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    Backends backends;
+    std::thread(receive_reports, control_fd, std::ref(backends)).detach();
+    std::cout << "listening on port " << options.port << "\n";
+
+    try {
+        boost::asio::io_context io_context;
+        tcp::acceptor acceptor(io_context, tcp::endpoint(tcp::v6(), options.port));
+        while (true) {
+            tcp::socket socket(io_context);
+            acceptor.accept(socket);
+            std::thread(handle_client_connection, std::ref(io_context), std::ref(backends),
+                        std::move(socket)).detach();
+        }
+    }
+    catch (std::exception &e) {
+        std::cerr << e.what() << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+// Robots-leaderboard - prints the best players from a leaderboard file
+// of robots-server, ordered by wins and then by win rate.
+
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+#include "options-parser.h"
+#include "leaderboard.h"
+
+// This function returns player's win rate in percents.
+static double win_rate(const LeaderboardRecord &record) {
+    return record.games == 0 ? 0 : 100.0 * (double) record.wins / (double) record.games;
+}
+
+int main(int argc, char *argv[]) {
+    LeaderboardOptions options;
+    if (!check_leaderboard_options(options, argc, argv)) exit(EXIT_FAILURE);
+
+    try {
+        Leaderboard leaderboard(options.file, true);
+
+        std::vector<uint32_t> order(leaderboard.size());
+        std::iota(order.begin(), order.end(), 0);
+        size_t top = std::min(order.size(), (size_t) options.top);
+        std::partial_sort(order.begin(), order.begin() + (long) top, order.end(),
+                          [&leaderboard](uint32_t a, uint32_t b) {
+            const LeaderboardRecord &r_a = leaderboard.record(a), &r_b = leaderboard.record(b);
+            if (r_a.wins != r_b.wins) return r_a.wins > r_b.wins;
+            return win_rate(r_a) > win_rate(r_b);
+        });
+
+        std::cout << leaderboard.size() << " players\n";
+        std::cout << "name\tgames\twins\twin rate\tkills\tdeaths\n";
+        for (size_t i = 0; i < top; i++) {
+            const LeaderboardRecord &record = leaderboard.record(order[i]);
+            std::cout << record.name << "\t" << record.games << "\t" << record.wins << "\t"
+                      << std::fixed << std::setprecision(1) << win_rate(record) << "%\t"
+                      << record.kills << "\t" << record.deaths << "\n";
+        }
+    }
+    catch (std::exception &e) {
+        std::cerr << e.what() << '\n';
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
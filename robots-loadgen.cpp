@@ -0,0 +1,169 @@
+// Robots-loadgen - a load generator for benchmarking robots-server.
+// Opens many connections to the server, the first [players] of them join
+// the game and send random moves, all of them receive and count server data.
+// With --connect-only every connection only waits for Hello and is opened
+// again, which measures how many connections per second the server accepts.
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include <boost/asio.hpp>
+#include "options-parser.h"
+#include "definitions.h"
+
+using boost::asio::ip::tcp;
+
+// A structure for a single load generating connection.
+struct LoadSession {
+    tcp::socket socket;
+    std::array<char, TCP_BUFFER_LENGTH> buffer{};
+    bool player;
+
+    LoadSession(boost::asio::io_context &io_context, bool player):
+            socket(io_context), player(player){};
+};
+
+using load_session_ptr_t = std::shared_ptr<LoadSession>;
+
+// Statistics gathered by all sessions.
+struct LoadStatistics {
+    size_t connected = 0;
+    size_t failed = 0;
+    size_t bytes_received = 0;
+    size_t connections = 0; // completed connections in --connect-only mode
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point all_connected;
+};
+
+// This function receives data from the server in an endless loop.
+void receive_loop(const load_session_ptr_t &session, LoadStatistics &stats) {
+    session->socket.async_read_some(
+            boost::asio::buffer(session->buffer),
+            [session, &stats](boost::system::error_code ec, size_t length) {
+                if (ec) return;
+                stats.bytes_received += length;
+                receive_loop(session, stats);
+            });
+}
+
+// This function sends a random move of every player
+// and schedules itself again after [interval].
+void send_moves(boost::asio::steady_timer &timer, std::vector<load_session_ptr_t> &sessions,
+                std::minstd_rand &random, uint32_t interval) {
+    static std::array<std::array<char, 2>, DIRECTIONS_NUMBER> moves = {{
+        {ClientMove, Up}, {ClientMove, Right}, {ClientMove, Down}, {ClientMove, Left}
+    }};
+
+    for (auto &session : sessions) {
+        if (!session->player || !session->socket.is_open()) continue;
+        auto &move = moves[random() % DIRECTIONS_NUMBER];
+        boost::asio::async_write(session->socket, boost::asio::buffer(move),
+                                 [](boost::system::error_code, size_t) {});
+    }
+
+    timer.expires_at(timer.expiry() + std::chrono::milliseconds(interval));
+    timer.async_wait([&, interval](boost::system::error_code ec) {
+        if (!ec) send_moves(timer, sessions, random, interval);
+    });
+}
+
+// This function connects to the server, waits for the first bytes of Hello
+// and disconnects, in an endless loop.
+void connect_loop(const load_session_ptr_t &session, const tcp::resolver::results_type &endpoints,
+                  LoadStatistics &stats) {
+    boost::asio::async_connect(session->socket, endpoints,
+        [session, &endpoints, &stats](boost::system::error_code ec, const tcp::endpoint &) {
+            if (ec) {
+                stats.failed++;
+                session->socket.close();
+                connect_loop(session, endpoints, stats);
+                return;
+            }
+            session->socket.async_read_some(boost::asio::buffer(session->buffer),
+                [session, &endpoints, &stats](boost::system::error_code ec, size_t) {
+                    if (ec) stats.failed++;
+                    else stats.connections++;
+
+                    // reset instead of leaving the port in TIME_WAIT
+                    boost::system::error_code ignored;
+                    session->socket.set_option(boost::asio::socket_base::linger(true, 0), ignored);
+                    session->socket.close();
+                    connect_loop(session, endpoints, stats);
+                });
+        });
+}
+
+int main(int argc, char *argv[]) {
+    LoadgenOptions options;
+    if (!check_loadgen_options(options, argc, argv)) exit(EXIT_FAILURE);
+
+    std::string server_address, server_port;
+    get_hostname_and_port(options.server_address, server_address, server_port);
+
+    boost::asio::io_context io_context;
+    tcp::resolver resolver(io_context);
+    auto endpoints = resolver.resolve(server_address, server_port);
+
+    LoadStatistics stats;
+    stats.start = std::chrono::steady_clock::now();
+    std::vector<load_session_ptr_t> sessions;
+
+    for (uint32_t i = 0; i < options.sessions; i++) {
+        auto session = std::make_shared<LoadSession>(io_context, i < options.players);
+        sessions.push_back(session);
+        if (options.connect_only) {
+            connect_loop(session, endpoints, stats);
+            continue;
+        }
+
+        boost::asio::async_connect(session->socket, endpoints,
+            [session, i, &stats, &options](boost::system::error_code ec, const tcp::endpoint &) {
+                if (ec) {
+                    stats.failed++;
+                    return;
+                }
+                if (++stats.connected == options.sessions)
+                    stats.all_connected = std::chrono::steady_clock::now();
+
+                session->socket.set_option(tcp::no_delay(true));
+                if (session->player) {
+                    auto join = std::make_shared<std::string>("\0", 1);
+                    std::string name = "bot" + std::to_string(i);
+                    join->push_back((char) name.length());
+                    join->append(name);
+                    boost::asio::async_write(session->socket, boost::asio::buffer(*join),
+                                             [join](boost::system::error_code, size_t) {});
+                }
+                receive_loop(session, stats);
+            });
+    }
+
+    std::minstd_rand random(options.sessions);
+    boost::asio::steady_timer moves_timer(io_context, std::chrono::steady_clock::now());
+    if (options.move_interval > 0)
+        send_moves(moves_timer, sessions, random, options.move_interval);
+
+    boost::asio::steady_timer stop_timer(io_context, std::chrono::seconds(options.duration));
+    stop_timer.async_wait([&](boost::system::error_code) { io_context.stop(); });
+    io_context.run();
+
+    double elapsed = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - stats.start).count();
+    if (options.connect_only) {
+        std::cout << "connections: " << stats.connections << ", failed: " << stats.failed
+                  << ", " << (double) stats.connections / elapsed << " connections/s\n";
+        return 0;
+    }
+    std::cout << "connected: " << stats.connected << ", failed: " << stats.failed << "\n";
+    if (stats.connected == options.sessions) {
+        double connect_time = std::chrono::duration<double>(
+                stats.all_connected - stats.start).count();
+        std::cout << "all connected after " << connect_time << " s\n";
+    }
+    std::cout << "received " << stats.bytes_received << " bytes in " << elapsed << " s ("
+              << (double) stats.bytes_received / elapsed / 1e6 << " MB/s)\n";
+    return 0;
+}
@@ -1,213 +1,320 @@
-// Robots-server unfortunately is not finished.
-// It doesn't do much, but it's honest work.
+// Robots-server - groups players into rooms and plays their games,
+// sending every turn to all clients connected to the room.
 
 #include <iostream>
-#include <random>
+#include <thread>
 #include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <boost/asio.hpp>
 #include "options-parser.h"
 #include "definitions.h"
+#include "gateway-control.h"
 #include "message-serializer.h"
+#include "metrics.h"
+#include "matchmaker.h"
+#include "rate-limit.h"
+#include "server-backend.h"
+#include "trace.h"
 
 using boost::asio::ip::tcp;
 
-// This function initializes game based on given options.
-GameState initialize_game(ServerOptions &options, players_map_t &players) {
-    std::minstd_rand random(options.seed); // should be global
-
-    positions_set_t initial_blocks;
-    player_positions_map_t player_positions;
-    uint16_t block_x, block_y, player_x, player_y;
-    for (int i = 0; i < options.initial_blocks; i++) {
-        block_x =  (uint16_t) random() % options.size_x;
-        block_y = (uint16_t) random() % options.size_y;
-        initial_blocks.insert(Position(block_x, block_y));
-    }
-
-    for (auto &player: players) {
-        player_x = (uint16_t) random() % options.size_x;
-        player_y = (uint16_t) random() % options.size_y;
-        player_positions.insert(std::make_pair(player.first,
-                                               Position(player_x,player_y)));
-    }
-
-    return {players, initial_blocks, player_positions};
-}
-
 // This functions sends hello message to the client.
-void send_hello_message(ServerOptions &options, tcp::socket &socket) {
-    size_t msg_len = (options.server_name.length() + 5 * sizeof(uint16_t) + 3 * sizeof(uint8_t));
-    char hello_msg[msg_len];
-
-    serialize_hello_message(hello_msg, options);
-    boost::asio::write(socket, boost::asio::buffer(std::string(hello_msg, msg_len)));
+void send_hello_message(ServerOptions &options, Session &session) {
+    session.output.clear();
+    serialize_hello_message(session.output, options);
+    boost::asio::write(session.socket, boost::asio::buffer(session.output));
+    count_sent_message(session.output.data(), session.output.size());
 }
 
-// This functions sends accepted_player message to the client.
-void send_accepted_player(Player &player, uint8_t player_id, tcp::socket &socket) {
-
-    std::string name = player.name, address = player.address;
-    size_t msg_len = (name.length() + address.length()+ 4 * sizeof(uint8_t));
-    char accepted_player[msg_len];
-
-    serialize_accepted_player_message(accepted_player, name, address, player_id); // tu next id
-    boost::asio::write(socket, boost::asio::buffer(std::string(accepted_player, msg_len)));
+// This function returns client address in (address):(port) format.
+std::string get_client_address(tcp::socket &socket) {
+    std::string client_address = socket.remote_endpoint().address().to_string();
+    std::string c_port = std::to_string(socket.remote_endpoint().port());
+    client_address.append(":");
+    client_address.append(c_port);
+    return client_address;
 }
 
-// This functions calculates game_started message length.
-size_t get_game_started_len(players_map_t &players) {
-    size_t result = sizeof(uint8_t) + sizeof(uint32_t);
-
-    for (auto &player : players) {
-        result += 3 * sizeof(uint8_t); // id size + 2 sizes of strings
-        result += player.second.name.length();
-        result += player.second.address.length();
-    }
-
-    return result;
+// This function waits at most [timeout_ms] milliseconds for data from the client.
+static bool wait_for_data(tcp::socket &socket, int timeout_ms) {
+    pollfd fd{socket.native_handle(), POLLIN, 0};
+    return poll(&fd, 1, timeout_ms) > 0;
 }
 
-// This functions sends game_started to the client
-void send_game_started(players_map_t &players, tcp::socket &socket) {
-    size_t msg_len = get_game_started_len(players);
-    char game_started[msg_len];
-
-    serialize_game_started_message(game_started, players);
-    boost::asio::write(socket, boost::asio::buffer(std::string(game_started, msg_len)));
+// This function reads the client's address, which robots-gateway sends
+// before the client's bytes, as the server sees the gateway's address.
+// Other connections, which start with a client message, are left untouched.
+static void read_client_address(Session &session) {
+    uint8_t header[2];
+    if (!wait_for_data(session.socket, CAPABILITIES_WAIT_MS) ||
+        recv(session.socket.native_handle(), header, 1, MSG_PEEK) != 1 ||
+        header[0] != GATEWAY_CLIENT_ADDRESS)
+        return;
+    boost::asio::read(session.socket, boost::asio::buffer(header));
+    std::string address(header[1], '\0');
+    boost::asio::read(session.socket, boost::asio::buffer(address));
+    session.address = std::move(address);
 }
 
-// This functions calculates turn message length.
-size_t get_turn_len(events_list_t &events) {
-    size_t result = sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint32_t);
-    uint8_t id;
-
-    for (auto &event : events) {
-        id = event.event_id;
-        result += sizeof(uint8_t); // event id
-        switch ((EventType) id) {
-            case BombPlaced:
-                result += sizeof(BombId) + 2 * sizeof(uint16_t); // player id and position
-                break;
-            case BombExploded:
-                result += sizeof(BombId) + 2 * sizeof(uint32_t);
-                result += (event.blocks_destroyed.size()) * (2 * sizeof(uint16_t));
-                result += (event.robots_destroyed.size()) * (sizeof (PlayerId));
-                break;
-            case PlayerMoved:
-                result += sizeof(PlayerId) + 2 * sizeof(uint16_t); // player id and position
-                break;
-            case BlockPlaced:
-                result += 2 * sizeof(uint16_t); // position
-                break;
-        }
-    }
-    return result;
+// Lengths of client messages, Join - without the name.
+static const size_t CLIENT_MESSAGE_LENGTHS[CLIENT_MESSAGES_NUMBER] = {
+    2, 1, 1, 2, 2, SESSION_TOKEN_LENGTH
+};
+
+// This function counts a received message in metrics of the thread.
+static void count_received_message(uint8_t message_type, size_t length) {
+    ThreadMetrics &metrics = thread_metrics();
+    add_to_counter(metrics.messages_in[message_type]);
+    add_to_counter(metrics.bytes_in[message_type], length);
+    trace<TRACE_MESSAGES>(TraceEvent::ClientMessage, message_type, length);
 }
 
-// This functions sends turn message to the client.
-void send_turn(events_list_t &events, tcp::socket &socket) {
-    uint16_t next_id = 0;
-    size_t msg_len = get_turn_len(events);
-    char turn_msg[msg_len];
-
-    serialize_turn_message(turn_msg, events, next_id);
-    boost::asio::write(socket, boost::asio::buffer(std::string(turn_msg, msg_len)));
-}
-
-// This functions sends the first turn message to the client.
-void send_turn0(GameState &game_state, tcp::socket &socket) {
-    events_list_t events{};
-    for (auto player_pos : game_state.player_positions) {
-        Event event;
-        event.initialize_player_moved(player_pos.first, player_pos.second);
-        events.push_back(event);
+// This function receives messages from the client in an endless loop
+// and passes them to the matchmaker. Returns if the client sent an incorrect message
+// or kept exceeding the rate limits. Messages over the limits are skipped.
+// Clients using extensions send Capabilities (and ClientResume) right after
+// connecting, so the session is registered in a room after these messages,
+// once any other message comes or after a short wait.
+void receive_client_messages(ServerOptions &options, Matchmaker &matchmaker, const session_ptr_t &session) {
+    Buffer buffer(session->socket);
+    RateLimiter limiter(options.rate_limit_messages, options.rate_limit_bytes);
+    uint16_t port = session->socket.remote_endpoint().port(); // for tracing
+    bool registered = false;
+    if (!wait_for_data(session->socket, CAPABILITIES_WAIT_MS)) {
+        matchmaker.add_session(session);
+        registered = true;
     }
 
-    for (auto block : game_state.blocks) {
-        Event event;
-        event.initialize_block_placed(block);
-        events.push_back(event);
-    }
-    send_turn(events, socket);
-}
-
-// This function receives message from the client until it receives join request.
-Player wait_for_join(tcp::socket &socket, std::string &client_address) {
-    Buffer buffer(socket);
-
     while (true) {
         size_t message_size = buffer.receive_new_data();
-        if (debug) {
-            std::cerr << "received " << message_size <<
-                      " bytes from " << client_address << "\n";
-        }
+        trace<TRACE_IO>(TraceEvent::ReceivedFromClient, message_size, port);
+        limiter.refill();
 
-        uint8_t player_name_len, direction;
+        uint8_t player_name_len = 0, direction, capabilities;
+        uint64_t token;
         std::string player_name;
         while (buffer.get_parsed_len() < buffer.get_msg_len()) {
             uint8_t message_type = buffer.get_u8();
-            if (message_type >= CLIENT_MESSAGES_NUMBER)
-                std::cout << "disconnect client\n";
+            if (message_type >= CLIENT_MESSAGES_NUMBER) {
+                add_to_counter(thread_metrics().decode_errors);
+                return;
+            }
+
+            if (!registered && message_type != ClientCapabilities &&
+                message_type != ClientResume) {
+                matchmaker.add_session(session);
+                registered = true;
+            }
+
+            size_t message_length = CLIENT_MESSAGE_LENGTHS[message_type];
+            if (message_type == Join) {
+                player_name_len = buffer.get_u8();
+                message_length += player_name_len;
+            }
+            if (!limiter.allow(message_length)) {
+                buffer.skip(message_length - (message_type == Join ? 2 : 1));
+                add_to_counter(thread_metrics().rate_limited_messages);
+                if (limiter.exhausted()) {
+                    add_to_counter(thread_metrics().rate_limit_disconnects);
+                    return;
+                }
+                continue;
+            }
 
             switch ((ClientMessage) message_type) {
                 case Join:
-                    player_name_len = buffer.get_u8();
                     player_name = buffer.get_string(player_name_len);
-                    return {player_name, client_address}; // returning new player data
+                    count_received_message(message_type, message_length);
+                    matchmaker.join(session, player_name);
+                    break;
                 case ClientPlaceBomb:
+                    count_received_message(message_type, 1);
+                    matchmaker.set_action(session, {ClientPlaceBomb, 0});
                     break;
                 case ClientPlaceBlock:
+                    count_received_message(message_type, 1);
+                    matchmaker.set_action(session, {ClientPlaceBlock, 0});
                     break;
                 case ClientMove:
                     direction = buffer.get_u8();
-                    if (direction >= 4) exit(EXIT_FAILURE);
+                    if (direction >= DIRECTIONS_NUMBER) {
+                        add_to_counter(thread_metrics().decode_errors);
+                        return;
+                    }
+                    count_received_message(message_type, 2);
+                    matchmaker.set_action(session, {ClientMove, direction});
+                    break;
+                case ClientCapabilities:
+                    capabilities = buffer.get_u8();
+                    count_received_message(message_type, 2);
+                    matchmaker.set_capabilities(session, capabilities);
+                    break;
+                case ClientResume:
+                    token = buffer.get_u64();
+                    count_received_message(message_type, SESSION_TOKEN_LENGTH);
+                    if (!registered) {
+                        matchmaker.add_session(session, token);
+                        registered = true;
+                    }
                     break;
             }
         }
+
+        if (!registered) {
+            matchmaker.add_session(session);
+            registered = true;
+        }
     }
 }
 
 // This function handles client connection. It sends hello message
-// to the client and accepts him after receiving join request.
-// Starts game.
-void handle_client_connection(ServerOptions &options, tcp::socket &socket,
-                              std::string &client_address) {
-
-    players_map_t players{};
-    send_hello_message(options, socket);
-    Player new_player = wait_for_join(socket, client_address);
-    uint8_t player_id = 0;
-    send_accepted_player(new_player, player_id, socket);
-    players.insert(std::make_pair(player_id, new_player));
-    send_game_started(players, socket);
-
-    GameState game_state = initialize_game(options, players);
-    send_turn0(game_state, socket);
+// to the client, registers it in a room and receives its messages
+// until the client disconnects.
+void handle_client_connection(ServerOptions &options, Matchmaker &matchmaker, tcp::socket socket) {
+    session_ptr_t session;
+    server_gauges.connections++;
+
+    try {
+        socket.set_option(tcp::no_delay(true));
+        std::string client_address = get_client_address(socket);
+        session = std::make_shared<Session>(std::move(socket), client_address);
+
+        send_hello_message(options, *session);
+        if (!options.gateway_control.empty() &&
+            session->socket.remote_endpoint().address().is_loopback())
+            read_client_address(*session);
+        receive_client_messages(options, matchmaker, session);
+        if (debug) std::cerr << "disconnecting " << session->address << "\n";
+    }
+    catch (std::exception &e) {
+        if (debug) std::cerr << "client connection: " << e.what() << "\n";
+    }
+
+    if (session) matchmaker.remove_session(session);
+    server_gauges.connections--;
+}
+
+// This function reports the server's load to robots-gateway every GATEWAY_REPORT_MS.
+// Reports sent while the gateway isn't running are lost. Returns only
+// if the socket can't be created.
+void report_to_gateway(ServerOptions &options, Matchmaker &matchmaker) {
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "gateway control socket: " << strerror(errno) << "\n";
+        return;
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, options.gateway_control.c_str(), sizeof(address.sun_path) - 1);
+
+    BackendReport report{};
+    report.instance = options.instance;
+    report.port = options.port;
+    report.players_count = options.players_count;
+    std::vector<char> hello;
+    serialize_hello_message(hello, options);
+    report.hello.assign(hello.begin(), hello.end());
+
+    std::vector<char> datagram;
+    while (true) {
+        auto connections = server_gauges.connections.load(std::memory_order_relaxed);
+        auto sessions = server_gauges.sessions.load(std::memory_order_relaxed);
+        report.connections = (uint32_t) connections;
+        report.rooms = (uint32_t) server_gauges.rooms.load(std::memory_order_relaxed);
+        // clients not registered yet go to the filling room
+        report.lobby_sessions = (uint32_t) (matchmaker.lobby_sessions() +
+                                            (size_t) std::max<int64_t>(connections - sessions, 0));
+        serialize_backend_report(datagram, report);
+        sendto(fd, datagram.data(), datagram.size(), MSG_DONTWAIT, (sockaddr *) &address, sizeof(address));
+        std::this_thread::sleep_for(std::chrono::milliseconds(GATEWAY_REPORT_MS));
+    }
+}
+
+// This function opens a listening socket on a given port. With [reuse_port]
+// many sockets can listen on the same port and the kernel spreads
+// incoming connections across them.
+tcp::acceptor open_acceptor(boost::asio::io_context &io_context, uint16_t port, bool reuse_port) {
+    using reuse_port_option = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+    tcp::acceptor acceptor(io_context);
+    tcp::endpoint endpoint(tcp::v6(), port);
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(tcp::acceptor::reuse_address(true));
+    if (reuse_port) acceptor.set_option(reuse_port_option(true));
+    acceptor.bind(endpoint);
+    acceptor.listen();
+    return acceptor;
 }
 
-// Main function - handles simple connection with the client
+// Main function - accepts clients, every client is handled by a separate
+// thread, every room runs in another one. With --accept-threads N
+// connections are accepted by N threads, each with its own socket.
 int main(int argc, char *argv[]) {
     ServerOptions options;
     options.seed = (uint32_t) time(nullptr);
     if (!check_server_options(options, argc, argv)) exit(EXIT_FAILURE);
+
+    std::unique_ptr<NetworkBackend> backend = create_backend(options.backend);
+    if (!backend) {
+        std::cerr << "backend " << options.backend << " is not available\n";
+        exit(EXIT_FAILURE);
+    }
     std::cout << "listening on port " << options.port << "\n";
 
     try {
+        if (!options.trace_file.empty()) start_trace_file(options.trace_file);
         boost::asio::io_context io_context;
-        tcp::acceptor acceptor(io_context, tcp::endpoint(tcp::v6(), options.port));
+        std::vector<tcp::acceptor> acceptors;
+        for (uint16_t i = 0; i < options.accept_threads; i++)
+            acceptors.push_back(open_acceptor(io_context, options.port, options.accept_threads > 1));
+
+        std::unique_ptr<Leaderboard> leaderboard;
+        if (!options.leaderboard.empty())
+            leaderboard = std::make_unique<Leaderboard>(options.leaderboard);
 
-        tcp::socket socket(io_context);
-        acceptor.accept(socket);
-        std::string client_address = socket.remote_endpoint().address().to_string();
-        std::string c_port = std::to_string(socket.remote_endpoint().port());
-        client_address.append(":");
-        client_address.append(c_port);
+        std::unique_ptr<EventExport> event_export;
+        if (!options.export_file.empty())
+            event_export = std::make_unique<EventExport>(options.export_file);
 
-        handle_client_connection(options, socket, client_address);
+        std::unique_ptr<CheckpointStore> checkpoints;
+        if (!options.checkpoint_file.empty())
+            checkpoints = std::make_unique<CheckpointStore>(options.checkpoint_file, options);
+
+        Matchmaker matchmaker(options, leaderboard.get(), event_export.get(), checkpoints.get());
+
+        if (!options.gateway_control.empty())
+            std::thread(report_to_gateway, std::ref(options), std::ref(matchmaker)).detach();
+
+        boost::asio::io_context metrics_context;
+        std::optional<tcp::acceptor> metrics_acceptor;
+        if (options.metrics_port != 0) {
+            metrics_acceptor.emplace(metrics_context, tcp::endpoint(
+                boost::asio::ip::address_v4::loopback(), options.metrics_port));
+            std::thread(serve_metrics, std::ref(metrics_context), std::ref(*metrics_acceptor)).detach();
+        }
+
+        accept_handler_t on_accept = [&](tcp::socket socket) {
+            std::thread(handle_client_connection, std::ref(options),
+                        std::ref(matchmaker), std::move(socket)).detach();
+        };
+        for (size_t i = 1; i < acceptors.size(); i++) {
+            std::thread([&backend, &acceptor = acceptors[i], &on_accept] {
+                try {
+                    backend->accept_loop(acceptor, on_accept);
+                }
+                catch (std::exception &e) {
+                    std::cerr << e.what() << '\n';
+                }
+            }).detach();
+        }
+        backend->accept_loop(acceptors[0], on_accept);
     }
     catch (std::exception &e) {
         std::cerr << e.what() << '\n';
     }
     return 0;
-}
\ No newline at end of file
+}
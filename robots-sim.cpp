@@ -0,0 +1,251 @@
+// Robots-sim - plays many games between bots in-process, with the server's
+// game rules and no networking, and prints aggregate statistics.
+// Meant for balancing bomb timer, explosion radius and initial blocks.
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "options-parser.h"
+#include "definitions.h"
+#include "game-rules.h"
+#include "event-export.h"
+
+// Statistics summed over games.
+struct SimStats {
+    uint64_t games = 0;
+    uint64_t deaths = 0;
+    uint64_t kills = 0; // robots destroyed by another player's bomb
+    uint64_t suicides = 0;
+    uint64_t bombs = 0;
+    uint64_t blocks_destroyed = 0;
+    uint64_t blocks_left = 0; // at the end of the game
+    uint64_t score_spread = 0; // the highest score minus the lowest one
+    uint64_t tied_games = 0; // games won by more than one player
+
+    void add(const SimStats &other) {
+        games += other.games;
+        deaths += other.deaths;
+        kills += other.kills;
+        suicides += other.suicides;
+        bombs += other.bombs;
+        blocks_destroyed += other.blocks_destroyed;
+        blocks_left += other.blocks_left;
+        score_spread += other.score_spread;
+        tied_games += other.tied_games;
+    }
+};
+
+// State of a bomber bot - it places a bomb and runs away to a cell
+// which no bomb would reach, then waits until its bomb explodes.
+struct BomberState {
+    uint16_t turns_to_explosion = 0;
+    uint8_t direction = Up;
+};
+
+// This function chooses a random action - mostly moves, sometimes bombs and blocks.
+static std::optional<PlayerAction> random_bot(std::minstd_rand &random) {
+    switch (random() % 10) {
+        case 0: return PlayerAction{ClientPlaceBomb, 0};
+        case 1: return PlayerAction{ClientPlaceBlock, 0};
+        case 8:
+        case 9: return {};
+        default: return PlayerAction{ClientMove, (uint8_t) (random() % DIRECTIONS_NUMBER)};
+    }
+}
+
+// This function returns the neighbour of a cell in a given direction,
+// or nothing if it is off the board or blocked.
+static std::optional<Position> neighbour(Position position, uint8_t direction, ServerGame &game,
+                                        ServerOptions &options) {
+    int x = position.x, y = position.y;
+    switch ((Direction) direction) {
+        case Up: y++; break;
+        case Right: x++; break;
+        case Down: y--; break;
+        case Left: x--; break;
+    }
+    if (x < 0 || y < 0 || x >= options.size_x || y >= options.size_y) return {};
+    Position target((uint16_t) x, (uint16_t) y);
+    if (game.state.blocks.contains(target)) return {};
+    return target;
+}
+
+// This function chooses the action of a bomber bot. While in danger it moves
+// to a safe neighbouring cell if there is one, otherwise it keeps running
+// in its direction, turning when it can't go on.
+static std::optional<PlayerAction> bomber_bot(BomberState &bot, Position position, ServerGame &game,
+                                              ServerOptions &options, std::minstd_rand &random) {
+    if (bot.turns_to_explosion == 0) {
+        bot.turns_to_explosion = options.bomb_timer;
+        bot.direction = (uint8_t) (random() % DIRECTIONS_NUMBER);
+        return PlayerAction{ClientPlaceBomb, 0};
+    }
+
+    bot.turns_to_explosion--;
+    if (!game.footprints.in_danger(position)) return {};
+
+    for (uint8_t direction = 0; direction < DIRECTIONS_NUMBER; direction++) {
+        auto target = neighbour(position, direction, game, options);
+        if (target.has_value() && !game.footprints.in_danger(*target))
+            return PlayerAction{ClientMove, direction};
+    }
+    if (!neighbour(position, bot.direction, game, options).has_value())
+        bot.direction = (uint8_t) ((bot.direction + 1 + random() % 3) % DIRECTIONS_NUMBER);
+    return PlayerAction{ClientMove, bot.direction};
+}
+
+// This function counts deaths, kills and destroyed blocks of a turn.
+// A robot destroyed by a few bombs at once dies once, like in scores.
+static void count_turn(events_list_t &events, SimStats &stats) {
+    player_id_set_t destroyed{};
+    for (auto &event : events) {
+        if (event.event_id == (uint8_t) EventType::BombPlaced) stats.bombs++;
+        if (event.event_id != (uint8_t) EventType::BombExploded) continue;
+
+        stats.blocks_destroyed += event.blocks_destroyed.size();
+        for (auto robot : event.robots_destroyed) {
+            if (!destroyed.insert(robot).second) continue;
+            if (robot == event.player_id) stats.suicides++;
+            else stats.kills++;
+        }
+    }
+    stats.deaths += destroyed.size();
+}
+
+// This function plays game [game_nr] and adds its statistics, and its events
+// to [exported] if they are exported. [game] and [strings] are reused
+// by the thread's games, like by a server's room.
+static void play_game(SimOptions &options, uint32_t game_nr, ServerGame &game, StringTable &strings,
+                      SimStats &stats, EventColumns *exported) {
+    ServerOptions &rules = options.game;
+    uint32_t seed = rules.seed + game_nr;
+    std::minstd_rand random(seed);
+    std::minstd_rand bots_random(seed ^ 0x5bd1e995);
+
+    players_map_t players;
+    for (uint16_t id = 0; id < rules.players_count; id++)
+        players.insert(std::make_pair((PlayerId) id, Player(strings, "bot" + std::to_string(id), "sim")));
+
+    events_list_t events = start_game(game, rules, players, random);
+    if (exported) exported->add_turn(game_nr, 0, events);
+    std::vector<BomberState> bombers(rules.players_count);
+    actions_table_t actions{};
+    bool bomber = options.bot == "bomber";
+
+    for (uint16_t turn = 1; turn <= rules.game_length; turn++) {
+        for (auto &player : players) {
+            PlayerId id = player.first;
+            actions[id] = bomber ? bomber_bot(bombers[id], game.state.player_positions.at(id), game,
+                                              rules, bots_random)
+                                 : random_bot(bots_random);
+        }
+        events = play_turn(game, rules, actions, random);
+        count_turn(events, stats);
+        if (exported) exported->add_turn(game_nr, turn, events);
+    }
+
+    Score lowest = UINT32_MAX, highest = 0;
+    for (auto &player_and_score : game.state.scores) {
+        lowest = std::min(lowest, player_and_score.second);
+        highest = std::max(highest, player_and_score.second);
+    }
+    size_t winners = (size_t) std::count_if(game.state.scores.begin(), game.state.scores.end(),
+                                            [lowest](auto &score) { return score.second == lowest; });
+    stats.games++;
+    stats.blocks_left += game.state.blocks.size();
+    stats.score_spread += highest - lowest;
+    if (winners > 1) stats.tied_games++;
+}
+
+// This function prints statistics, averaged per game or per player and game.
+static void print_stats(SimOptions &options, SimStats &stats, double seconds) {
+    auto games = (double) std::max(stats.games, (uint64_t) 1);
+    auto player_games = games * options.game.players_count;
+    std::pair<const char *, double> values[] = {
+        {"games", (double) stats.games},
+        {"games_per_second", (double) stats.games / seconds},
+        {"deaths_per_player", (double) stats.deaths / player_games},
+        {"kills_per_player", (double) stats.kills / player_games},
+        {"suicides_per_player", (double) stats.suicides / player_games},
+        {"bombs_per_game", (double) stats.bombs / games},
+        {"blocks_destroyed_per_game", (double) stats.blocks_destroyed / games},
+        {"blocks_left", (double) stats.blocks_left / games},
+        {"score_spread", (double) stats.score_spread / games},
+        {"tied_games_share", (double) stats.tied_games / games},
+    };
+
+    std::cout << std::fixed << std::setprecision(3);
+    if (options.csv) {
+        std::cout << "bomb_timer,explosion_radius,initial_blocks";
+        for (auto &value : values) std::cout << "," << value.first;
+        std::cout << "\n" << options.game.bomb_timer << "," << options.game.explosion_radius
+                  << "," << options.game.initial_blocks;
+        for (auto &value : values) std::cout << "," << value.second;
+        std::cout << "\n";
+        return;
+    }
+    for (auto &value : values)
+        std::cout << std::left << std::setw(28) << value.first << value.second << "\n";
+}
+
+// Main function - games are numbered and taken by the threads one by one,
+// game i is played with seed + i, so results don't depend on the number of threads.
+// Exported events are written in groups by the threads, when they have enough.
+// If writing them fails, the threads stop taking games and the program fails.
+int main(int argc, char *argv[]) {
+    SimOptions options;
+    options.game.seed = (uint32_t) time(nullptr);
+    if (!check_sim_options(options, argc, argv)) exit(EXIT_FAILURE);
+
+    unsigned threads_count = options.threads != 0 ? options.threads :
+                             std::max(std::thread::hardware_concurrency(), 1u);
+    std::atomic<uint32_t> next_game{0};
+    std::vector<SimStats> thread_stats(threads_count);
+    std::vector<std::thread> threads;
+    std::unique_ptr<EventExport> event_export;
+    std::atomic<bool> export_failed{false};
+    try {
+        if (!options.export_file.empty())
+            event_export = std::make_unique<EventExport>(options.export_file);
+    }
+    catch (std::system_error &e) {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < threads_count; i++) {
+        threads.emplace_back([&, i] {
+            SimStats stats;
+            StringTable strings;
+            ServerGame game;
+            EventColumns exported;
+            EventColumns *exported_ptr = event_export ? &exported : nullptr;
+            try {
+                for (uint32_t game_nr = next_game++; game_nr < options.games; game_nr = next_game++) {
+                    play_game(options, game_nr, game, strings, stats, exported_ptr);
+                    if (exported.size() >= EXPORT_GROUP_ROWS) event_export->write_group(exported);
+                }
+                if (event_export) event_export->write_group(exported);
+            }
+            catch (std::system_error &e) {
+                if (!export_failed.exchange(true)) std::cerr << e.what() << "\n";
+                next_game = options.games;
+            }
+            thread_stats[i] = stats;
+        });
+    }
+
+    SimStats stats;
+    for (unsigned i = 0; i < threads_count; i++) {
+        threads[i].join();
+        stats.add(thread_stats[i]);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (export_failed) exit(EXIT_FAILURE);
+
+    print_stats(options, stats, elapsed.count());
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Robots-trace - decodes a trace file written by robots-client or robots-server
+// with --trace-file, printing records of all threads ordered by time.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "options-parser.h"
+#include "trace.h"
+
+int main(int argc, char *argv[]) {
+    TraceOptions options;
+    if (!check_trace_options(options, argc, argv)) exit(EXIT_FAILURE);
+
+    std::ifstream file(options.file, std::ios::binary);
+    if (!file) {
+        std::cerr << "can't open " << options.file << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    TraceFileHeader header{};
+    file.read((char *) &header, sizeof(header));
+    if (!file || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord) ||
+        header.ticks_per_ns <= 0) {
+        std::cerr << options.file << " is not a trace file\n";
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<TraceRecord> records;
+    TraceRecord record{};
+    while (file.read((char *) &record, sizeof(record)))
+        records.push_back(record);
+    if (records.empty()) return 0;
+
+    // records of every thread are in order already
+    std::stable_sort(records.begin(), records.end(), [](const TraceRecord &a, const TraceRecord &b) {
+        return a.time < b.time;
+    });
+
+    uint64_t start = records.front().time;
+    for (auto &r : records) {
+        double time_us = (double) (r.time - start) / header.ticks_per_ns / 1000.0;
+        std::cout << std::fixed << std::setprecision(3) << std::setw(12) << time_us
+                  << " us  thread " << r.thread << "  ";
+        const char *name = trace_event_name(r.event);
+        if (name) std::cout << name;
+        else std::cout << "event " << r.event;
+
+        size_t args = name ? trace_event_args(r.event) : TRACE_ARGS;
+        for (size_t i = 0; i < args; i++)
+            std::cout << " " << r.args[i];
+        std::cout << "\n";
+    }
+    return 0;
+}
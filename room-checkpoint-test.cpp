@@ -0,0 +1,277 @@
+// Tests of room checkpoints - a parsed checkpoint gives the same game,
+// which goes on exactly like the original one, clients see its bombs' timers
+// as documented, malformed checkpoints are rejected and the store recovers
+// the latest checkpoint of every room.
+
+#include <cstdio>
+#include <filesystem>
+#include <unistd.h>
+#include "game-handler.h"
+#include "game-rules.h"
+#include "message-serializer.h"
+#include "room-checkpoint.h"
+#include "test-utils.h"
+
+static ServerOptions test_rules() {
+    ServerOptions rules{};
+    rules.bomb_timer = 4;
+    rules.players_count = 6;
+    rules.explosion_radius = 2;
+    rules.initial_blocks = 80;
+    rules.game_length = 300;
+    rules.size_x = 17;
+    rules.size_y = 13;
+    return rules;
+}
+
+static void random_actions(actions_table_t &actions, uint8_t players_count, std::minstd_rand &random) {
+    actions = {};
+    for (size_t id = 0; id < players_count; id++) {
+        switch (random() % 5) {
+            case 0: actions[id] = PlayerAction{ClientPlaceBomb, 0}; break;
+            case 1: actions[id] = PlayerAction{ClientPlaceBlock, 0}; break;
+            case 2: break;
+            default: actions[id] = PlayerAction{ClientMove, (uint8_t) (random() % DIRECTIONS_NUMBER)};
+        }
+    }
+}
+
+static bool same_bombs(const bombs_map_t &a, const bombs_map_t &b) {
+    if (a.size() != b.size()) return false;
+    for (auto &[id, bomb] : a) {
+        auto it = b.find(id);
+        if (it == b.end() || !(it->second.position == bomb.position) ||
+            it->second.timer != bomb.timer || it->second.owner != bomb.owner)
+            return false;
+    }
+    return true;
+}
+
+static bool same_state(const GameState &a, const GameState &b) {
+    if (a.players.size() != b.players.size()) return false;
+    for (auto &[id, player] : a.players.get()) {
+        auto it = b.players.get().find(id);
+        if (it == b.players.end() || it->second.name.view() != player.name.view() ||
+            it->second.address.view() != player.address.view())
+            return false;
+    }
+    return a.turn == b.turn && a.player_positions.get() == b.player_positions.get() &&
+           a.blocks.get() == b.blocks.get() && a.explosions.get() == b.explosions.get() &&
+           a.scores.get() == b.scores.get() && same_bombs(a.bombs.get(), b.bombs.get());
+}
+
+// Checkpoints a game every few turns and resumes every checkpoint
+// in a second game, which then has to follow the first one.
+static void test_round_trip() {
+    ServerOptions rules = test_rules();
+    StringTable strings;
+    std::minstd_rand random(17), actions_random(23);
+
+    players_map_t players;
+    for (uint16_t id = 0; id < rules.players_count; id++) {
+        // names of all lengths a checkpoint can hold
+        std::string name(id == 0 ? 0 : id == 1 ? UINT8_MAX : id * 10, (char) ('a' + id));
+        players.insert(std::make_pair((PlayerId) id, Player(strings, name, "10.0.0." + std::to_string(id))));
+    }
+    std::map<uint64_t, PlayerId> session_tokens = {{0, 0}, {UINT64_MAX, 5}, {0x123456789abcdefull, 2}};
+
+    ServerGame game;
+    start_game(game, rules, players, random);
+    actions_table_t actions{};
+    std::vector<char> checkpoint;
+    for (uint16_t turn = 1; turn <= rules.game_length; turn++) {
+        random_actions(actions, rules.players_count, actions_random);
+        if (turn % 37 == 0) {
+            serialize_checkpoint(checkpoint, game.state, game.next_bomb_id, random, session_tokens,
+                                 actions, rules.players_count);
+            StringTable resumed_strings;
+            RoomCheckpoint parsed;
+            CHECK(parse_checkpoint({checkpoint.data(), checkpoint.size()}, parsed, resumed_strings));
+            CHECK(same_state(parsed.state, game.state));
+            CHECK(parsed.next_bomb_id == game.next_bomb_id);
+            CHECK(parsed.random == random);
+            CHECK(parsed.session_tokens == session_tokens);
+            bool same_actions = true;
+            for (size_t id = 0; id <= UINT8_MAX; id++) {
+                same_actions = same_actions && parsed.actions[id].has_value() == actions[id].has_value() &&
+                               (!actions[id] || (parsed.actions[id]->type == actions[id]->type &&
+                                                 parsed.actions[id]->direction == actions[id]->direction));
+            }
+            CHECK(same_actions);
+
+            // the resumed game plays the next turns like the original one
+            ServerGame resumed;
+            restore_game(resumed, rules, parsed.state, parsed.next_bomb_id);
+            ServerGame original = game;
+            std::minstd_rand original_random = random;
+            std::minstd_rand lookahead_random = actions_random;
+            actions_table_t resumed_actions = parsed.actions, original_actions = actions;
+            for (int i = 0; i < 20; i++) {
+                play_turn(original, rules, original_actions, original_random);
+                play_turn(resumed, rules, resumed_actions, parsed.random);
+                random_actions(original_actions, rules.players_count, lookahead_random);
+                resumed_actions = original_actions;
+            }
+            CHECK(same_state(resumed.state, original.state));
+            CHECK(resumed.next_bomb_id == original.next_bomb_id);
+        }
+        play_turn(game, rules, actions, random);
+    }
+}
+
+// Returns a buffer of an unconnected socket, parsing only [message] after its type.
+static std::unique_ptr<Buffer> message_buffer(boost::asio::ip::tcp::socket &socket,
+                                              const std::vector<char> &message, bool compact) {
+    auto buffer = std::make_unique<Buffer>(socket);
+    buffer->insert_data(message.data() + 1, message.size() - 1);
+    buffer->set_compact(compact);
+    return buffer;
+}
+
+// A resumed game's snapshot has the bombs' remaining timers, clients replaying
+// the game see the restored bombs placed again, with the full timer.
+static void test_resumed_bombs() {
+    ServerOptions rules = test_rules();
+    StringTable strings;
+    std::minstd_rand random(9);
+    players_map_t players;
+    for (uint16_t id = 0; id < rules.players_count; id++)
+        players.insert(std::make_pair((PlayerId) id, Player(strings, "player", "address")));
+    ServerGame game;
+    start_game(game, rules, players, random);
+    actions_table_t actions{};
+    bool partly_ticked = false;
+    while (!partly_ticked) {
+        random_actions(actions, rules.players_count, random);
+        play_turn(game, rules, actions, random);
+        for (auto &bomb : game.state.bombs)
+            partly_ticked = partly_ticked || bomb.second.timer < rules.bomb_timer;
+    }
+
+    std::vector<char> checkpoint;
+    serialize_checkpoint(checkpoint, game.state, game.next_bomb_id, random, {}, actions,
+                         rules.players_count);
+    RoomCheckpoint parsed;
+    CHECK(parse_checkpoint({checkpoint.data(), checkpoint.size()}, parsed, strings));
+    ServerGame resumed;
+    events_list_t events = restore_game(resumed, rules, parsed.state, parsed.next_bomb_id);
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    for (bool compact : {false, true}) {
+        std::vector<char> snapshot;
+        serialize_game_snapshot_message(snapshot, resumed.state, compact);
+        GameState state;
+        read_game_snapshot(*message_buffer(socket, snapshot, compact), state, strings);
+        CHECK(state.bombs.size() == game.state.bombs.size());
+        for (auto &[id, bomb] : game.state.bombs)
+            CHECK(state.bombs.contains(id) && state.bombs.at(id).timer == bomb.timer);
+    }
+
+    std::vector<char> turn;
+    serialize_turn_message(turn, events, resumed.state.turn);
+    GameParameters params("", rules.players_count, rules.size_x, rules.size_y, rules.game_length,
+                          rules.explosion_radius, rules.bomb_timer);
+    GameState replayed;
+    aggregate_game_state(*message_buffer(socket, turn, false), replayed, params);
+    CHECK(replayed.bombs.size() == game.state.bombs.size());
+    for (auto &[id, bomb] : game.state.bombs) {
+        CHECK(replayed.bombs.contains(id) && replayed.bombs.at(id).position == bomb.position &&
+              replayed.bombs.at(id).timer == rules.bomb_timer);
+    }
+}
+
+static void test_malformed_checkpoints() {
+    ServerOptions rules = test_rules();
+    StringTable strings;
+    std::minstd_rand random(5);
+    players_map_t players;
+    for (uint16_t id = 0; id < rules.players_count; id++)
+        players.insert(std::make_pair((PlayerId) id, Player(strings, "player", "address")));
+    ServerGame game;
+    start_game(game, rules, players, random);
+    actions_table_t actions{};
+    for (int turn = 0; turn < 30; turn++) {
+        random_actions(actions, rules.players_count, random);
+        play_turn(game, rules, actions, random);
+    }
+    std::vector<char> checkpoint;
+    serialize_checkpoint(checkpoint, game.state, game.next_bomb_id, random, {{1, 1}}, actions,
+                         rules.players_count);
+    CHECK(!game.state.bombs.get().empty());
+
+    RoomCheckpoint parsed;
+    for (size_t len = 0; len < checkpoint.size(); len++)
+        CHECK(!parse_checkpoint({checkpoint.data(), len}, parsed, strings));
+    checkpoint.push_back(0);
+    CHECK(!parse_checkpoint({checkpoint.data(), checkpoint.size()}, parsed, strings));
+    checkpoint.pop_back();
+    CHECK(parse_checkpoint({checkpoint.data(), checkpoint.size()}, parsed, strings));
+
+    // an action of an unknown type
+    actions = {};
+    actions[0] = PlayerAction{(ClientMessage) CLIENT_MESSAGES_NUMBER, 0};
+    serialize_checkpoint(checkpoint, game.state, game.next_bomb_id, random, {}, actions,
+                         rules.players_count);
+    CHECK(!parse_checkpoint({checkpoint.data(), checkpoint.size()}, parsed, strings));
+
+    // corrupted bytes are either rejected or parsed as another game
+    for (int i = 0; i < 2000; i++) {
+        std::vector<char> corrupted = checkpoint;
+        corrupted[random() % corrupted.size()] = (char) random();
+        RoomCheckpoint any;
+        parse_checkpoint({corrupted.data(), corrupted.size()}, any, strings);
+    }
+}
+
+static void test_store() {
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("room-checkpoint-test-" + std::to_string(getpid()))).string();
+    ServerOptions rules = test_rules();
+    std::vector<char> first(100, 'a'), second(2000, 'b'), third(10, 'c'), cleared(50, 'd');
+    {
+        CheckpointStore store(path, rules);
+        CHECK(store.take_recovered().empty());
+        std::vector<char> checkpoint = first;
+        store.submit(3, checkpoint);
+        checkpoint = second;
+        store.submit(3, checkpoint); // replaces the first one, written or not
+        checkpoint = third;
+        store.submit(0, checkpoint);
+        checkpoint = cleared;
+        store.submit(7, checkpoint);
+        store.clear(7);
+    }
+    {
+        CheckpointStore store(path, rules);
+        auto recovered = store.take_recovered();
+        CHECK(recovered.size() == 2);
+        CHECK(recovered[3] == second);
+        CHECK(recovered[0] == third);
+        CHECK(store.take_recovered().empty());
+
+        std::vector<char> checkpoint = first;
+        store.submit(3, checkpoint);
+    }
+    {
+        CheckpointStore store(path, rules);
+        auto recovered = store.take_recovered();
+        CHECK(recovered.size() == 2 && recovered[3] == first);
+    }
+
+    // checkpoints of games with other rules are discarded
+    rules.size_x++;
+    {
+        CheckpointStore store(path, rules);
+        CHECK(store.take_recovered().empty());
+    }
+    std::remove(path.c_str());
+}
+
+int main() {
+    test_round_trip();
+    test_resumed_bombs();
+    test_malformed_checkpoints();
+    test_store();
+    return test_result();
+}
@@ -0,0 +1,349 @@
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "room-checkpoint.h"
+
+// Helper function - throws std::system_error for the last failed system call.
+static void throw_errno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+template<typename T>
+static void put(std::vector<char> &buffer, T value) {
+    buffer.insert(buffer.end(), (char *) &value, (char *) &value + sizeof(T));
+}
+
+static void put_position(std::vector<char> &buffer, Position position) {
+    put(buffer, position.x);
+    put(buffer, position.y);
+}
+
+void serialize_checkpoint(std::vector<char> &buffer, const GameState &state, BombId next_bomb_id,
+                          const std::minstd_rand &random,
+                          const std::map<uint64_t, PlayerId> &session_tokens,
+                          const actions_table_t &actions, uint8_t players_count) {
+    buffer.clear();
+    put(buffer, state.turn);
+    put(buffer, next_bomb_id);
+    std::stringstream random_state;
+    random_state << random;
+    put(buffer, (uint32_t) std::stoul(random_state.str()));
+
+    put(buffer, (uint8_t) session_tokens.size());
+    for (auto &token : session_tokens) {
+        put(buffer, token.first);
+        put(buffer, token.second);
+    }
+
+    put(buffer, (uint8_t) state.players.size());
+    for (auto &player : state.players) {
+        put(buffer, player.first);
+        buffer.insert(buffer.end(), player.second.name.encoded().begin(), player.second.name.encoded().end());
+        buffer.insert(buffer.end(), player.second.address.encoded().begin(),
+                      player.second.address.encoded().end());
+        auto position_it = state.player_positions.find(player.first);
+        put_position(buffer, position_it != state.player_positions.end() ? position_it->second : Position(0, 0));
+        auto score_it = state.scores.find(player.first);
+        put(buffer, score_it != state.scores.end() ? score_it->second : (Score) 0);
+    }
+
+    uint8_t actions_count = 0;
+    for (size_t player = 0; player < players_count; player++)
+        actions_count += actions[player].has_value();
+    put(buffer, actions_count);
+    for (size_t player = 0; player < players_count; player++) {
+        if (!actions[player].has_value()) continue;
+        put(buffer, (PlayerId) player);
+        put(buffer, (uint8_t) actions[player]->type);
+        put(buffer, actions[player]->direction);
+    }
+
+    put(buffer, (uint32_t) state.blocks.size());
+    for (auto block : state.blocks) put_position(buffer, block);
+    put(buffer, (uint32_t) state.explosions.size());
+    for (auto explosion : state.explosions) put_position(buffer, explosion);
+    put(buffer, (uint32_t) state.bombs.size());
+    for (auto &bomb : state.bombs) {
+        put(buffer, bomb.first);
+        put_position(buffer, bomb.second.position);
+        put(buffer, bomb.second.timer);
+        put(buffer, bomb.second.owner);
+    }
+}
+
+bool parse_checkpoint(std::string_view data, RoomCheckpoint &checkpoint, StringTable &strings) {
+    size_t position = 0;
+    bool malformed = false;
+    auto get_bytes = [&](size_t len) -> const char * {
+        if (malformed || data.size() - position < len) {
+            malformed = true;
+            return nullptr;
+        }
+        position += len;
+        return data.data() + position - len;
+    };
+    auto get = [&]<typename T>(T &value) {
+        const char *bytes = get_bytes(sizeof(T));
+        if (bytes) memcpy(&value, bytes, sizeof(T));
+        else value = {};
+    };
+    auto get_string = [&]() -> std::string_view {
+        uint8_t len;
+        get(len);
+        const char *bytes = get_bytes(len);
+        return bytes ? std::string_view(bytes, len) : std::string_view();
+    };
+    auto get_position = [&]() {
+        Position pos{};
+        get(pos.x);
+        get(pos.y);
+        return pos;
+    };
+
+    GameState &state = checkpoint.state;
+    state = {};
+    get(state.turn);
+    get(checkpoint.next_bomb_id);
+    uint32_t random_state;
+    get(random_state);
+    checkpoint.random.seed(random_state);
+
+    uint8_t tokens_count;
+    get(tokens_count);
+    for (uint8_t i = 0; i < tokens_count; i++) {
+        uint64_t token;
+        PlayerId player_id;
+        get(token);
+        get(player_id);
+        checkpoint.session_tokens[token] = player_id;
+    }
+
+    uint8_t players_count;
+    get(players_count);
+    for (uint8_t i = 0; i < players_count; i++) {
+        PlayerId player_id;
+        get(player_id);
+        std::string_view name = get_string();
+        std::string_view address = get_string();
+        state.players.write().insert(std::make_pair(player_id, Player(strings, name, address)));
+        state.player_positions.write().insert(std::make_pair(player_id, get_position()));
+        Score score;
+        get(score);
+        state.scores.write().insert(std::make_pair(player_id, score));
+    }
+
+    uint8_t actions_count;
+    get(actions_count);
+    checkpoint.actions = {};
+    for (uint8_t i = 0; i < actions_count; i++) {
+        PlayerId player_id;
+        uint8_t type, direction;
+        get(player_id);
+        get(type);
+        get(direction);
+        if (type >= CLIENT_MESSAGES_NUMBER || direction >= DIRECTIONS_NUMBER) return false;
+        checkpoint.actions[player_id] = PlayerAction{(ClientMessage) type, direction};
+    }
+
+    uint32_t count;
+    get(count);
+    for (uint32_t i = 0; i < count && !malformed; i++) state.blocks.write().insert(get_position());
+    get(count);
+    for (uint32_t i = 0; i < count && !malformed; i++) state.explosions.write().insert(get_position());
+    get(count);
+    for (uint32_t i = 0; i < count && !malformed; i++) {
+        BombId bomb_id;
+        get(bomb_id);
+        Bomb bomb;
+        bomb.position = get_position();
+        get(bomb.timer);
+        get(bomb.owner);
+        state.bombs.write().insert(std::make_pair(bomb_id, bomb));
+    }
+    return !malformed && position == data.size();
+}
+
+// Returns the FNV-1a hash of a checkpoint, to tell a torn write from a complete one.
+static uint32_t checksum(const char *data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t) data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns the largest checkpoint of a game with given rules.
+static size_t max_checkpoint_length(ServerOptions &options) {
+    size_t players = options.players_count;
+    size_t cells = (size_t) options.size_x * options.size_y;
+    size_t blocks = std::min(cells, options.initial_blocks + players * options.game_length);
+    size_t bombs = players * ((size_t) options.bomb_timer + 1);
+    size_t explosions = std::min(cells, bombs * (4 * (size_t) options.explosion_radius + 1));
+    return 64 + players * (sizeof(uint64_t) + 1) +
+           players * (1 + 2 * (UINT8_MAX + 1) + 2 * sizeof(uint16_t) + sizeof(Score)) +
+           players * 3 + (blocks + explosions) * 2 * sizeof(uint16_t) +
+           bombs * (sizeof(BombId) + 3 * sizeof(uint16_t) + 1);
+}
+
+CheckpointStore::CheckpointStore(const std::string &path, ServerOptions &options) {
+    half_size = sizeof(CheckpointHalf) + max_checkpoint_length(options);
+    half_size = (half_size + CHECKPOINT_HEADER_SIZE - 1) / CHECKPOINT_HEADER_SIZE * CHECKPOINT_HEADER_SIZE;
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) throw_errno("open " + path);
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) < 0) throw_errno("fstat " + path);
+    file_size = (size_t) file_stat.st_size;
+
+    mapping_size = CHECKPOINT_HEADER_SIZE + 2 * half_size * CHECKPOINT_MAX_ROOMS;
+    void *new_mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (new_mapping == MAP_FAILED) throw_errno("mmap " + path);
+    mapping = (char *) new_mapping;
+
+    CheckpointHeader expected;
+    memset(&expected, 0, sizeof(expected)); // compared with padding
+    memcpy(expected.magic, CHECKPOINT_MAGIC, sizeof(expected.magic));
+    expected.version = CHECKPOINT_VERSION;
+    expected.half_size = (uint32_t) half_size;
+    expected.size_x = options.size_x;
+    expected.size_y = options.size_y;
+    expected.game_length = options.game_length;
+    expected.bomb_timer = options.bomb_timer;
+    expected.explosion_radius = options.explosion_radius;
+    expected.initial_blocks = options.initial_blocks;
+    expected.players_count = options.players_count;
+
+    if (file_size >= CHECKPOINT_HEADER_SIZE && memcmp(mapping, &expected, sizeof(expected)) == 0) {
+        read_slots(path);
+    }
+    else {
+        if (file_size > 0) std::cerr << path << " has checkpoints of other games, discarding them\n";
+        // slots are zeroed, so no half of them has a checkpoint
+        if (ftruncate(fd, 0) < 0 || ftruncate(fd, CHECKPOINT_HEADER_SIZE) < 0) throw_errno("ftruncate " + path);
+        file_size = CHECKPOINT_HEADER_SIZE;
+        memcpy(mapping, &expected, sizeof(expected));
+    }
+
+    writer = std::thread([this] { write_loop(); });
+}
+
+CheckpointStore::~CheckpointStore() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    submitted.notify_one();
+    writer.join();
+    munmap(mapping, mapping_size);
+    close(fd);
+}
+
+// Reads the latest complete checkpoint of every room.
+void CheckpointStore::read_slots(const std::string &path) {
+    size_t rooms = std::min((file_size - CHECKPOINT_HEADER_SIZE) / (2 * half_size),
+                            (size_t) CHECKPOINT_MAX_ROOMS);
+    slots.resize(rooms);
+    for (size_t room = 0; room < rooms; room++) {
+        Slot &slot = slots[room];
+        for (int half_nr = 0; half_nr < 2; half_nr++) {
+            auto &header = *(CheckpointHalf *) half((uint16_t) room, half_nr);
+            uint64_t sequence = header.sequence.load(std::memory_order_acquire);
+            const char *data = (char *) &header + sizeof(CheckpointHalf);
+            if (sequence <= slot.sequence || header.length > half_size - sizeof(CheckpointHalf) ||
+                checksum(data, header.length) != header.checksum)
+                continue;
+            slot.sequence = sequence;
+            slot.latest = half_nr;
+        }
+
+        if (slot.latest < 0) continue;
+        auto &header = *(CheckpointHalf *) half((uint16_t) room, slot.latest);
+        const char *data = (char *) &header + sizeof(CheckpointHalf);
+        if (header.length > 0) recovered.emplace((uint16_t) room, std::vector<char>(data, data + header.length));
+    }
+
+    if (!recovered.empty())
+        std::cerr << "recovered " << recovered.size() << " games from " << path << "\n";
+}
+
+// Writes a checkpoint into the older half of a room's slot. The sequence
+// number is stored last, so the half counts only once it is complete.
+void CheckpointStore::write_slot(uint16_t room, const std::vector<char> &checkpoint) {
+    if (checkpoint.size() > half_size - sizeof(CheckpointHalf)) {
+        std::cerr << "room " << room << ": checkpoint of " << checkpoint.size() << " bytes doesn't fit\n";
+        return;
+    }
+
+    size_t slot_end = CHECKPOINT_HEADER_SIZE + ((size_t) room + 1) * 2 * half_size;
+    if (file_size < slot_end) {
+        if (ftruncate(fd, (off_t) slot_end) < 0) {
+            std::cerr << "checkpoint file: " << strerror(errno) << "\n";
+            return;
+        }
+        file_size = slot_end;
+    }
+    if (slots.size() <= room) slots.resize((size_t) room + 1);
+
+    Slot &slot = slots[room];
+    int half_nr = slot.latest == 0 ? 1 : 0;
+    char *start = half(room, half_nr);
+    auto &header = *(CheckpointHalf *) start;
+    memcpy(start + sizeof(CheckpointHalf), checkpoint.data(), checkpoint.size());
+    header.length = (uint32_t) checkpoint.size();
+    header.checksum = checksum(checkpoint.data(), checkpoint.size());
+    header.sequence.store(++slot.sequence, std::memory_order_release);
+    slot.latest = half_nr;
+
+    // the page cache already survives a crash of the server, this gets it to the disk
+    msync(start, half_size, MS_ASYNC);
+}
+
+void CheckpointStore::write_loop() {
+    std::vector<uint16_t> rooms;
+    std::vector<char> checkpoint;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        submitted.wait(lock, [this] { return !queue.empty() || stopping; });
+        if (queue.empty()) return;
+
+        rooms.swap(queue);
+        for (uint16_t room : rooms) {
+            pending[room].checkpoint.swap(checkpoint);
+            pending[room].queued = false;
+            lock.unlock();
+            write_slot(room, checkpoint);
+            lock.lock();
+        }
+        rooms.clear();
+    }
+}
+
+void CheckpointStore::submit(uint16_t room, std::vector<char> &checkpoint) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.size() <= room) pending.resize((size_t) room + 1);
+        pending[room].checkpoint.swap(checkpoint);
+        if (pending[room].queued) return;
+        pending[room].queued = true;
+        queue.push_back(room);
+    }
+    submitted.notify_one();
+}
+
+void CheckpointStore::clear(uint16_t room) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.size() <= room) pending.resize((size_t) room + 1);
+        pending[room].checkpoint.clear();
+        if (pending[room].queued) return;
+        pending[room].queued = true;
+        queue.push_back(room);
+    }
+    submitted.notify_one();
+}
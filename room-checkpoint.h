@@ -0,0 +1,131 @@
+#ifndef BOMBOWE_ROBOTY_ROOM_CHECKPOINT_H
+#define BOMBOWE_ROBOTY_ROOM_CHECKPOINT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "definitions.h"
+#include "options-parser.h"
+#include "string-table.h"
+
+/*
+Checkpoints of games in progress, so a restarted server resumes them instead
+of losing them. Every checkpoint_interval turns a room's sender thread
+serializes the game state, the room's random generator, session tokens and
+actions waiting for the next turn, and submits them to the store. A writer
+thread copies the latest submitted checkpoint of every room into the room's
+slot of a file mapped into memory; the room never waits for it, a newer
+checkpoint simply replaces one not written yet.
+
+Every slot has two halves written in turns, each with a sequence number and
+a checksum, so a crash in the middle of writing one leaves the other.
+A half of length 0 marks a room without a game. The size of a half is
+bounded by the game rules in the header, so the file doesn't depend on the
+number of games played, and recovery reads one slot per room. A file
+written with other rules is discarded. Like the leaderboard, the file uses
+the host's byte order and address space for all rooms is mapped once.
+*/
+
+#define CHECKPOINT_MAGIC            "ROBOTSCP"
+#define CHECKPOINT_VERSION          1
+#define CHECKPOINT_HEADER_SIZE      4096
+#define CHECKPOINT_MAX_ROOMS        (UINT16_MAX + 1)
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t half_size; // bytes of a slot half, with its header
+    uint16_t size_x;
+    uint16_t size_y;
+    uint16_t game_length;
+    uint16_t bomb_timer;
+    uint16_t explosion_radius;
+    uint16_t initial_blocks;
+    uint8_t players_count;
+};
+
+struct CheckpointHalf {
+    std::atomic<uint64_t> sequence; // 0 - never written
+    uint32_t length; // of the checkpoint after the header, 0 - no game
+    uint32_t checksum;
+};
+
+// A game in progress read from a checkpoint.
+struct RoomCheckpoint {
+    GameState state;
+    BombId next_bomb_id = 0;
+    std::minstd_rand random;
+    std::map<uint64_t, PlayerId> session_tokens;
+    actions_table_t actions{}; // for the turn after the state's one
+};
+
+// Serializes a checkpoint of a game in progress into [buffer], replacing its contents.
+void serialize_checkpoint(std::vector<char> &buffer, const GameState &state, BombId next_bomb_id,
+                          const std::minstd_rand &random,
+                          const std::map<uint64_t, PlayerId> &session_tokens,
+                          const actions_table_t &actions, uint8_t players_count);
+
+// Parses a checkpoint, interning players' names and addresses in [strings].
+// Returns false if it is malformed.
+bool parse_checkpoint(std::string_view data, RoomCheckpoint &checkpoint, StringTable &strings);
+
+class CheckpointStore {
+private:
+    int fd;
+    char *mapping = nullptr;
+    size_t mapping_size = 0;
+    size_t half_size;
+    size_t file_size; // used only by the writer after construction
+
+    // The writer's view of a slot - which half to write next and its sequence.
+    struct Slot {
+        uint64_t sequence = 0;
+        int latest = -1; // half with the latest checkpoint, -1 if none
+    };
+    std::vector<Slot> slots;
+    std::map<uint16_t, std::vector<char>> recovered;
+
+    struct Pending {
+        std::vector<char> checkpoint;
+        bool queued = false;
+    };
+    std::mutex mutex;
+    std::condition_variable submitted;
+    std::vector<Pending> pending; // indexed by room id
+    std::vector<uint16_t> queue; // rooms with a pending checkpoint
+    bool stopping = false;
+    std::thread writer;
+
+    char *half(uint16_t room, int half_nr) {
+        return mapping + CHECKPOINT_HEADER_SIZE + ((size_t) room * 2 + (size_t) half_nr) * half_size;
+    }
+    void read_slots(const std::string &path);
+    void write_slot(uint16_t room, const std::vector<char> &checkpoint);
+    void write_loop();
+
+public:
+    // Opens or creates the checkpoint file and reads checkpoints left in it.
+    // Throws std::system_error if the file can't be used.
+    CheckpointStore(const std::string &path, ServerOptions &options);
+    ~CheckpointStore();
+
+    CheckpointStore(const CheckpointStore &) = delete;
+    CheckpointStore &operator=(const CheckpointStore &) = delete;
+
+    // Returns checkpoints found on start by room id, once.
+    std::map<uint16_t, std::vector<char>> take_recovered() { return std::move(recovered); }
+
+    // Queues a room's checkpoint for writing. Its memory is swapped with
+    // the room's previous one, which the caller may reuse.
+    void submit(uint16_t room, std::vector<char> &checkpoint);
+
+    // Marks the room as having no game.
+    void clear(uint16_t room);
+};
+
+#endif //BOMBOWE_ROBOTY_ROOM_CHECKPOINT_H
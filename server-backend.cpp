@@ -0,0 +1,358 @@
+#include <iostream>
+#include "server-backend.h"
+
+#ifdef ROBOTS_IO_URING
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using boost::asio::ip::tcp;
+
+void AsioBackend::send_batch(outgoing_batch_t &batch) {
+    for (auto &message : batch) {
+        boost::system::error_code ec;
+        boost::asio::write(*message.socket,
+                           boost::asio::buffer(message.data, message.length), ec);
+        if (ec) message.failed = true;
+    }
+}
+
+void AsioBackend::accept_loop(tcp::acceptor &acceptor, const accept_handler_t &on_accept) {
+    while (true) {
+        tcp::socket socket(acceptor.get_executor());
+        acceptor.accept(socket);
+        on_accept(std::move(socket));
+    }
+}
+
+#ifdef ROBOTS_IO_URING
+
+// A minimal io_uring wrapper using raw system calls.
+// A ring is used by a single thread only.
+class UringRing {
+private:
+    int ring_fd;
+    unsigned sq_entries;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_sqe *sqes;
+    io_uring_cqe *cqes;
+    unsigned to_submit = 0;
+
+public:
+    explicit UringRing(unsigned entries) {
+        io_uring_params params{};
+        ring_fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+        if (ring_fd < 0)
+            throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+
+        sq_entries = params.sq_entries;
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) sq_size = cq_size = std::max(sq_size, cq_size);
+
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        cq_ptr = single_mmap ? sq_ptr :
+                 mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        sqes = (io_uring_sqe *) mmap(nullptr, sq_entries * sizeof(io_uring_sqe),
+                                     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                     ring_fd, IORING_OFF_SQES);
+        if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "io_uring mmap");
+
+        auto sq = (char *) sq_ptr, cq = (char *) cq_ptr;
+        sq_head = (unsigned *) (sq + params.sq_off.head);
+        sq_tail = (unsigned *) (sq + params.sq_off.tail);
+        sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+        sq_array = (unsigned *) (sq + params.sq_off.array);
+        cq_head = (unsigned *) (cq + params.cq_off.head);
+        cq_tail = (unsigned *) (cq + params.cq_off.tail);
+        cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+    }
+
+    UringRing(const UringRing &) = delete;
+    UringRing &operator=(const UringRing &) = delete;
+
+    ~UringRing() {
+        munmap(sqes, sq_entries * sizeof(io_uring_sqe));
+        if (cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+        munmap(sq_ptr, sq_size);
+        close(ring_fd);
+    }
+
+    [[nodiscard]] unsigned capacity() const { return sq_entries; }
+
+    // Returns a cleared submission entry, nullptr if the queue is full.
+    io_uring_sqe *get_sqe() {
+        unsigned tail = *sq_tail;
+        if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+            return nullptr;
+
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(io_uring_sqe));
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        to_submit++;
+        return sqe;
+    }
+
+    // Submits all prepared entries with one system call
+    // and waits for at least [wait_nr] completions.
+    void submit_and_wait(unsigned wait_nr) {
+        while (true) {
+            long ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_nr,
+                               IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret >= 0) {
+                to_submit -= (unsigned) ret;
+                return;
+            }
+            if (errno != EINTR)
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+        }
+    }
+
+    // Calls [handler] for every available completion entry.
+    template<typename Handler>
+    void for_each_completion(Handler handler) {
+        unsigned head = *cq_head;
+        while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            handler(cqes[head & *cq_mask]);
+            head++;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    void register_buffer(void *data, size_t length) {
+        iovec iov{data, length};
+        if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+            throw std::system_error(errno, std::generic_category(), "io_uring_register");
+    }
+
+    void unregister_buffers() {
+        syscall(__NR_io_uring_register, ring_fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    }
+};
+
+// io_uring backend. Payloads of a batch are copied once into a registered
+// buffer (a broadcast message is copied only once) and written to all
+// sockets with fixed-buffer writes, submitted together. A write to a full
+// socket is retried once a poll request reports the socket writable.
+// Connections are accepted with a single multishot accept request,
+// or by the asio backend if the kernel doesn't support it.
+class UringBackend : public NetworkBackend {
+private:
+    static constexpr unsigned RING_ENTRIES = 1024;
+    static constexpr size_t INITIAL_ARENA_SIZE = 1 << 16;
+    static constexpr uint64_t POLL_REQUEST = 1ull << 63; // in user_data of poll requests
+    static constexpr size_t NO_MESSAGE = SIZE_MAX;
+
+    UringRing send_ring{RING_ENTRIES};
+    std::vector<char> arena;
+
+    // Per-message progress of a batch, reused between batches.
+    struct Progress {
+        size_t offset; // payload offset in the arena
+        size_t sent;
+        size_t previous; // the previous message to the same socket, or NO_MESSAGE
+        bool in_flight;
+        bool wait_writable; // the last write returned EAGAIN
+    };
+    std::vector<Progress> progress;
+    std::vector<size_t> order; // messages of a batch, sorted by payload or by socket
+
+    bool finished(const outgoing_batch_t &batch, size_t i) const {
+        return batch[i].failed || progress[i].sent == batch[i].length;
+    }
+
+    void reserve_arena(size_t size) {
+        if (size <= arena.size() && !arena.empty()) return;
+
+        send_ring.unregister_buffers();
+        arena = std::vector<char>(std::max({size, 2 * arena.size(), INITIAL_ARENA_SIZE}));
+        send_ring.register_buffer(arena.data(), arena.size());
+    }
+
+public:
+    UringBackend() {
+        reserve_arena(INITIAL_ARENA_SIZE);
+    }
+
+    void send_batch(outgoing_batch_t &batch) override {
+        // copy distinct payloads into the registered arena - messages are sorted
+        // by payload, so one sent with a few lengths, e.g. with a prefix of it,
+        // is copied once, whole
+        progress.resize(batch.size());
+        order.resize(batch.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&batch](size_t a, size_t b) {
+            return std::less<const char *>()(batch[a].data, batch[b].data);
+        });
+        // calls visit(first, last, length) on every run of [order] with one payload
+        auto for_each_payload = [&](auto &&visit) {
+            size_t first = 0;
+            while (first < order.size()) {
+                size_t last = first, length = 0;
+                const char *data = batch[order[first]].data;
+                for (; last < order.size() && batch[order[last]].data == data; last++)
+                    length = std::max(length, batch[order[last]].length);
+                visit(first, last, length);
+                first = last;
+            }
+        };
+        size_t arena_size = 0;
+        for_each_payload([&](size_t first, size_t last, size_t length) {
+            for (size_t j = first; j < last; j++)
+                progress[order[j]].offset = arena_size;
+            arena_size += length;
+        });
+        reserve_arena(arena_size);
+        for_each_payload([&](size_t first, size_t, size_t length) {
+            memcpy(arena.data() + progress[order[first]].offset, batch[order[first]].data, length);
+        });
+
+        // messages to a socket are written in order, each after the previous one
+        std::sort(order.begin(), order.end(), [&batch](size_t a, size_t b) {
+            if (batch[a].socket != batch[b].socket)
+                return std::less<tcp::socket *>()(batch[a].socket, batch[b].socket);
+            return a < b;
+        });
+        size_t unfinished = 0;
+        for (size_t j = 0; j < order.size(); j++) {
+            size_t i = order[j];
+            bool follows = j > 0 && batch[order[j - 1]].socket == batch[i].socket;
+            progress[i] = {progress[i].offset, 0, follows ? order[j - 1] : NO_MESSAGE, false, false};
+            if (!batch[i].failed && batch[i].length > 0) unfinished++;
+        }
+
+        while (unfinished > 0) {
+            // queue the first unfinished message of every socket
+            unsigned queued = 0;
+            for (size_t i = 0; i < batch.size(); i++) {
+                OutgoingMessage &message = batch[i];
+                size_t previous = progress[i].previous;
+                if (finished(batch, i) || progress[i].in_flight ||
+                    (previous != NO_MESSAGE && !finished(batch, previous)))
+                    continue;
+
+                int fd = message.socket->native_handle();
+
+                io_uring_sqe *sqe = send_ring.get_sqe();
+                if (sqe == nullptr) break;
+                if (progress[i].wait_writable) {
+                    sqe->opcode = IORING_OP_POLL_ADD;
+                    sqe->fd = fd;
+                    sqe->poll32_events = POLLOUT;
+                    sqe->user_data = i | POLL_REQUEST;
+                }
+                else {
+                    sqe->opcode = IORING_OP_WRITE_FIXED;
+                    sqe->fd = fd;
+                    sqe->addr = (uint64_t) (arena.data() + progress[i].offset + progress[i].sent);
+                    sqe->len = (uint32_t) (message.length - progress[i].sent);
+                    sqe->buf_index = 0;
+                    sqe->user_data = i;
+                }
+                progress[i].in_flight = true;
+                queued++;
+            }
+
+            send_ring.submit_and_wait(queued);
+            unsigned completed = 0;
+            while (completed < queued) {
+                send_ring.for_each_completion([&](io_uring_cqe &cqe) {
+                    size_t i = cqe.user_data & ~POLL_REQUEST;
+                    Progress &p = progress[i];
+                    OutgoingMessage &message = batch[i];
+                    p.in_flight = false;
+                    completed++;
+
+                    if (cqe.user_data & POLL_REQUEST) {
+                        p.wait_writable = false;
+                        // a socket with an error is reported writable, the write fails then
+                        if (cqe.res >= 0 || cqe.res == -EINTR) return;
+                        message.failed = true;
+                    }
+                    else if (cqe.res == -EAGAIN) {
+                        p.wait_writable = true;
+                        return;
+                    }
+                    else if (cqe.res == -EINTR) {
+                        return;
+                    }
+                    else if (cqe.res <= 0) {
+                        message.failed = true;
+                    }
+                    else {
+                        p.sent += (size_t) cqe.res;
+                    }
+
+                    if (message.failed || p.sent == message.length) unfinished--;
+                });
+                if (completed < queued) send_ring.submit_and_wait(queued - completed);
+            }
+        }
+    }
+
+    void accept_loop(tcp::acceptor &acceptor, const accept_handler_t &on_accept) override {
+        UringRing accept_ring(64);
+        bool armed = false;
+        bool unsupported = false;
+
+        while (!unsupported) {
+            if (!armed) {
+                io_uring_sqe *sqe = accept_ring.get_sqe();
+                if (sqe != nullptr) {
+                    sqe->opcode = IORING_OP_ACCEPT;
+                    sqe->fd = acceptor.native_handle();
+                    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+                    armed = true;
+                }
+            }
+
+            accept_ring.submit_and_wait(1);
+            accept_ring.for_each_completion([&](io_uring_cqe &cqe) {
+                // the request has to be submitted again if the kernel stopped it
+                if (!(cqe.flags & IORING_CQE_F_MORE)) armed = false;
+                // kernels before 5.19 reject multishot accept
+                if (cqe.res == -EINVAL) {
+                    unsupported = true;
+                    return;
+                }
+                if (cqe.res < 0) {
+                    std::cerr << "accept: " << strerror(-cqe.res) << "\n";
+                    return;
+                }
+
+                tcp::socket socket(acceptor.get_executor());
+                socket.assign(acceptor.local_endpoint().protocol(), cqe.res);
+                on_accept(std::move(socket));
+            });
+        }
+
+        std::cerr << "multishot accept is not supported, accepting with asio\n";
+        AsioBackend().accept_loop(acceptor, on_accept);
+    }
+};
+
+#endif // ROBOTS_IO_URING
+
+std::unique_ptr<NetworkBackend> create_backend(const std::string &name) {
+    if (name == "asio") return std::make_unique<AsioBackend>();
+#ifdef ROBOTS_IO_URING
+    if (name == "io_uring") return std::make_unique<UringBackend>();
+#endif
+    return nullptr;
+}
@@ -0,0 +1,51 @@
+#ifndef BOMBOWE_ROBOTY_SERVER_BACKEND_H
+#define BOMBOWE_ROBOTY_SERVER_BACKEND_H
+
+#include <functional>
+#include <memory>
+#include <boost/asio.hpp>
+
+/*
+Networking backends of robots-server. The backend accepts new connections
+and writes per-tick batches of messages to clients' sockets.
+Reading from sockets is done by session threads and doesn't depend on it.
+*/
+
+// A single message to be written to a socket.
+// [failed] is set by the backend if the message couldn't be written.
+struct OutgoingMessage {
+    boost::asio::ip::tcp::socket *socket;
+    const char *data;
+    size_t length;
+    bool failed = false;
+};
+
+using outgoing_batch_t = std::vector<OutgoingMessage>;
+using accept_handler_t = std::function<void(boost::asio::ip::tcp::socket)>;
+
+class NetworkBackend {
+public:
+    virtual ~NetworkBackend() = default;
+
+    // Writes every message of the batch and returns when all of them are
+    // written. Messages to the same socket are written in batch order.
+    virtual void send_batch(outgoing_batch_t &batch) = 0;
+
+    // Accepts connections in an endless loop, calls [on_accept] for each one.
+    virtual void accept_loop(boost::asio::ip::tcp::acceptor &acceptor,
+                             const accept_handler_t &on_accept) = 0;
+};
+
+// Default backend - one blocking write per message.
+class AsioBackend : public NetworkBackend {
+public:
+    void send_batch(outgoing_batch_t &batch) override;
+    void accept_loop(boost::asio::ip::tcp::acceptor &acceptor,
+                     const accept_handler_t &on_accept) override;
+};
+
+// Returns a backend with a given name ("asio" or "io_uring"),
+// nullptr if there is no such backend in this build.
+std::unique_ptr<NetworkBackend> create_backend(const std::string &name);
+
+#endif //BOMBOWE_ROBOTY_SERVER_BACKEND_H
@@ -0,0 +1,444 @@
+#include <thread>
+#include "server-room.h"
+#include "message-serializer.h"
+#include "metrics.h"
+#include "trace.h"
+
+Room::Room(ServerOptions &options, std::unique_ptr<NetworkBackend> backend, Leaderboard *leaderboard,
+           EventExport *event_export, CheckpointStore *checkpoints, RoomListener &listener, uint16_t id):
+        options(options), backend(std::move(backend)), leaderboard(leaderboard), event_export(event_export),
+        checkpoints(checkpoints), listener(listener),
+        random(options.seed + id),
+        grid(options.size_x, options.size_y, options.interest_radius, options.explosion_radius,
+             player_id_bits(options.players_count)),
+        id_bits(player_id_bits(options.players_count)), id(id) {
+    server_gauges.rooms++;
+}
+
+// Sends the prepared batch. Sockets that failed are shut down,
+// so their sessions' threads finish and remove them.
+void Room::send_batch() {
+    for (auto &message : batch)
+        count_sent_message(message.data, message.length);
+    server_gauges.outgoing_batch.store((int64_t) batch.size(), std::memory_order_relaxed);
+    backend->send_batch(batch);
+
+    for (auto &message : batch) {
+        if (!message.failed) continue;
+        boost::system::error_code ec;
+        message.socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    }
+}
+
+// Returns a Compressed message with a given message inside, placed in
+// the compressor's buffer. Returns the message itself if it is shorter
+// than the compression threshold or doesn't get shorter.
+std::string_view Room::compress_message(Lz4Compressor &compressor, std::string_view message) {
+    if (message.size() < options.compression_threshold) return message;
+
+    size_t compressed_len = compressor.compress(message.data(), message.size(),
+                                                COMPRESSED_HEADER_LENGTH);
+    if (compressed_len + COMPRESSED_HEADER_LENGTH >= message.size()) return message;
+
+    char *header = compressor.data();
+    ServerMessage msg_type = Compressed;
+    put_data_into_buffer(header, &msg_type, sizeof(uint8_t));
+    uint32_t original_len = htonl((uint32_t) message.size());
+    put_data_into_buffer(header, &original_len, sizeof(uint32_t));
+    uint32_t compressed_len_to_send = htonl((uint32_t) compressed_len);
+    put_data_into_buffer(header, &compressed_len_to_send, sizeof(uint32_t));
+
+    return {compressor.data(), compressed_len + COMPRESSED_HEADER_LENGTH};
+}
+
+// Helper function - returns a view of a serialized message.
+static std::string_view view(const std::vector<char> &message) {
+    return {message.data(), message.size()};
+}
+
+// Sends a message to a single session, compressed if it negotiated compression.
+void Room::send_to_session(Session &session, std::string_view message) {
+    if (session.compression) message = compress_message(session.compressor, message);
+    batch.clear();
+    batch.push_back({&session.socket, message.data(), message.size()});
+    send_batch();
+}
+
+// Sends a message to all sessions, in the encoding negotiated by each of them.
+// Every encoding is compressed at most once.
+void Room::send_to_all(std::string_view message, std::string_view compact_message) {
+    std::optional<std::string_view> compressed[2];
+
+    batch.clear();
+    for (auto &session : sessions) {
+        std::string_view encoded = session->compact ? compact_message : message;
+        if (session->compression) {
+            auto &compressed_encoded = compressed[session->compact];
+            if (!compressed_encoded.has_value())
+                compressed_encoded = compress_message(compressors[session->compact], encoded);
+            encoded = *compressed_encoded;
+        }
+        batch.push_back({&session->socket, encoded.data(), encoded.size()});
+    }
+    send_batch();
+}
+
+
+// Sends a turn to all sessions. With area of interest filtering every
+// player gets only events near their robot, observers get all events.
+// [state] is the game state after the turn.
+void Room::send_turn(events_list_t &events, GameState &state) {
+    uint16_t turn_nr = state.turn;
+    size_t turn_start = history.size();
+    serialize_turn_message(history, events, turn_nr);
+    std::string_view plain_turn(history.data() + turn_start, history.size() - turn_start);
+    auto start = std::chrono::steady_clock::now();
+
+    if (options.interest_radius == 0) {
+        compact_turn.clear();
+        if (options.compact_encoding)
+            serialize_compact_turn_message(compact_turn, events, turn_nr, id_bits);
+        send_to_all(plain_turn, view(compact_turn));
+    }
+    else {
+        if (turn_nr == 0) {
+            // blocks get to the players when their cells are revealed
+            std::erase_if(events, [](Event &event) {
+                return event.event_id == (uint8_t) EventType::BlockPlaced;
+            });
+        }
+        serialize_event_fragments(events, fragments);
+        if (options.compact_encoding)
+            serialize_compact_event_fragments(events, compact_fragments, id_bits);
+        grid.index(events); // both encodings have the same fragment indices
+
+        batch.clear();
+        for (auto &session : sessions) {
+            if (!session->player_id.has_value() && !session->compact) {
+                std::string_view turn = plain_turn;
+                if (session->compression) turn = compress_message(session->compressor, turn);
+                batch.push_back({&session->socket, turn.data(), turn.size()});
+                continue;
+            }
+            Position center = session->player_id.has_value() ?
+                              state.player_positions.at(*session->player_id) : Position(0, 0);
+            uint16_t radius = session->player_id.has_value() ?
+                              options.interest_radius : std::max(options.size_x, options.size_y);
+
+            grid.build_turn(session->filtered_turn, turn_nr,
+                            session->compact ? compact_fragments : fragments, center,
+                            radius, session->interest, state, session->compact);
+            std::string_view turn = view(session->filtered_turn);
+            if (session->compression) turn = compress_message(session->compressor, turn);
+            batch.push_back({&session->socket, turn.data(), turn.size()});
+        }
+        send_batch();
+    }
+
+    send_time += std::chrono::steady_clock::now() - start;
+    turns_sent++;
+}
+
+// The sender thread's loop - sends turns handed over by the room's thread.
+void Room::send_turns() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        output_changed.wait(lock, [this] { return output.pending; });
+        send_turn(output.events, output.state);
+        if (output.checkpoint) write_checkpoint();
+        output.pending = false;
+        output_changed.notify_all();
+    }
+}
+
+// Waits until the sender thread has sent the turn handed over last.
+void Room::wait_for_output(std::unique_lock<std::mutex> &lock) {
+    output_changed.wait(lock, [this] { return !output.pending; });
+}
+
+// Hands a played turn over to the sender thread, after it has sent the previous one.
+// The events' memory is swapped with the previous turn's, the output state shares
+// the game state's containers, so the next turn copies only those it changes.
+void Room::hand_over_turn(std::unique_lock<std::mutex> &lock, events_list_t &events) {
+    wait_for_output(lock);
+    output.events.swap(events);
+    output.state = game.state;
+    output.checkpoint = checkpoints && output.state.turn % options.checkpoint_interval == 0;
+    if (output.checkpoint) {
+        output.next_bomb_id = game.next_bomb_id;
+        output.random = random;
+        actions.peek_actions(output.actions, options.players_count);
+    }
+    output.pending = true;
+    output_changed.notify_all();
+}
+
+// Gives the player to a returning session. The previous session
+// of the player, if still connected, is disconnected.
+void Room::resume_player(const session_ptr_t &session, PlayerId player_id) {
+    for (auto &other : sessions) {
+        if (other == session || other->player_id != player_id) continue;
+        other->set_player({});
+        boost::system::error_code ec;
+        other->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    }
+    session->set_player(player_id);
+
+    if (debug) {
+        std::cerr << session->address << " resumed player " << (int) player_id <<
+                  " in turn " << output.state.turn << "\n";
+    }
+}
+
+void Room::add_session(const session_ptr_t &session, std::optional<uint64_t> token) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // the session gets the state after the turn being sent, not that turn
+    wait_for_output(lock);
+    sessions.push_back(session);
+    server_gauges.sessions++;
+
+    auto token_it = token.has_value() ? session_tokens.find(*token) : session_tokens.end();
+    if (token_it != session_tokens.end()) resume_player(session, token_it->second);
+
+    if (game_in_progress && session->negotiated) {
+        session->output.clear();
+        serialize_game_snapshot_message(session->output, output.state, session->compact);
+        send_to_session(*session, view(session->output));
+        if (options.interest_radius != 0) grid.synchronize(session->interest, output.state);
+    }
+    else if (game_in_progress) {
+        // only sessions which negotiated capabilities use compression,
+        // so the history is sent as it is, in a single write
+        batch.clear();
+        batch.push_back({&session->socket, history.data(), history.size()});
+        send_batch();
+    }
+    else {
+        for (auto &player : players) {
+            session->output.clear();
+            serialize_accepted_player_message(session->output, player.second, player.first);
+            send_to_session(*session, view(session->output));
+        }
+    }
+}
+
+void Room::remove_session(const session_ptr_t &session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::erase(sessions, session) > 0) server_gauges.sessions--;
+}
+
+bool Room::join(const session_ptr_t &session, std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (session->player_id.has_value()) return true;
+    if (game_in_progress || players.size() >= options.players_count) return false;
+
+    if (players.empty()) first_join = std::chrono::steady_clock::now();
+    auto player_id = (PlayerId) players.size();
+    Player player(strings, name, session->address);
+    players.insert(std::make_pair(player_id, player));
+    session->set_player(player_id);
+    message.clear();
+    serialize_accepted_player_message(message, player, player_id);
+    send_to_all(view(message), view(message));
+
+    if (session->reconnect) {
+        uint64_t token = ((uint64_t) id << TOKEN_ROOM_SHIFT) |
+                         ((uint64_t) options.instance << TOKEN_INSTANCE_SHIFT) |
+                         (token_random() >> (64 - TOKEN_INSTANCE_SHIFT));
+        session_tokens[token] = player_id;
+
+        char token_msg[SESSION_TOKEN_LENGTH];
+        serialize_session_token_message(token_msg, token);
+        send_to_session(*session, {token_msg, SESSION_TOKEN_LENGTH});
+    }
+
+    lobby_full.notify_one();
+    return true;
+}
+
+void Room::set_capabilities(const session_ptr_t &session, uint8_t capabilities) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!options.compact_encoding) capabilities &= ~CAPABILITY_COMPACT_ENCODING;
+    if (!options.compression) capabilities &= ~CAPABILITY_COMPRESSION;
+    capabilities &= CAPABILITY_COMPACT_ENCODING | CAPABILITY_COMPRESSION | CAPABILITY_RECONNECT;
+
+    char capabilities_msg[2] = {(char) Capabilities, (char) capabilities};
+    batch.clear();
+    batch.push_back({&session->socket, capabilities_msg, 2});
+    send_batch();
+
+    // messages after the answer are in the agreed encoding
+    session->compact = capabilities & CAPABILITY_COMPACT_ENCODING;
+    session->compression = capabilities & CAPABILITY_COMPRESSION;
+    session->reconnect = capabilities & CAPABILITY_RECONNECT;
+    session->negotiated = true;
+}
+
+size_t Room::lobby_sessions() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return game_in_progress ? 0 : sessions.size();
+}
+
+void Room::set_action(const session_ptr_t &session, PlayerAction action) {
+    int player_id = session->acting_player.load(std::memory_order_acquire);
+    if (player_id >= 0) actions.publish((PlayerId) player_id, action); // only the last action counts
+}
+
+// This function gathers events of a turn for the export file, writing them
+// when there are enough for a group. Rows of a game are kept for later
+// games, so every group is full. Called without the mutex.
+void Room::export_events(uint32_t export_game, uint16_t turn, events_list_t &events) {
+    exported_events.add_turn(export_game, turn, events);
+    if (exported_events.size() >= EXPORT_GROUP_ROWS) write_exported_events();
+}
+
+// This function writes gathered events, the game goes on if it fails.
+void Room::write_exported_events() {
+    try {
+        event_export->write_group(exported_events);
+    }
+    catch (std::system_error &e) {
+        std::cerr << "room " << id << ": " << e.what() << "\n";
+    }
+}
+
+// This function writes a checkpoint of the turn in the output. Called by the sender
+// thread, the checkpoint is serialized into memory and written by the store's thread.
+void Room::write_checkpoint() {
+    serialize_checkpoint(checkpoint, output.state, output.next_bomb_id, output.random,
+                         session_tokens, output.actions, options.players_count);
+    checkpoints->submit(id, checkpoint);
+}
+
+bool Room::recover(std::string_view checkpoint_data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    recovered.emplace();
+    if (!parse_checkpoint(checkpoint_data, *recovered, strings)) {
+        recovered.reset();
+        return false;
+    }
+    return true;
+}
+
+// Starts a game of the players, sending GameStarted to all sessions.
+void Room::begin_game() {
+    game_in_progress = true;
+    listener.game_started(*this);
+    actions.start_game();
+    history.clear();
+    serialize_game_started_message(history, players);
+    compact_message.clear();
+    serialize_compact_game_started_message(compact_message, players);
+    send_to_all(view(history), view(compact_message));
+    if (leaderboard) leaderboard->start_game(players, leaderboard_game);
+}
+
+void Room::play_game(std::unique_lock<std::mutex> &lock) {
+    begin_game();
+    events_list_t events = start_game(game, options, players, random);
+    play_turns(lock, events, 0);
+}
+
+// Resumes a game read from a checkpoint. Its players come back with their
+// session tokens, other clients are sent the game from GameStarted, with
+// the checkpoint's turn recreating the board. Sessions join after the game
+// is resumed, so the resumed ones, which negotiated capabilities, get
+// a GameSnapshot with the bombs' remaining timers instead.
+void Room::resume_game(std::unique_lock<std::mutex> &lock) {
+    RoomCheckpoint &checkpoint = *recovered;
+    players = checkpoint.state.players.get();
+    session_tokens = checkpoint.session_tokens;
+    random = checkpoint.random;
+    begin_game();
+    for (size_t player = 0; player < options.players_count; player++)
+        if (checkpoint.actions[player].has_value()) actions.publish((PlayerId) player, *checkpoint.actions[player]);
+
+    events_list_t events = restore_game(game, options, checkpoint.state, checkpoint.next_bomb_id);
+    if (debug) std::cerr << "room " << id << ": resuming game in turn " << game.state.turn << "\n";
+    recovered.reset();
+    play_turns(lock, events, game.state.turn);
+}
+
+// Plays a game from the turn after [first_turn], whose events are given, and ends it.
+void Room::play_turns(std::unique_lock<std::mutex> &lock, events_list_t &events, uint16_t first_turn) {
+    uint32_t export_game = event_export ? event_export->new_game() : 0;
+    // a resumed game's first turn only recreates the board, the rows
+    // are written with a later turn, without the mutex
+    if (event_export && first_turn == 0) exported_events.add_turn(export_game, 0, events);
+    hand_over_turn(lock, events);
+
+    // the game is played without the mutex, sessions are given the output state
+    auto next_turn = std::chrono::steady_clock::now();
+    for (auto turn = (uint16_t) (first_turn + 1); turn <= options.game_length; turn++) {
+        next_turn += std::chrono::milliseconds(options.turn_duration);
+        lock.unlock();
+        std::this_thread::sleep_until(next_turn);
+        auto tick_start = std::chrono::steady_clock::now();
+
+        size_t actions_taken = actions.take_turn_actions(turn_actions, options.players_count);
+        server_gauges.pending_actions.store((int64_t) actions_taken, std::memory_order_relaxed);
+        events = play_turn(game, options, turn_actions, random);
+        trace<TRACE_MESSAGES>(TraceEvent::TurnPlayed, id, turn, actions_taken, events.size());
+        if (leaderboard) leaderboard->record_turn(events, leaderboard_game);
+        if (event_export) export_events(export_game, turn, events);
+        size_t events_count = events.size();
+
+        // waits for the previous turn if sending is slower than playing
+        lock.lock();
+        hand_over_turn(lock, events);
+
+        ThreadMetrics &metrics = thread_metrics();
+        auto to_us = [](std::chrono::steady_clock::duration duration) {
+            return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        };
+        metrics.tick_lateness.observe(to_us(tick_start - next_turn), TICK_BUCKETS_US);
+        metrics.tick_duration.observe(to_us(std::chrono::steady_clock::now() - tick_start),
+                                      TICK_BUCKETS_US);
+        metrics.turn_events.observe(events_count, TURN_EVENTS_BUCKETS);
+    }
+    wait_for_output(lock);
+
+    if (checkpoints) checkpoints->clear(id);
+    if (leaderboard) leaderboard->end_game(game.state.scores.get(), leaderboard_game);
+    // players are released first, as they may join again as soon as the game ends
+    game_in_progress = false;
+    actions.end_game();
+    players.clear();
+    session_tokens.clear();
+    for (auto &session : sessions) {
+        session->set_player({});
+        session->interest = {};
+    }
+    message.clear();
+    serialize_game_ended_message(message, game.state.scores.get());
+    compact_message.clear();
+    serialize_compact_game_ended_message(compact_message, game.state.scores.get());
+    send_to_all(view(message), view(compact_message));
+
+    if (debug) {
+        std::cerr << "room " << id << ": game ended, sent " << turns_sent << " turns to " << sessions.size()
+                  << " sessions, average send time " << (send_time.count() / 1000) /
+                  std::max(turns_sent, (size_t) 1) << " us\n";
+    }
+    send_time = {};
+    turns_sent = 0;
+    listener.game_ended(*this);
+}
+
+void Room::run() {
+    std::thread([this] { send_turns(); }).detach();
+    std::unique_lock<std::mutex> lock(mutex);
+    if (recovered.has_value()) resume_game(lock);
+    auto lobby_full_predicate = [this] { return players.size() == options.players_count; };
+    while (true) {
+        lobby_full.wait(lock, [this] { return !players.empty(); });
+        if (options.lobby_timeout == 0) {
+            lobby_full.wait(lock, lobby_full_predicate);
+        }
+        else {
+            lobby_full.wait_until(lock, first_join + std::chrono::milliseconds(options.lobby_timeout),
+                                  lobby_full_predicate);
+        }
+        play_game(lock);
+    }
+}
@@ -0,0 +1,185 @@
+#ifndef BOMBOWE_ROBOTY_SERVER_ROOM_H
+#define BOMBOWE_ROBOTY_SERVER_ROOM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include "action-table.h"
+#include "definitions.h"
+#include "game-rules.h"
+#include "interest-grid.h"
+#include "leaderboard.h"
+#include "event-export.h"
+#include "lz4-codec.h"
+#include "room-checkpoint.h"
+#include "server-backend.h"
+
+class Room;
+
+// A structure for a client connected to the server.
+struct Session {
+    boost::asio::ip::tcp::socket socket;
+    std::string address;
+    Room *room = nullptr; // used only by the session's thread
+
+    // Player id read without the room's mutex when publishing actions, -1 if none.
+    std::atomic<int> acting_player{-1};
+
+    // Fields below are guarded by the room's mutex.
+    std::optional<PlayerId> player_id; // set if the client joined the game
+    bool compact = false; // compact encoding negotiated
+    bool compression = false; // compression negotiated
+    bool reconnect = false; // gets a session token after joining
+    bool negotiated = false; // sent Capabilities, so it understands GameSnapshot
+    InterestState interest;
+    std::vector<char> filtered_turn;
+    std::vector<char> output; // reused for other messages sent only to this session
+    Lz4Compressor compressor; // for messages sent only to this session
+
+    Session(boost::asio::ip::tcp::socket socket, std::string address):
+            socket(std::move(socket)), address(std::move(address)){};
+
+    // Sets the player controlled by this session.
+    void set_player(std::optional<PlayerId> id) {
+        player_id = id;
+        acting_player.store(id.has_value() ? *id : -1, std::memory_order_release);
+    }
+};
+
+using session_ptr_t = std::shared_ptr<Session>;
+
+// An interface for whoever distributes players between rooms.
+// Called by the room's thread, with the room's mutex locked.
+class RoomListener {
+public:
+    virtual void game_started(Room &room) = 0;
+    virtual void game_ended(Room &room) = 0;
+
+protected:
+    ~RoomListener() = default;
+};
+
+// A class for the game room - gathers players in the lobby
+// and plays games in a turn loop, broadcasting messages to all sessions.
+// Turns are played and sent in a pipeline: the room's thread hands a played
+// turn over to the room's sender thread and plays the next turn without
+// the room's mutex, while the sender serializes and broadcasts the previous one.
+class Room {
+private:
+    ServerOptions &options;
+    std::unique_ptr<NetworkBackend> backend; // of this room only, used with the mutex locked
+    Leaderboard *leaderboard; // nullptr if disabled
+    LeaderboardGame leaderboard_game;
+    EventExport *event_export; // nullptr if disabled
+    EventColumns exported_events; // of the last games, not written yet
+    CheckpointStore *checkpoints; // nullptr if disabled
+    RoomListener &listener;
+
+    std::mutex mutex;
+    std::condition_variable lobby_full;
+    std::vector<session_ptr_t> sessions;
+    StringTable strings; // of players, so before everything keeping them
+    players_map_t players;
+    ActionTable actions;
+    actions_table_t turn_actions{}; // reused by every turn
+    bool game_in_progress = false;
+    std::chrono::steady_clock::time_point first_join; // of the players in the lobby
+
+    ServerGame game; // used only by the room's thread
+    std::minstd_rand random;
+    std::optional<RoomCheckpoint> recovered; // a game to resume when the room's thread starts
+
+    // The last turn handed over for sending - its events and the game state
+    // after it, copied from the game. Sessions and late joiners are given
+    // this state, which the room's thread doesn't change while playing.
+    // Every checkpoint_interval turns the rest of the game's state is copied
+    // too and the sender thread writes a checkpoint after sending the turn.
+    struct TurnOutput {
+        events_list_t events;
+        GameState state;
+        bool pending = false; // handed over and not sent yet
+        bool checkpoint = false;
+        BombId next_bomb_id = 0;
+        std::minstd_rand random;
+        actions_table_t actions{}; // published for the next turn
+    } output;
+    std::vector<char> checkpoint; // reused by the sender thread
+    std::condition_variable output_changed;
+
+    std::vector<char> history; // GameStarted and turns of the current game, for new clients
+    std::map<uint64_t, PlayerId> session_tokens; // of players in the lobby or game
+    std::mt19937_64 token_random{std::random_device{}()};
+
+    outgoing_batch_t batch;
+    std::vector<char> message; // reused for messages sent to all sessions
+    std::vector<char> compact_message;
+    std::vector<char> compact_turn;
+    EventFragments fragments;
+    EventFragments compact_fragments;
+    InterestGrid grid;
+    uint8_t id_bits; // bits per player id in compact encoding
+    Lz4Compressor compressors[2]; // for broadcast messages in both encodings
+
+    // Statistics of sending turns, printed after every game.
+    std::chrono::nanoseconds send_time{0};
+    size_t turns_sent = 0;
+
+    void send_batch();
+    std::string_view compress_message(Lz4Compressor &compressor, std::string_view message);
+    void send_to_session(Session &session, std::string_view message);
+    void send_to_all(std::string_view message, std::string_view compact_message);
+    void send_turn(events_list_t &events, GameState &state);
+    void send_turns();
+    void hand_over_turn(std::unique_lock<std::mutex> &lock, events_list_t &events);
+    void wait_for_output(std::unique_lock<std::mutex> &lock);
+    void resume_player(const session_ptr_t &session, PlayerId player_id);
+    void export_events(uint32_t export_game, uint16_t turn, events_list_t &events);
+    void write_exported_events();
+    void write_checkpoint();
+    void begin_game();
+    void play_turns(std::unique_lock<std::mutex> &lock, events_list_t &events, uint16_t first_turn);
+    void play_game(std::unique_lock<std::mutex> &lock);
+    void resume_game(std::unique_lock<std::mutex> &lock);
+
+public:
+    const uint16_t id;
+
+    Room(ServerOptions &options, std::unique_ptr<NetworkBackend> backend, Leaderboard *leaderboard,
+         EventExport *event_export, CheckpointStore *checkpoints, RoomListener &listener, uint16_t id);
+
+    // Prepares a game read from a checkpoint, which the room resumes
+    // instead of waiting for players. Called before run().
+    // Returns false if the checkpoint is malformed.
+    bool recover(std::string_view checkpoint_data);
+
+    // Registers a session that has received Hello and sends it
+    // the lobby or the current game. A session with a valid token
+    // takes over the player it was given to.
+    void add_session(const session_ptr_t &session, std::optional<uint64_t> token = {});
+    void remove_session(const session_ptr_t &session);
+
+    // Accepts a player if there is a free place in the lobby. Returns false
+    // if the room takes no more players - its lobby is full or it plays a game.
+    bool join(const session_ptr_t &session, std::string &name);
+
+    // Answers client's Capabilities message with capabilities
+    // enabled on this server.
+    void set_capabilities(const session_ptr_t &session, uint8_t capabilities);
+
+    // Returns the number of sessions watching the lobby, 0 if the room plays a game.
+    size_t lobby_sessions();
+
+    // Sets player's action for the next turn, without locking the room.
+    void set_action(const session_ptr_t &session, PlayerAction action);
+
+    // The room loop - starts the sender thread, resumes a recovered game,
+    // waits for players and plays games. Never returns.
+    // With a lobby timeout a game starts with the players who are there
+    // when the timeout passes after the first one joined.
+    [[noreturn]] void run();
+};
+
+#endif //BOMBOWE_ROBOTY_SERVER_ROOM_H
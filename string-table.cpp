@@ -0,0 +1,37 @@
+#include "string-table.h"
+
+void InternedString::release() {
+    // Only the last reference is dropped under the table's lock, as intern
+    // may give out a new one there. Nobody else can copy the last one.
+    uint32_t references = entry->references.load(std::memory_order_relaxed);
+    while (references > 1) {
+        if (entry->references.compare_exchange_weak(references, references - 1,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed))
+            return;
+    }
+
+    StringTable &table = *entry->table;
+    std::lock_guard<std::mutex> lock(table.mutex);
+    if (entry->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    table.entries.erase(std::string_view(entry->encoded).substr(1));
+    delete entry;
+}
+
+InternedString StringTable::intern(std::string_view string) {
+    string = string.substr(0, UINT8_MAX);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry_it = entries.find(string);
+    if (entry_it != entries.end()) {
+        entry_it->second->references.fetch_add(1, std::memory_order_relaxed);
+        return InternedString(entry_it->second);
+    }
+
+    auto *entry = new InternedString::Entry();
+    entry->table = this;
+    entry->encoded.reserve(1 + string.length());
+    entry->encoded.push_back((char) string.length());
+    entry->encoded.append(string);
+    entries.emplace(std::string_view(entry->encoded).substr(1), entry);
+    return InternedString(entry);
+}
@@ -0,0 +1,79 @@
+#ifndef BOMBOWE_ROBOTY_STRING_TABLE_H
+#define BOMBOWE_ROBOTY_STRING_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+/*
+Interned player names and addresses. A table keeps each distinct string once,
+already encoded the way messages carry it - a length byte followed by the bytes -
+so serializers copy it in one go. Players hold InternedString handles: copying
+one bumps the string's reference count instead of allocating, and dropping
+the last handle removes the string from its table. Handles may be copied
+and dropped by any thread. A table has to outlive the handles it gave out.
+*/
+
+class StringTable;
+
+class InternedString {
+private:
+    struct Entry {
+        std::atomic<uint32_t> references{1};
+        StringTable *table = nullptr;
+        std::string encoded; // the length byte and the string
+    };
+    Entry *entry = nullptr;
+
+    explicit InternedString(Entry *entry): entry(entry) {}
+    void release();
+
+    friend class StringTable;
+
+public:
+    InternedString() = default;
+    InternedString(const InternedString &other): entry(other.entry) {
+        if (entry) entry->references.fetch_add(1, std::memory_order_relaxed);
+    }
+    InternedString(InternedString &&other) noexcept: entry(std::exchange(other.entry, nullptr)) {}
+    InternedString &operator=(InternedString other) noexcept {
+        std::swap(entry, other.entry);
+        return *this;
+    }
+    ~InternedString() {
+        if (entry) release();
+    }
+
+    std::string_view view() const {
+        return entry ? std::string_view(entry->encoded).substr(1) : std::string_view();
+    }
+
+    // Returns the string with its length byte in front.
+    std::string_view encoded() const {
+        return entry ? std::string_view(entry->encoded) : std::string_view("\0", 1);
+    }
+
+    size_t length() const { return view().length(); }
+};
+
+class StringTable {
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string_view, InternedString::Entry *> entries; // keys view the entries
+
+    friend class InternedString;
+
+public:
+    StringTable() = default;
+    StringTable(const StringTable &) = delete;
+    StringTable &operator=(const StringTable &) = delete;
+
+    // Returns a handle to a string, cut to UINT8_MAX bytes like in messages.
+    InternedString intern(std::string_view string);
+};
+
+#endif //BOMBOWE_ROBOTY_STRING_TABLE_H
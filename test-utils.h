@@ -0,0 +1,25 @@
+#ifndef BOMBOWE_ROBOTY_TEST_UTILS_H
+#define BOMBOWE_ROBOTY_TEST_UTILS_H
+
+#include <iostream>
+
+/*
+A minimal harness for the tests run by ctest. A failed CHECK is reported
+with its place and the test goes on; the test's main returns test_result().
+*/
+
+inline int test_failures = 0;
+
+#define CHECK(condition) do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            test_failures++; \
+        } \
+    } while (0)
+
+inline int test_result() {
+    if (test_failures > 0) std::cerr << test_failures << " checks failed\n";
+    return test_failures > 0 ? 1 : 0;
+}
+
+#endif //BOMBOWE_ROBOTY_TEST_UTILS_H
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "trace.h"
+
+struct TraceEventInfo {
+    const char *name;
+    size_t args;
+};
+
+static const TraceEventInfo TRACE_EVENTS[] = {
+    {"sent_to_server", 2}, {"received_from_server", 1}, {"server_message", 1},
+    {"compressed_message", 2}, {"sent_to_gui", 1}, {"received_from_gui", 1},
+    {"gui_message", 1}, {"received_from_client", 2}, {"client_message", 2},
+    {"turn_played", 4}, {"received_rest", 1}
+};
+
+static constexpr size_t TRACE_EVENTS_NUMBER = sizeof(TRACE_EVENTS) / sizeof(TRACE_EVENTS[0]);
+
+const char *trace_event_name(uint16_t event) {
+    return event < TRACE_EVENTS_NUMBER ? TRACE_EVENTS[event].name : nullptr;
+}
+
+size_t trace_event_args(uint16_t event) {
+    return event < TRACE_EVENTS_NUMBER ? TRACE_EVENTS[event].args : 0;
+}
+
+// Rings of all threads. Rings of finished threads are given to new threads,
+// so the number of rings is the highest number of threads at once.
+// Never destroyed, the drain may still use it while the program exits.
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+    std::vector<TraceRing *> free_rings;
+};
+
+static TraceRegistry &registry() {
+    static auto *trace_registry = new TraceRegistry;
+    return *trace_registry;
+}
+
+// Holds a ring for the lifetime of a thread.
+struct RingOwner {
+    TraceRing *ring;
+
+    RingOwner() {
+        TraceRegistry &trace_registry = registry();
+        std::lock_guard<std::mutex> lock(trace_registry.mutex);
+        if (!trace_registry.free_rings.empty()) {
+            ring = trace_registry.free_rings.back();
+            trace_registry.free_rings.pop_back();
+            return;
+        }
+        trace_registry.rings.push_back(std::make_unique<TraceRing>());
+        ring = trace_registry.rings.back().get();
+        ring->thread = (uint16_t) (trace_registry.rings.size() - 1);
+    }
+
+    ~RingOwner() {
+        TraceRegistry &trace_registry = registry();
+        std::lock_guard<std::mutex> lock(trace_registry.mutex);
+        trace_registry.free_rings.push_back(ring);
+    }
+};
+
+TraceRing &trace_ring() {
+    thread_local RingOwner owner;
+    return *owner.ring;
+}
+
+static std::mutex drain_mutex;
+static FILE *trace_file = nullptr;
+
+// Appends records written since the last drain to the trace file.
+static void drain_rings() {
+    std::lock_guard<std::mutex> drain_lock(drain_mutex);
+    std::vector<TraceRing *> rings;
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        for (auto &ring : registry().rings)
+            rings.push_back(ring.get());
+    }
+
+    std::vector<TraceRecord> records;
+    for (auto *ring : rings) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t from = std::max(ring->drained, head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0);
+        records.clear();
+        for (uint64_t i = from; i < head; i++)
+            records.push_back(ring->records[i & (TRACE_RING_SIZE - 1)]);
+
+        // the thread may have overwritten the oldest records while they were copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t head_after = ring->head.load(std::memory_order_relaxed);
+        uint64_t valid_from = head_after >= TRACE_RING_SIZE ? head_after - TRACE_RING_SIZE + 1 : 0;
+        size_t overwritten = valid_from > from ? std::min((size_t) (valid_from - from), records.size()) : 0;
+
+        fwrite(records.data() + overwritten, sizeof(TraceRecord), records.size() - overwritten, trace_file);
+        ring->drained = head;
+    }
+    fflush(trace_file);
+}
+
+// Measures how fast trace_timestamp() ticks.
+static double measure_ticks_per_ns() {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t start_ticks = trace_timestamp();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t ticks = trace_timestamp() - start_ticks;
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    return (double) ticks / (double) elapsed;
+}
+
+void start_trace_file(const std::string &path) {
+    trace_file = fopen(path.c_str(), "wb");
+    if (!trace_file) throw std::system_error(errno, std::generic_category(), "open " + path);
+
+    TraceFileHeader header{};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    header.ticks_per_ns = measure_ticks_per_ns();
+    fwrite(&header, sizeof(header), 1, trace_file);
+
+    std::thread([] {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_DRAIN_INTERVAL_MS));
+            drain_rings();
+        }
+    }).detach();
+    std::atexit(drain_rings);
+}
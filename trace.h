@@ -0,0 +1,119 @@
+#ifndef BOMBOWE_ROBOTY_TRACE_H
+#define BOMBOWE_ROBOTY_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/*
+Binary tracing. An event is a fixed-size record - time, event id and a few
+integers - stored in a ring buffer of the calling thread, without locks,
+formatting or system calls. With a trace file a drain thread appends new
+records of all threads to it every TRACE_DRAIN_INTERVAL_MS and robots-trace
+decodes the file. A thread that writes more than TRACE_RING_SIZE records
+between two drains loses the oldest ones.
+Events above TRACE_LEVEL (set with -DROBOTS_TRACE_LEVEL) are compiled out.
+*/
+
+#define TRACE_MESSAGES 1 // a record per message
+#define TRACE_IO       2 // a record per read and write
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_IO
+#endif
+
+#define TRACE_RING_SIZE         4096 // records, a power of two
+#define TRACE_ARGS              5
+#define TRACE_DRAIN_INTERVAL_MS 100
+#define TRACE_MAGIC             "ROBOTSTR"
+#define TRACE_VERSION           1
+
+// Traced events, with their arguments.
+enum class TraceEvent : uint16_t {
+    SentToServer,       // bytes, dropped
+    ReceivedFromServer, // bytes
+    ServerMessage,      // message type
+    CompressedMessage,  // compressed length, original length
+    SentToGui,          // bytes
+    ReceivedFromGui,    // bytes
+    GuiMessage,         // message type
+    ReceivedFromClient, // bytes, client's port
+    ClientMessage,      // message type, length
+    TurnPlayed,         // room, turn, actions, events
+    ReceivedRest,       // bytes, read to complete a message
+};
+
+struct TraceRecord {
+    uint64_t time; // trace_timestamp()
+    uint16_t event;
+    uint16_t thread;
+    uint32_t args[TRACE_ARGS];
+};
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    double ticks_per_ns; // of trace_timestamp()
+};
+
+// Records of a single thread. Only the thread writes them,
+// the drain copies them and checks afterwards if they were overwritten.
+struct TraceRing {
+    std::atomic<uint64_t> head{0}; // records ever written
+    uint64_t drained = 0; // used only by the drain
+    uint16_t thread = 0;
+    TraceRecord records[TRACE_RING_SIZE];
+};
+
+// Returns a timestamp - the CPU's time-stamp counter on x86-64, where reading
+// the clock would take most of the time of a record, nanoseconds elsewhere.
+inline uint64_t trace_timestamp() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Returns the ring of the calling thread, registering it on the first call.
+TraceRing &trace_ring();
+
+// Appends records of all threads to a new trace file, from now
+// until the program exits. Throws std::system_error if the file can't be created.
+void start_trace_file(const std::string &path);
+
+// Returns the name and the number of arguments of an event,
+// nullptr and 0 for an unknown event.
+const char *trace_event_name(uint16_t event);
+size_t trace_event_args(uint16_t event);
+
+// Records an event with up to TRACE_ARGS integer arguments,
+// if [level] is enabled at compile time.
+template<int level, typename... Args>
+inline void trace(TraceEvent event, Args... args) {
+    if constexpr (level <= TRACE_LEVEL) {
+        static_assert(sizeof...(Args) <= TRACE_ARGS);
+        TraceRing &ring = trace_ring();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        // the record must not be overwritten before the previous head is visible
+        std::atomic_thread_fence(std::memory_order_release);
+
+        TraceRecord &record = ring.records[head & (TRACE_RING_SIZE - 1)];
+        record.time = trace_timestamp();
+        record.event = (uint16_t) event;
+        record.thread = ring.thread;
+        uint32_t values[TRACE_ARGS] = {(uint32_t) args...};
+        for (size_t i = 0; i < TRACE_ARGS; i++)
+            record.args[i] = values[i];
+
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+}
+
+#endif //BOMBOWE_ROBOTY_TRACE_H